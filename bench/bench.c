@@ -0,0 +1,883 @@
+// Parse benchmark for the Djot grammar.
+//
+// Usage: bench [-n ITERATIONS] [-j THREADS] [-c CHUNK_SIZE] [-t PARSERS]
+//              [-s SNIPPET_SIZE] [-q QUERY]... [-p] FILE...
+//
+// Every file is parsed ITERATIONS times with the same parser, reporting the
+// best and mean parse time and the throughput of the best run, and then
+// walked with a cursor, exported with `tree_sitter_djot_export`, rendered
+// with `tree_sitter_djot_render_html` and indexed with
+// `tree_sitter_djot_reference_index_new` and `tree_sitter_djot_outline_new`,
+// and folded with `tree_sitter_djot_folds_new`. The index, the outline and the
+// folds are then updated after an edit in the middle of the file, without the
+// reparse. Last, a screen in the middle of the file is parsed on its own with
+// `tree_sitter_djot_parse_viewport`, and the injections are listed with
+// `tree_sitter_djot_injections`.
+// With -j, files are also split into chunks of CHUNK_SIZE bytes that are
+// parsed on THREADS threads.
+// With -t, files are also parsed by PARSERS parsers at once, each on its own
+// thread, reporting the combined throughput. This shows how much the parsers
+// contend, for example on the allocator.
+// With -s, snippets of SNIPPET_SIZE bytes from the start of the files are
+// parsed with a new parser every time, like for comments or chat messages,
+// where creating and destroying the parser is a large part of the cost.
+// With -q, only the parse and the queries in the QUERY files are timed. Every
+// query is run with a query cursor over the whole tree, like a highlighter
+// does, and then every pattern on its own, reporting the patterns from the
+// slowest with their match and capture counts, and the captures by name.
+// Predicates like `#eq?` are left to the caller by tree-sitter, so they're
+// not part of the time.
+// With -p, only the parse is timed, and the ERROR and missing nodes in the
+// tree are counted, to compare how the parser recovers from errors.
+// Built with `TREE_SITTER_DJOT_MEMORY_STATS`, the memory that the scanner
+// allocates during the parses of every file is reported after them.
+// Run `make bench` to generate the corpus in `bench/corpus` and run this on it,
+// `make bench-highlights` to compare the highlights queries, and
+// `make bench-errors` to parse broken documents.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tree-sitter-djot-utils.h"
+#include "tree-sitter-djot.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <tree_sitter/api.h>
+#include <unistd.h>
+
+typedef struct {
+  char *contents;
+  uint32_t length;
+} Source;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool read_source(const char *path, Source *source) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  source->contents = malloc(length);
+  source->length = (uint32_t)length;
+  bool ok = fread(source->contents, 1, length, f) == (size_t)length;
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "%s: short read\n", path);
+    free(source->contents);
+  }
+  return ok;
+}
+
+static void print_result(const char *name, uint32_t bytes, double best,
+                         double total, int iterations) {
+  printf("%-28s %10u bytes %9.3f ms (best) %9.3f ms (mean) %8.2f MB/s\n",
+         name, bytes, best, total / iterations, bytes / best / 1e3);
+}
+
+static void bench_parse(TSParser *parser, const char *path,
+                        const Source *source, int iterations) {
+  double best = 0;
+  double total = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSTree *tree =
+        ts_parser_parse_string(parser, NULL, source->contents, source->length);
+    double elapsed = now_ms() - start;
+    ts_tree_delete(tree);
+
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  print_result(path, source->length, best, total, iterations);
+}
+
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+// Report what the scanners allocated since the last call.
+static void print_scanner_memory(void) {
+  TSDjotScannerMemoryStats stats;
+  tree_sitter_djot_scanner_memory_stats(&stats);
+  printf("  scanner memory: %zu bytes live, %zu bytes peak, %zu scanners, "
+         "%zu blocks, %zu inlines, %zu stacks, %zu frees\n",
+         stats.live_bytes, stats.peak_bytes, stats.scanner_allocations,
+         stats.block_allocations, stats.inline_allocations,
+         stats.stack_allocations, stats.frees);
+  tree_sitter_djot_scanner_memory_stats_reset();
+}
+#endif
+
+// Index the lines and find the split points, which don't parse.
+static void bench_lines(const Source *source, int iterations,
+                        uint32_t chunk_size) {
+  double lines_best = 0, lines_total = 0;
+  double split_best = 0, split_total = 0;
+  uint32_t line_count = 0;
+  uint32_t point_count = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    free(tree_sitter_djot_lines(source->contents, source->length,
+                                &line_count));
+    double elapsed = now_ms() - start;
+    lines_total += elapsed;
+    if (i == 0 || elapsed < lines_best) {
+      lines_best = elapsed;
+    }
+
+    start = now_ms();
+    free(tree_sitter_djot_split_points(source->contents, source->length,
+                                       chunk_size, &point_count));
+    elapsed = now_ms() - start;
+    split_total += elapsed;
+    if (i == 0 || elapsed < split_best) {
+      split_best = elapsed;
+    }
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "  lines, %u lines", line_count);
+  print_result(name, source->length, lines_best, lines_total, iterations);
+  snprintf(name, sizeof(name), "  split points, %u points", point_count);
+  print_result(name, source->length, split_best, split_total, iterations);
+}
+
+static void bench_parse_chunked(const Source *source, int iterations,
+                                uint32_t threads, uint32_t chunk_size) {
+  double best = 0;
+  double total = 0;
+  uint32_t chunk_count = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSDjotChunk *chunks = tree_sitter_djot_parse_chunked(
+        source->contents, source->length, chunk_size, threads, &chunk_count);
+    double elapsed = now_ms() - start;
+    tree_sitter_djot_chunks_delete(chunks, chunk_count);
+
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "  %u threads, %u chunks", threads,
+           chunk_count);
+  print_result(name, source->length, best, total, iterations);
+}
+
+// Read the kind and range of every node, like a renderer would.
+static uint32_t walk(const TSTree *tree) {
+  uint32_t sum = 0;
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    sum += ts_node_symbol(node) + ts_node_start_byte(node) +
+           ts_node_end_byte(node);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return sum;
+      }
+    }
+  }
+}
+
+// Compare walking the tree with a cursor, which is what bindings do node by
+// node, with writing it out with `tree_sitter_djot_export` once.
+static void bench_export(TSParser *parser, const Source *source,
+                         int iterations) {
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  double walk_best = 0, walk_total = 0;
+  double export_best = 0, export_total = 0;
+  size_t length = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    walk(tree);
+    double elapsed = now_ms() - start;
+    walk_total += elapsed;
+    if (i == 0 || elapsed < walk_best) {
+      walk_best = elapsed;
+    }
+
+    start = now_ms();
+    free(tree_sitter_djot_export(tree, &length));
+    elapsed = now_ms() - start;
+    export_total += elapsed;
+    if (i == 0 || elapsed < export_best) {
+      export_best = elapsed;
+    }
+  }
+  ts_tree_delete(tree);
+
+  print_result("  cursor walk", source->length, walk_best, walk_total,
+               iterations);
+  char name[64];
+  snprintf(name, sizeof(name), "  export, %zu bytes", length);
+  print_result(name, source->length, export_best, export_total, iterations);
+}
+
+static bool count_html(void *payload, const char *data, size_t length) {
+  (void)data;
+  *(size_t *)payload += length;
+  return true;
+}
+
+// Render the tree as HTML with `tree_sitter_djot_render_html`, without the
+// parse.
+static void bench_html(TSParser *parser, const Source *source,
+                       int iterations) {
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  double best = 0;
+  double total = 0;
+  size_t length = 0;
+  for (int i = 0; i < iterations; ++i) {
+    length = 0;
+    double start = now_ms();
+    tree_sitter_djot_render_html(tree, source->contents, source->length,
+                                 count_html, &length);
+    double elapsed = now_ms() - start;
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  ts_tree_delete(tree);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  html, %zu bytes", length);
+  print_result(name, source->length, best, total, iterations);
+}
+
+// A file with a reference inserted in the middle, for the benchmarks of
+// incremental updates. `edit` goes from `tree` to `edited_tree`, and `undo`
+// back to `undone_tree`. The changed ranges are only right between an old
+// tree that has been edited and the tree parsed from it, so each direction
+// keeps its edited old tree too.
+typedef struct {
+  TSTree *tree;
+  TSTree *edited_old_tree;
+  TSTree *edited_tree;
+  TSTree *undone_old_tree;
+  TSTree *undone_tree;
+  char *edited;
+  uint32_t edited_length;
+  TSInputEdit edit;
+  TSInputEdit undo;
+} Edit;
+
+static void edit_middle(TSParser *parser, const Source *source, Edit *edit) {
+  static const char inserted[] = "[new][ref 1] ";
+  uint32_t inserted_length = sizeof(inserted) - 1;
+  const char *middle =
+      memchr(source->contents + source->length / 2, ' ', source->length / 2);
+  uint32_t position = middle ? (uint32_t)(middle - source->contents) + 1 : 0;
+  edit->edited_length = source->length + inserted_length;
+  edit->edited = malloc(edit->edited_length);
+  memcpy(edit->edited, source->contents, position);
+  memcpy(edit->edited + position, inserted, inserted_length);
+  memcpy(edit->edited + position + inserted_length,
+         source->contents + position, source->length - position);
+
+  TSPoint point = {0, 0};
+  for (uint32_t i = 0; i < position; ++i) {
+    if (source->contents[i] == '\n') {
+      ++point.row;
+      point.column = 0;
+    } else {
+      ++point.column;
+    }
+  }
+  TSPoint end = {point.row, point.column + inserted_length};
+  edit->edit = (TSInputEdit){
+      .start_byte = position,
+      .old_end_byte = position,
+      .new_end_byte = position + inserted_length,
+      .start_point = point,
+      .old_end_point = point,
+      .new_end_point = end,
+  };
+  edit->undo = (TSInputEdit){
+      .start_byte = position,
+      .old_end_byte = position + inserted_length,
+      .new_end_byte = position,
+      .start_point = point,
+      .old_end_point = end,
+      .new_end_point = point,
+  };
+
+  edit->tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  edit->edited_old_tree = ts_tree_copy(edit->tree);
+  ts_tree_edit(edit->edited_old_tree, &edit->edit);
+  edit->edited_tree = ts_parser_parse_string(
+      parser, edit->edited_old_tree, edit->edited, edit->edited_length);
+  edit->undone_old_tree = ts_tree_copy(edit->edited_tree);
+  ts_tree_edit(edit->undone_old_tree, &edit->undo);
+  edit->undone_tree = ts_parser_parse_string(
+      parser, edit->undone_old_tree, source->contents, source->length);
+}
+
+static void edit_delete(Edit *edit) {
+  ts_tree_delete(edit->tree);
+  ts_tree_delete(edit->edited_old_tree);
+  ts_tree_delete(edit->edited_tree);
+  ts_tree_delete(edit->undone_old_tree);
+  ts_tree_delete(edit->undone_tree);
+  free(edit->edited);
+}
+
+// Build the reference index, and update it after the edit. Only the index is
+// timed, not the parses.
+static void bench_references(TSParser *parser, const Source *source,
+                             int iterations) {
+  Edit edit;
+  edit_middle(parser, source, &edit);
+  double build_best = 0, build_total = 0;
+  double update_best = 0, update_total = 0;
+  uint32_t problem_count = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSDjotReferenceIndex *index =
+        tree_sitter_djot_reference_index_new(edit.tree, source->contents);
+    double elapsed = now_ms() - start;
+    build_total += elapsed;
+    if (i == 0 || elapsed < build_best) {
+      build_best = elapsed;
+    }
+
+    start = now_ms();
+    tree_sitter_djot_reference_index_edit(index, &edit.edit);
+    tree_sitter_djot_reference_index_update(index, edit.edited_old_tree,
+                                            edit.edited_tree, edit.edited);
+    elapsed = now_ms() - start;
+    update_total += elapsed;
+    if (i == 0 || elapsed < update_best) {
+      update_best = elapsed;
+    }
+
+    free(tree_sitter_djot_reference_index_problems(index, &problem_count));
+    tree_sitter_djot_reference_index_delete(index);
+  }
+  edit_delete(&edit);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  references, %u problems", problem_count);
+  print_result(name, source->length, build_best, build_total, iterations);
+  print_result("  references, update", edit.edited_length, update_best,
+               update_total, iterations);
+}
+
+// Build the outline, and then keep it up to date while the edit is made and
+// undone, like in an editor.
+static void bench_outline(TSParser *parser, const Source *source,
+                          int iterations) {
+  Edit edit;
+  edit_middle(parser, source, &edit);
+  double build_best = 0, build_total = 0;
+  double update_best = 0, update_total = 0;
+  uint32_t heading_count = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSDjotOutline *outline =
+        tree_sitter_djot_outline_new(edit.tree, source->contents);
+    double elapsed = now_ms() - start;
+    build_total += elapsed;
+    if (i == 0 || elapsed < build_best) {
+      build_best = elapsed;
+    }
+    tree_sitter_djot_outline_headings(outline, &heading_count);
+
+    for (int j = 0; j < 2; ++j) {
+      start = now_ms();
+      tree_sitter_djot_outline_edit(outline, &edit.edit);
+      tree_sitter_djot_outline_update(outline, edit.edited_old_tree,
+                                      edit.edited_tree, edit.edited);
+      tree_sitter_djot_outline_edit(outline, &edit.undo);
+      tree_sitter_djot_outline_update(outline, edit.undone_old_tree,
+                                      edit.undone_tree, source->contents);
+      elapsed = (now_ms() - start) / 2;
+      update_total += elapsed;
+      if ((i == 0 && j == 0) || elapsed < update_best) {
+        update_best = elapsed;
+      }
+    }
+    tree_sitter_djot_outline_delete(outline);
+  }
+  edit_delete(&edit);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  outline, %u headings", heading_count);
+  print_result(name, source->length, build_best, build_total, iterations);
+  print_result("  outline, update", edit.edited_length, update_best,
+               update_total / 2, iterations);
+}
+
+// Find the folds, and then keep them up to date while the edit is made and
+// undone.
+static void bench_folds(TSParser *parser, const Source *source,
+                        int iterations) {
+  Edit edit;
+  edit_middle(parser, source, &edit);
+  double build_best = 0, build_total = 0;
+  double update_best = 0, update_total = 0;
+  uint32_t fold_count = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSDjotFolds *folds = tree_sitter_djot_folds_new(edit.tree);
+    double elapsed = now_ms() - start;
+    build_total += elapsed;
+    if (i == 0 || elapsed < build_best) {
+      build_best = elapsed;
+    }
+    tree_sitter_djot_folds_ranges(folds, &fold_count);
+
+    for (int j = 0; j < 2; ++j) {
+      start = now_ms();
+      tree_sitter_djot_folds_edit(folds, &edit.edit);
+      tree_sitter_djot_folds_update(folds, edit.edited_old_tree,
+                                    edit.edited_tree);
+      tree_sitter_djot_folds_edit(folds, &edit.undo);
+      tree_sitter_djot_folds_update(folds, edit.undone_old_tree,
+                                    edit.undone_tree);
+      elapsed = (now_ms() - start) / 2;
+      update_total += elapsed;
+      if ((i == 0 && j == 0) || elapsed < update_best) {
+        update_best = elapsed;
+      }
+    }
+    tree_sitter_djot_folds_delete(folds);
+  }
+  edit_delete(&edit);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  folds, %u ranges", fold_count);
+  print_result(name, source->length, build_best, build_total, iterations);
+  print_result("  folds, update", edit.edited_length, update_best,
+               update_total / 2, iterations);
+}
+
+// Parse a screen in the middle of the file with
+// `tree_sitter_djot_parse_viewport`, from the boundaries of a full parse,
+// which aren't part of the time. The time should be about the same for every
+// file.
+static void bench_viewport(TSParser *parser, const Source *source,
+                           int iterations) {
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  uint32_t boundary_count = 0;
+  TSDjotBoundary *boundaries =
+      tree_sitter_djot_boundaries(tree, NULL, &boundary_count);
+  ts_tree_delete(tree);
+
+  uint32_t start_byte = source->length / 2;
+  uint32_t end_byte = start_byte + 4 * 1024;
+  if (end_byte > source->length) {
+    end_byte = source->length;
+  }
+  double best = 0;
+  double total = 0;
+  uint32_t length = 0;
+  for (int i = 0; i < iterations; ++i) {
+    TSDjotChunk viewport;
+    double start = now_ms();
+    tree_sitter_djot_parse_viewport(parser, boundaries, boundary_count,
+                                    source->contents, source->length,
+                                    start_byte, end_byte, 16 * 1024,
+                                    &viewport);
+    double elapsed = now_ms() - start;
+    length = viewport.end_byte - viewport.start.start_byte;
+    ts_tree_delete(viewport.tree);
+
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  free(boundaries);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  viewport, %u boundaries", boundary_count);
+  print_result(name, length, best, total, iterations);
+}
+
+// List the injections of the whole file with `tree_sitter_djot_injections`,
+// without the parse, and count the ones with content that came before.
+static void bench_injections(TSParser *parser, const Source *source,
+                             int iterations) {
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  double best = 0;
+  double total = 0;
+  uint32_t count = 0;
+  uint32_t unique = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    TSDjotInjection *injections = tree_sitter_djot_injections(
+        tree, source->contents, 0, UINT32_MAX, &count);
+    double elapsed = now_ms() - start;
+    unique = 0;
+    for (uint32_t j = 0; j < count; ++j) {
+      unique += injections[j].first == j;
+    }
+    free(injections);
+
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  ts_tree_delete(tree);
+
+  char name[64];
+  snprintf(name, sizeof(name), "  injections, %u of %u", unique, count);
+  print_result(name, source->length, best, total, iterations);
+}
+
+typedef struct {
+  uint32_t line;
+  double best;
+  uint32_t matches;
+  uint32_t captures;
+} PatternResult;
+
+static int compare_patterns(const void *a, const void *b) {
+  const PatternResult *x = a, *y = b;
+  return x->best < y->best ? 1 : x->best > y->best ? -1 : 0;
+}
+
+// Run `query` over `tree` ITERATIONS times, adding the times to `total` and
+// returning the best one. Captures are counted, and counted by capture id into
+// `by_id` if it's given.
+static double run_query(const TSQuery *query, const TSTree *tree,
+                        int iterations, double *total, uint32_t *captures,
+                        uint32_t *by_id) {
+  TSQueryCursor *cursor = ts_query_cursor_new();
+  double best = 0;
+  for (int i = 0; i < iterations; ++i) {
+    uint32_t count = 0;
+    double start = now_ms();
+    ts_query_cursor_exec(cursor, query, ts_tree_root_node(tree));
+    TSQueryMatch match;
+    uint32_t capture_index;
+    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) {
+      ++count;
+      if (by_id && i == 0) {
+        ++by_id[match.captures[capture_index].index];
+      }
+    }
+    double elapsed = now_ms() - start;
+    *total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+    *captures = count;
+  }
+  ts_query_cursor_delete(cursor);
+  return best;
+}
+
+static void bench_query(TSParser *parser, const Source *source,
+                        const char *query_path, const Source *query_source,
+                        int iterations) {
+  const TSLanguage *language = tree_sitter_djot();
+  uint32_t error_offset;
+  TSQueryError error;
+  TSQuery *query = ts_query_new(language, query_source->contents,
+                                query_source->length, &error_offset, &error);
+  if (!query) {
+    fprintf(stderr, "%s: error %d at byte %u\n", query_path, error,
+            error_offset);
+    return;
+  }
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+
+  uint32_t capture_count = ts_query_capture_count(query);
+  uint32_t *by_id = calloc(capture_count + 1, sizeof(uint32_t));
+  uint32_t captures = 0;
+  double total = 0;
+  double best = run_query(query, tree, iterations, &total, &captures, by_id);
+  char name[64];
+  snprintf(name, sizeof(name), "  %s", query_path);
+  print_result(name, source->length, best, total, iterations);
+  printf("    %.3f ms per MB, %u captures\n", best * 1e6 / source->length,
+         captures);
+
+  // A query with every other pattern disabled for each pattern.
+  uint32_t pattern_count = ts_query_pattern_count(query);
+  PatternResult *patterns = calloc(pattern_count, sizeof(PatternResult));
+  for (uint32_t i = 0; i < pattern_count; ++i) {
+    PatternResult *pattern = &patterns[i];
+    pattern->line = 1;
+    uint32_t start_byte = ts_query_start_byte_for_pattern(query, i);
+    for (uint32_t j = 0; j < start_byte; ++j) {
+      pattern->line += query_source->contents[j] == '\n';
+    }
+    TSQuery *single = ts_query_new(language, query_source->contents,
+                                   query_source->length, &error_offset,
+                                   &error);
+    for (uint32_t j = 0; j < pattern_count; ++j) {
+      if (j != i) {
+        ts_query_disable_pattern(single, j);
+      }
+    }
+    double pattern_total = 0;
+    pattern->best = run_query(single, tree, iterations, &pattern_total,
+                              &pattern->captures, NULL);
+
+    TSQueryCursor *cursor = ts_query_cursor_new();
+    ts_query_cursor_exec(cursor, single, ts_tree_root_node(tree));
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(cursor, &match)) {
+      ++pattern->matches;
+    }
+    ts_query_cursor_delete(cursor);
+    ts_query_delete(single);
+  }
+  qsort(patterns, pattern_count, sizeof(PatternResult), compare_patterns);
+  for (uint32_t i = 0; i < pattern_count; ++i) {
+    const PatternResult *pattern = &patterns[i];
+    printf("    line %4u %9.3f ms %9u matches %9u captures\n", pattern->line,
+           pattern->best, pattern->matches, pattern->captures);
+  }
+  for (uint32_t i = 0; i < capture_count; ++i) {
+    uint32_t length;
+    const char *capture = ts_query_capture_name_for_id(query, i, &length);
+    printf("    @%-32.*s %9u captures\n", (int)length, capture, by_id[i]);
+  }
+
+  free(patterns);
+  free(by_id);
+  ts_tree_delete(tree);
+  ts_query_delete(query);
+}
+
+typedef struct {
+  const Source *source;
+  int iterations;
+} Worker;
+
+static void *run_worker(void *payload) {
+  const Worker *worker = payload;
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, tree_sitter_djot());
+  for (int i = 0; i < worker->iterations; ++i) {
+    ts_tree_delete(ts_parser_parse_string(parser, NULL,
+                                          worker->source->contents,
+                                          worker->source->length));
+  }
+  ts_parser_delete(parser);
+  return NULL;
+}
+
+static void bench_concurrent(const Source *source, int iterations,
+                             int parsers) {
+  Worker worker = {source, iterations};
+  pthread_t *threads = malloc(parsers * sizeof(pthread_t));
+  double start = now_ms();
+  for (int i = 0; i < parsers; ++i) {
+    pthread_create(&threads[i], NULL, run_worker, &worker);
+  }
+  for (int i = 0; i < parsers; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  double elapsed = now_ms() - start;
+  free(threads);
+
+  // Every round parses the file once in each thread.
+  char name[64];
+  snprintf(name, sizeof(name), "  %d parsers at once", parsers);
+  print_result(name, source->length * parsers, elapsed / iterations, elapsed,
+               iterations);
+}
+
+static void bench_snippets(const Source *source, int iterations,
+                           uint32_t snippet_size) {
+  uint32_t length =
+      source->length < snippet_size ? source->length : snippet_size;
+  // Enough rounds to measure something, even for tiny snippets.
+  int rounds = 10000;
+  double best = 0;
+  double total = 0;
+  for (int i = 0; i < iterations; ++i) {
+    double start = now_ms();
+    for (int j = 0; j < rounds; ++j) {
+      TSParser *parser = ts_parser_new();
+      ts_parser_set_language(parser, tree_sitter_djot());
+      ts_tree_delete(
+          ts_parser_parse_string(parser, NULL, source->contents, length));
+      ts_parser_delete(parser);
+    }
+    double elapsed = now_ms() - start;
+
+    total += elapsed;
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "  %d new parsers, %u bytes", rounds, length);
+  print_result(name, length * rounds, best, total, iterations);
+}
+
+static void count_errors(TSParser *parser, const Source *source) {
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, source->contents, source->length);
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  uint32_t errors = 0;
+  uint32_t missing = 0;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (ts_node_is_error(node)) {
+      ++errors;
+    } else if (ts_node_is_missing(node)) {
+      ++missing;
+    }
+    // Nothing below a node without errors can be one.
+    if (ts_node_has_error(node) && ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        printf("  %u errors, %u missing\n", errors, missing);
+        ts_tree_cursor_delete(&cursor);
+        ts_tree_delete(tree);
+        return;
+      }
+    }
+  }
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [-n ITERATIONS] [-j THREADS] [-c CHUNK_SIZE] "
+          "[-t PARSERS] [-s SNIPPET_SIZE] [-q QUERY]... [-p] FILE...\n",
+          name);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int iterations = 10;
+  int threads = 0;
+  int chunk_size = 64 * 1024;
+  int parsers = 0;
+  int snippet_size = 0;
+  bool parse_only = false;
+
+  const char **queries = calloc(argc, sizeof(char *));
+  int query_count = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:j:c:t:s:q:p")) != -1) {
+    switch (opt) {
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'c':
+      chunk_size = atoi(optarg);
+      break;
+    case 't':
+      parsers = atoi(optarg);
+      break;
+    case 's':
+      snippet_size = atoi(optarg);
+      break;
+    case 'q':
+      queries[query_count++] = optarg;
+      break;
+    case 'p':
+      parse_only = true;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind >= argc || iterations <= 0 || threads < 0 || chunk_size <= 0 ||
+      parsers < 0 || snippet_size < 0) {
+    usage(argv[0]);
+  }
+
+  int status = 0;
+  Source *query_sources = calloc(query_count + 1, sizeof(Source));
+  for (int i = 0; i < query_count; ++i) {
+    if (!read_source(queries[i], &query_sources[i])) {
+      return 1;
+    }
+  }
+
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, tree_sitter_djot());
+
+  for (int i = optind; i < argc; ++i) {
+    Source source;
+    if (!read_source(argv[i], &source)) {
+      status = 1;
+      continue;
+    }
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+    tree_sitter_djot_scanner_memory_stats_reset();
+#endif
+    bench_parse(parser, argv[i], &source, iterations);
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+    print_scanner_memory();
+#endif
+    if (parse_only) {
+      count_errors(parser, &source);
+      free(source.contents);
+      continue;
+    }
+    if (query_count > 0) {
+      for (int j = 0; j < query_count; ++j) {
+        bench_query(parser, &source, queries[j], &query_sources[j],
+                    iterations);
+      }
+      free(source.contents);
+      continue;
+    }
+    bench_export(parser, &source, iterations);
+    bench_html(parser, &source, iterations);
+    bench_references(parser, &source, iterations);
+    bench_outline(parser, &source, iterations);
+    bench_folds(parser, &source, iterations);
+    bench_viewport(parser, &source, iterations);
+    bench_injections(parser, &source, iterations);
+    bench_lines(&source, iterations, chunk_size);
+    if (threads > 0) {
+      bench_parse_chunked(&source, iterations, threads, chunk_size);
+    }
+    if (parsers > 0) {
+      bench_concurrent(&source, iterations, parsers);
+    }
+    if (snippet_size > 0) {
+      bench_snippets(&source, iterations, snippet_size);
+    }
+    free(source.contents);
+  }
+
+  for (int i = 0; i < query_count; ++i) {
+    free(query_sources[i].contents);
+  }
+  free(query_sources);
+  free(queries);
+  ts_parser_delete(parser);
+  return status;
+}
@@ -0,0 +1,83 @@
+// Compares reading every node of a tree through a tree-sitter cursor with
+// reading it from an exported tree, in the Node binding.
+//
+// Usage: node bench/export.js [-n ITERATIONS] FILE...
+//
+// Needs the `tree-sitter` package, and the binding built with it.
+
+const fs = require("fs");
+const Parser = require("tree-sitter");
+const Djot = require("../bindings/node");
+
+let iterations = 10;
+const files = [];
+for (let i = 2; i < process.argv.length; ++i) {
+  if (process.argv[i] === "-n") {
+    iterations = parseInt(process.argv[++i], 10);
+  } else {
+    files.push(process.argv[i]);
+  }
+}
+if (!Djot.parseToExport) {
+  console.error("The binding was built without the tree-sitter runtime.");
+  process.exit(1);
+}
+
+function best(f) {
+  let best = Infinity;
+  for (let i = 0; i < iterations; ++i) {
+    const start = process.hrtime.bigint();
+    f();
+    best = Math.min(best, Number(process.hrtime.bigint() - start) / 1e6);
+  }
+  return best;
+}
+
+function report(name, bytes, ms) {
+  console.log(
+    `  ${name.padEnd(20)} ${ms.toFixed(3).padStart(9)} ms` +
+      ` ${(bytes / ms / 1e3).toFixed(2).padStart(8)} MB/s`,
+  );
+}
+
+// Read the kind and range of every node, like a renderer would.
+function walkCursor(tree) {
+  let sum = 0;
+  const cursor = tree.walk();
+  for (;;) {
+    sum += cursor.nodeType.length + cursor.startIndex + cursor.endIndex;
+    if (cursor.gotoFirstChild()) {
+      continue;
+    }
+    while (!cursor.gotoNextSibling()) {
+      if (!cursor.gotoParent()) {
+        return sum;
+      }
+    }
+  }
+}
+
+function walkExported(tree) {
+  let sum = 0;
+  for (let node = 0; node < tree.nodeCount; ++node) {
+    sum += tree.kind(node).length + tree.startByte(node) + tree.endByte(node);
+  }
+  return sum;
+}
+
+const parser = new Parser();
+parser.setLanguage(Djot);
+for (const file of files) {
+  const text = fs.readFileSync(file, "utf8");
+  const bytes = Buffer.byteLength(text);
+  console.log(file);
+
+  let tree;
+  report("parse", bytes, best(() => (tree = parser.parse(text))));
+  report("cursor walk", bytes, best(() => walkCursor(tree)));
+
+  let exported;
+  report("parse and export", bytes, best(() => (exported = Djot.parseToExport(text))));
+  const reader = new Djot.ExportedTree(exported, Djot.kindNames);
+  report("exported walk", bytes, best(() => walkExported(reader)));
+}
@@ -0,0 +1,95 @@
+"""Compares reading every node of a tree through a tree-sitter cursor with
+reading it from an exported tree, in the Python binding.
+
+Usage: python bench/export.py [-n ITERATIONS] FILE...
+
+Needs the `tree_sitter` package, and the binding built with the tree-sitter
+runtime.
+"""
+
+import argparse
+import sys
+from time import perf_counter
+
+import tree_sitter_djot
+from tree_sitter import Language, Parser
+
+if "parse_many" not in tree_sitter_djot.__all__:
+    sys.exit("The binding was built without the tree-sitter runtime.")
+
+
+def best(f, iterations):
+    times = []
+    for _ in range(iterations):
+        start = perf_counter()
+        f()
+        times.append(perf_counter() - start)
+    return min(times)
+
+
+def report(name, size, seconds):
+    print(f"  {name:20} {seconds * 1e3:9.3f} ms {size / seconds / 1e6:8.2f} MB/s")
+
+
+# Read the kind and range of every node, like a renderer would.
+def walk_cursor(tree):
+    total = 0
+    cursor = tree.walk()
+    while True:
+        node = cursor.node
+        total += len(node.type) + node.start_byte + node.end_byte
+        if cursor.goto_first_child():
+            continue
+        while not cursor.goto_next_sibling():
+            if not cursor.goto_parent():
+                return total
+
+
+def walk_exported(tree):
+    total = 0
+    for node in range(tree.node_count):
+        total += len(tree.kind(node)) + tree.start_byte(node) + tree.end_byte(node)
+    return total
+
+
+def new_parser():
+    # The constructors changed between tree-sitter 0.21 and 0.22.
+    try:
+        language = Language(tree_sitter_djot.language())
+    except TypeError:
+        language = Language(tree_sitter_djot.language(), "djot")
+    try:
+        return Parser(language)
+    except TypeError:
+        parser = Parser()
+        parser.set_language(language)
+        return parser
+
+
+def main():
+    args = argparse.ArgumentParser()
+    args.add_argument("-n", type=int, default=10, dest="iterations")
+    args.add_argument("files", nargs="+")
+    args = args.parse_args()
+
+    parser = new_parser()
+    names = tree_sitter_djot.kind_names()
+    for path in args.files:
+        with open(path, "rb") as f:
+            text = f.read()
+        print(path)
+
+        tree = parser.parse(text)
+        report("parse", len(text), best(lambda: parser.parse(text), args.iterations))
+        report("cursor walk", len(text), best(lambda: walk_cursor(tree), args.iterations))
+
+        def parse_and_export():
+            return tree_sitter_djot.parse_many([text], threads=1, export=True)
+
+        exported = tree_sitter_djot.ExportedTree(parse_and_export()[0]["export"], names)
+        report("parse and export", len(text), best(parse_and_export, args.iterations))
+        report("exported walk", len(text), best(lambda: walk_exported(exported), args.iterations))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,66 @@
+//! Reading every node of a tree through a tree-sitter cursor, compared to reading it from an
+//! exported tree.
+//!
+//! Runs on the generated corpus (`make bench/corpus`). Run it with `make bench-export`.
+
+use std::fs;
+use std::path::Path;
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use tree_sitter::Tree;
+use tree_sitter_djot::export::{export, ExportedTree};
+
+// Read the kind and range of every node, like a renderer would.
+fn walk_cursor(tree: &Tree) -> usize {
+    let mut sum = 0;
+    let mut cursor = tree.walk();
+    loop {
+        let node = cursor.node();
+        sum += node.kind_id() as usize + node.start_byte() + node.end_byte();
+        if cursor.goto_first_child() {
+            continue;
+        }
+        while !cursor.goto_next_sibling() {
+            if !cursor.goto_parent() {
+                return sum;
+            }
+        }
+    }
+}
+
+fn walk_exported(tree: &ExportedTree) -> usize {
+    (0..tree.node_count())
+        .map(|node| tree.kind_id(node) as usize + tree.start_byte(node) + tree.end_byte(node))
+        .sum()
+}
+
+fn bench_export(c: &mut Criterion) {
+    let corpus = Path::new(env!("CARGO_MANIFEST_DIR")).join("bench/corpus");
+    let mut paths: Vec<_> = fs::read_dir(&corpus)
+        .expect("Generate the corpus with `make bench/corpus` first")
+        .map(|entry| entry.unwrap().path())
+        .collect();
+    paths.sort();
+
+    let mut parser = tree_sitter::Parser::new();
+    parser
+        .set_language(tree_sitter_djot::language())
+        .expect("Error loading Djot language");
+    for path in paths {
+        let source = fs::read(&path).unwrap();
+        let tree = parser.parse(&source, None).unwrap();
+        let data = export(&tree);
+        let exported = ExportedTree::new(&data).unwrap();
+
+        let name = path.file_name().unwrap().to_string_lossy();
+        let mut group = c.benchmark_group(name);
+        group.throughput(Throughput::Bytes(source.len() as u64));
+        group.bench_function("cursor walk", |b| b.iter(|| walk_cursor(&tree)));
+        group.bench_function("export", |b| b.iter(|| export(&tree)));
+        group.bench_function("exported walk", |b| b.iter(|| walk_exported(&exported)));
+        group.finish();
+    }
+}
+
+criterion_group!(benches, bench_export);
+criterion_main!(benches);
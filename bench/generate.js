@@ -0,0 +1,272 @@
+// Generates the documents used by `make bench`.
+//
+// Usage: node bench/generate.js [OUT_DIR] [SIZE_IN_BYTES]
+//
+// The output is deterministic, so timings are comparable between runs.
+
+const fs = require("fs");
+const path = require("path");
+
+const outDir = process.argv[2] || path.join(__dirname, "corpus");
+const targetSize = parseInt(process.argv[3] || "1048576", 10);
+
+// A small xorshift generator, seeded so every run produces the same corpus.
+let seed = 0x2545f491;
+function random() {
+  seed ^= seed << 13;
+  seed ^= seed >>> 17;
+  seed ^= seed << 5;
+  return (seed >>> 0) / 0x100000000;
+}
+function pick(xs) {
+  return xs[Math.floor(random() * xs.length)];
+}
+function int(min, max) {
+  return min + Math.floor(random() * (max - min + 1));
+}
+
+const WORDS = [
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+  "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore",
+  "et", "dolore", "magna", "aliqua", "enim", "ad", "minim", "veniam",
+  "quis", "nostrud", "exercitation", "ullamco", "laboris", "nisi",
+];
+
+function words(n) {
+  const res = [];
+  for (let i = 0; i < n; ++i) {
+    res.push(pick(WORDS));
+  }
+  return res.join(" ");
+}
+
+function inline(n) {
+  const res = [];
+  for (let i = 0; i < n; ++i) {
+    const w = pick(WORDS);
+    switch (int(0, 11)) {
+      case 0:
+        res.push(`_${w}_`);
+        break;
+      case 1:
+        res.push(`*${w}*`);
+        break;
+      case 2:
+        res.push(`\`${w}\``);
+        break;
+      case 3:
+        res.push(`[${w}](https://example.com/${w})`);
+        break;
+      case 4:
+        res.push(`{=${w}=}`);
+        break;
+      default:
+        res.push(w);
+    }
+  }
+  return res.join(" ");
+}
+
+function paragraph() {
+  const lines = [];
+  for (let i = int(1, 4); i > 0; --i) {
+    lines.push(inline(int(6, 14)));
+  }
+  return lines.join("\n") + "\n";
+}
+
+function heading(level) {
+  return "#".repeat(level) + " " + words(int(2, 5)) + "\n";
+}
+
+const ROMAN = ["i", "ii", "iii", "iv", "v", "vi", "vii", "viii", "ix", "x"];
+const ORDERED_MARKERS = [
+  (i) => `${i + 1}.`,
+  (i) => `${i + 1})`,
+  (i) => `(${i + 1})`,
+  (i) => `${String.fromCharCode(97 + (i % 26))}.`,
+  (i) => `${String.fromCharCode(65 + (i % 26))})`,
+  (i) => `${ROMAN[i % ROMAN.length]}.`,
+  (i) => `(${ROMAN[i % ROMAN.length].toUpperCase()})`,
+];
+
+function list(depth) {
+  const kind = int(0, 4);
+  const marker = pick(ORDERED_MARKERS);
+  const bullet = pick(["-", "*", "+"]);
+  const indent = "  ".repeat(depth);
+  const tight = random() < 0.7;
+  const items = [];
+  for (let i = 0; i < int(2, 8); ++i) {
+    let item;
+    switch (kind) {
+      case 0:
+        item = `${indent}${bullet} ${inline(int(3, 10))}\n`;
+        break;
+      case 1:
+        item = `${indent}${bullet} [${pick([" ", "x"])}] ${words(int(3, 8))}\n`;
+        break;
+      case 2:
+        item = `${indent}: ${words(int(1, 3))}\n\n${indent}  ${inline(
+          int(4, 10),
+        )}\n`;
+        break;
+      default:
+        item = `${indent}${marker(i)} ${inline(int(3, 10))}\n`;
+    }
+    if (depth < 2 && random() < 0.2) {
+      item += (tight ? "" : "\n") + list(depth + 1);
+    }
+    items.push(item);
+  }
+  return items.join(tight ? "" : "\n");
+}
+
+// Each kind returns a document built from repeated blocks.
+const KINDS = {
+  prose: () => {
+    const blocks = [heading(int(1, 3))];
+    for (let i = int(2, 6); i > 0; --i) {
+      blocks.push(paragraph());
+    }
+    return blocks;
+  },
+  lists: () => [list(0)],
+};
+
+// A document with `count` references to link reference definitions and
+// footnotes, one in a hundred of them to a label that isn't defined.
+function references(count) {
+  const parts = [];
+  for (let i = 0; i < count / 4; ++i) {
+    const label = i % 100 == 99 ? `missing ${i}` : `ref ${i}`;
+    parts.push(
+      `${inline(int(3, 8))} [${words(2)}][${label}] ${words(3)}[^note-${i}]\n` +
+        `${words(int(2, 6))} ![${words(1)}][${label}] and [${label}][].\n`,
+    );
+    parts.push(`[ref ${i}]: https://example.com/${i}\n`);
+    parts.push(`[^note-${i}]: ${inline(int(4, 10))}\n`);
+  }
+  return parts.join("\n");
+}
+
+// A document with `count` headings of nested sections, each with a short
+// paragraph, for the outline.
+function headings(count) {
+  const parts = [];
+  let level = 1;
+  for (let i = 0; i < count; ++i) {
+    level = Math.max(1, Math.min(4, level + int(-1, 1)));
+    parts.push(heading(level));
+    parts.push(`${words(int(1, 3))}\n`);
+  }
+  return parts.join("\n");
+}
+
+// A document with `count` code blocks and math between paragraphs, for the
+// injections. The code is picked from a few snippets, like in documentation
+// that repeats its examples.
+function code(count) {
+  const snippets = [];
+  for (let i = 0; i < 50; ++i) {
+    const lines = [];
+    for (let j = int(2, 12); j > 0; --j) {
+      lines.push(`${"  ".repeat(int(0, 2))}${words(int(2, 6))};`);
+    }
+    snippets.push(lines.join("\n"));
+  }
+  const parts = [];
+  for (let i = 0; i < count; ++i) {
+    parts.push(`${inline(int(4, 10))} $\`x^${i}\`\n`);
+    parts.push(
+      "```" + pick(["c", "js", "python", "rust"]) + "\n" + pick(snippets) +
+        "\n```\n",
+    );
+  }
+  return parts.join("\n");
+}
+
+// Break `rate` of the lines of `text` like a half-finished paste would: cut
+// them off, drop the lines after them, or add markers that are never closed.
+function corrupt(text, rate) {
+  const lines = text.split("\n");
+  const res = [];
+  for (let i = 0; i < lines.length; ++i) {
+    let line = lines[i];
+    if (line.length > 0 && random() < rate) {
+      const at = int(0, line.length);
+      switch (int(0, 2)) {
+        case 0:
+          line = line.slice(0, at);
+          break;
+        case 1:
+          line = line.slice(0, at);
+          i += int(1, 5);
+          break;
+        default:
+          line =
+            line.slice(0, at) +
+            pick(["{", "{=", "[", "](", "`", "$`", "|", ":::", "```", "{#"]) +
+            line.slice(at);
+      }
+    }
+    res.push(line);
+  }
+  return res.join("\n");
+}
+
+// A document with `count` paragraphs of long inline verbatim, for the
+// verbatim scanning. Some have backticks inside and some are never closed,
+// so they run to the end of the paragraph.
+function verbatim(count) {
+  const parts = [];
+  for (let i = 0; i < count; ++i) {
+    const lines = [];
+    for (let j = int(5, 20); j > 0; --j) {
+      lines.push(words(int(8, 16)));
+    }
+    const content = lines.join("\n");
+    switch (i % 3) {
+      case 0:
+        parts.push(`${words(3)} \`${content}\` ${words(3)}\n`);
+        break;
+      case 1: {
+        const ticked = content
+          .split(" ")
+          .map((w, k) => (k > 0 && random() < 0.1 ? "`" + w : w))
+          .join(" ");
+        parts.push(`${words(3)} \`\`${ticked}\`\` ${words(3)}\n`);
+        break;
+      }
+      default:
+        parts.push(`${words(3)} \`${content}\n`);
+    }
+  }
+  return parts.join("\n");
+}
+
+fs.mkdirSync(outDir, { recursive: true });
+for (const [name, block] of Object.entries(KINDS)) {
+  const parts = [];
+  let size = 0;
+  while (size < targetSize) {
+    for (const part of block()) {
+      parts.push(part);
+      size += part.length + 1;
+    }
+  }
+  fs.writeFileSync(path.join(outDir, `${name}.dj`), parts.join("\n"));
+}
+fs.writeFileSync(path.join(outDir, "references.dj"), references(10000));
+fs.writeFileSync(path.join(outDir, "headings.dj"), headings(100000));
+fs.writeFileSync(path.join(outDir, "code.dj"), code(5000));
+// The same prose with more and more of it broken, for `make bench-errors`.
+const prose = fs.readFileSync(path.join(outDir, "prose.dj"), "utf8");
+fs.mkdirSync(path.join(outDir, "broken"), { recursive: true });
+for (const percent of [0, 1, 5, 20]) {
+  fs.writeFileSync(
+    path.join(outDir, "broken", `prose-${String(percent).padStart(2, "0")}.dj`),
+    corrupt(prose, percent / 100),
+  );
+}
+fs.writeFileSync(path.join(outDir, "verbatim.dj"), verbatim(1500));
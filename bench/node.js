@@ -0,0 +1,105 @@
+// Compares parsing on the event loop with parsing on the libuv thread pool
+// through the Node binding, for many small documents.
+//
+// Usage: node bench/node.js [-d DOC_SIZE] [-b BATCH] [-j THREADS,...] FILE...
+//
+// The files are cut into documents of about DOC_SIZE bytes at blank lines,
+// which are handed to `parseMany` BATCH at a time with each number of
+// threads. The sync run parses them one by one with `parseToExport`.
+
+const fs = require("fs");
+const { monitorEventLoopDelay } = require("perf_hooks");
+
+let docSize = 4096;
+let batchSize = 256;
+let threadCounts = [1, 2, 4, 8];
+const files = [];
+for (let i = 2; i < process.argv.length; ++i) {
+  const arg = process.argv[i];
+  if (arg === "-d") {
+    docSize = parseInt(process.argv[++i], 10);
+  } else if (arg === "-b") {
+    batchSize = parseInt(process.argv[++i], 10);
+  } else if (arg === "-j") {
+    threadCounts = process.argv[++i].split(",").map((n) => parseInt(n, 10));
+  } else {
+    files.push(arg);
+  }
+}
+if (files.length === 0) {
+  console.error(
+    "usage: node bench/node.js [-d DOC_SIZE] [-b BATCH] [-j N,...] FILE...",
+  );
+  process.exit(1);
+}
+
+// The pool is created on first use, so it can still be made large enough.
+if (!process.env.UV_THREADPOOL_SIZE) {
+  process.env.UV_THREADPOOL_SIZE = String(Math.max(...threadCounts));
+}
+const binding = require("../bindings/node");
+if (!binding.parseMany) {
+  console.error("The binding was built without the tree-sitter runtime.");
+  process.exit(1);
+}
+
+const docs = [];
+for (const file of files) {
+  const text = fs.readFileSync(file);
+  let start = 0;
+  while (start < text.length) {
+    let end = text.indexOf("\n\n", start + docSize);
+    end = end === -1 ? text.length : end + 2;
+    docs.push(text.subarray(start, end));
+    start = end;
+  }
+}
+const totalBytes = docs.reduce((sum, doc) => sum + doc.length, 0);
+
+function report(name, start, delay) {
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  console.log(
+    `${name.padEnd(12)} ${(docs.length / seconds).toFixed(0).padStart(8)} docs/s` +
+      `  ${(totalBytes / seconds / 1e6).toFixed(1).padStart(7)} MB/s` +
+      `  max event loop delay ${(delay.max / 1e6).toFixed(1)} ms`,
+  );
+}
+
+async function main() {
+  console.log(
+    `${docs.length} documents, ${(totalBytes / 1e6).toFixed(1)} MB, ` +
+      `batches of ${batchSize}, UV_THREADPOOL_SIZE=${process.env.UV_THREADPOOL_SIZE}`,
+  );
+
+  // The delay monitor only sees the event loop between parses, so a timer
+  // keeps it busy to show how long the loop was blocked.
+  const timer = setInterval(() => {}, 1);
+
+  let delay = monitorEventLoopDelay({ resolution: 1 });
+  delay.enable();
+  let start = process.hrtime.bigint();
+  for (let i = 0; i < docs.length; ++i) {
+    binding.parseToExport(docs[i]);
+    // Yield now and then, like a server handling one request at a time.
+    if (i % 64 === 0) {
+      await new Promise(setImmediate);
+    }
+  }
+  delay.disable();
+  report("sync", start, delay);
+
+  for (const threads of threadCounts) {
+    delay = monitorEventLoopDelay({ resolution: 1 });
+    delay.enable();
+    start = process.hrtime.bigint();
+    for (let i = 0; i < docs.length; i += batchSize) {
+      await binding.parseMany(docs.slice(i, i + batchSize), threads);
+    }
+    delay.disable();
+    report(`threads ${threads}`, start, delay);
+  }
+
+  clearInterval(timer);
+}
+
+main();
@@ -0,0 +1,91 @@
+//! Parsing a directory of small files with `parse_paths_parallel`, compared to one parser
+//! reading and parsing them in turn.
+//!
+//! The generated corpus (`make bench/corpus`) is cut at blank lines into files of about 4 KB,
+//! written to a temporary directory. Run it with `make bench-rust`.
+
+use std::fs;
+use std::path::{Path, PathBuf};
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use tree_sitter_djot::parallel::{parse_paths_parallel, ParserPool};
+
+const FILE_SIZE: usize = 4096;
+
+fn write_files(dir: &Path) -> (Vec<PathBuf>, u64) {
+    let corpus = Path::new(env!("CARGO_MANIFEST_DIR")).join("bench/corpus");
+    let mut entries: Vec<_> = fs::read_dir(&corpus)
+        .expect("Generate the corpus with `make bench/corpus` first")
+        .map(|entry| entry.unwrap().path())
+        .collect();
+    entries.sort();
+
+    fs::create_dir_all(dir).unwrap();
+    let mut paths = Vec::new();
+    let mut total = 0;
+    for entry in entries {
+        let text = fs::read(&entry).unwrap();
+        let mut start = 0;
+        while start < text.len() {
+            let from = (start + FILE_SIZE).min(text.len());
+            let end = text[from..]
+                .windows(2)
+                .position(|w| w == b"\n\n")
+                .map_or(text.len(), |i| from + i + 2);
+            let path = dir.join(format!("{}.dj", paths.len()));
+            fs::write(&path, &text[start..end]).unwrap();
+            paths.push(path);
+            total += (end - start) as u64;
+            start = end;
+        }
+    }
+    (paths, total)
+}
+
+fn bench_parse_paths(c: &mut Criterion) {
+    let dir = std::env::temp_dir().join(format!("tree-sitter-djot-bench-{}", std::process::id()));
+    let (paths, total) = write_files(&dir);
+
+    let mut group = c.benchmark_group(format!("parse {} files", paths.len()));
+    group.throughput(Throughput::Bytes(total));
+
+    group.bench_function("sequential", |b| {
+        let mut parser = tree_sitter::Parser::new();
+        parser
+            .set_language(tree_sitter_djot::language())
+            .expect("Error loading Djot language");
+        b.iter(|| {
+            for path in &paths {
+                let source = fs::read(path).unwrap();
+                parser.parse(&source, None).unwrap();
+            }
+        })
+    });
+
+    let pool = ParserPool::new();
+    group.bench_function("parse_paths_parallel", |b| {
+        b.iter(|| parse_paths_parallel(&pool, &paths, |file| file.timing))
+    });
+    group.finish();
+
+    // Where the time goes, summed over all threads.
+    let timings = parse_paths_parallel(&pool, &paths, |file| file.timing);
+    let read: f64 = timings
+        .iter()
+        .map(|t| t.as_ref().unwrap().read.as_secs_f64())
+        .sum();
+    let parse: f64 = timings
+        .iter()
+        .map(|t| t.as_ref().unwrap().parse.as_secs_f64())
+        .sum();
+    println!(
+        "per file: read {:.1} µs, parse {:.1} µs",
+        read * 1e6 / paths.len() as f64,
+        parse * 1e6 / paths.len() as f64
+    );
+
+    fs::remove_dir_all(&dir).unwrap();
+}
+
+criterion_group!(benches, bench_parse_paths);
+criterion_main!(benches);
@@ -0,0 +1,61 @@
+"""Measures how `parse_many` scales with the number of threads.
+
+Usage: python bench/python.py [-d DOC_SIZE] [-j THREADS,...] [-n ITERATIONS] FILE...
+
+The files are cut into documents of about DOC_SIZE bytes at blank lines.
+"""
+
+import argparse
+import sys
+from time import perf_counter
+
+from tree_sitter_djot import __all__ as exported
+
+if "parse_many" not in exported:
+    sys.exit("The binding was built without the tree-sitter runtime.")
+
+from tree_sitter_djot import parse_many
+
+
+def split(text, size):
+    docs = []
+    start = 0
+    while start < len(text):
+        end = text.find(b"\n\n", start + size)
+        end = len(text) if end == -1 else end + 2
+        docs.append(text[start:end])
+        start = end
+    return docs
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-d", type=int, default=4096, dest="doc_size")
+    parser.add_argument("-j", default="1,2,4,8", dest="threads")
+    parser.add_argument("-n", type=int, default=5, dest="iterations")
+    parser.add_argument("files", nargs="+")
+    args = parser.parse_args()
+
+    docs = []
+    for path in args.files:
+        with open(path, "rb") as f:
+            docs += split(f.read(), args.doc_size)
+    total = sum(len(doc) for doc in docs)
+    print(f"{len(docs)} documents, {total / 1e6:.1f} MB")
+
+    base = None
+    for threads in [int(n) for n in args.threads.split(",")]:
+        best = float("inf")
+        for _ in range(args.iterations):
+            start = perf_counter()
+            parse_many(docs, threads=threads)
+            best = min(best, perf_counter() - start)
+        base = base or best
+        print(
+            f"threads {threads:3}  {len(docs) / best:9.0f} docs/s"
+            f"  {total / best / 1e6:7.1f} MB/s  speedup {base / best:.2f}x"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -5,13 +5,53 @@
       "dependencies": [
         "<!(node -p \"require('node-addon-api').targets\"):node_addon_api_except",
       ],
+      "variables": {
+        "ts_runtime": "<!(node bindings/node/runtime.js)",
+        # Set TREE_SITTER_DJOT_ERROR_RESYNC=1 to skip from a parse error to
+        # the next blank line in the scanner.
+        "error_resync": "<!(node -p \"['', '0'].includes(process.env.TREE_SITTER_DJOT_ERROR_RESYNC || '') ? 0 : 1\")",
+      },
       "include_dirs": [
         "src",
       ],
       "sources": [
         "bindings/node/binding.cc",
         "src/parser.c",
-        # NOTE: if your language has an external scanner, add it here.
+        "src/scanner.c",
+      ],
+      "conditions": [
+        ["error_resync==1", {
+          "defines": [
+            "TREE_SITTER_DJOT_ERROR_RESYNC",
+          ],
+        }],
+        # Parsing in the binding needs the tree-sitter runtime. The addon gets
+        # its own copy, with its symbols hidden so it can't clash with the one
+        # of node-tree-sitter. Trees never pass between the two, since the
+        # parses return exported trees.
+        ["ts_runtime!=''", {
+          "sources": [
+            "bindings/node/parse.cc",
+            "lib/export.c",
+            "<(ts_runtime)/src/lib.c",
+          ],
+          "include_dirs": [
+            "bindings/c",
+            "<(ts_runtime)/include",
+            "<(ts_runtime)/src",
+          ],
+          "defines": [
+            "TREE_SITTER_DJOT_PARSE",
+            "_POSIX_C_SOURCE=200112L",
+            "_DEFAULT_SOURCE",
+          ],
+          "cflags": [
+            "-fvisibility=hidden",
+          ],
+          "xcode_settings": {
+            "GCC_SYMBOLS_PRIVATE_EXTERN": "YES",
+          },
+        }],
       ],
       "cflags_c": [
         "-std=c11",
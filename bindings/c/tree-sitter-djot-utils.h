@@ -0,0 +1,478 @@
+#ifndef TREE_SITTER_DJOT_UTILS_H_
+#define TREE_SITTER_DJOT_UTILS_H_
+
+// Helpers for working with Djot syntax trees, built on top of the tree-sitter
+// runtime. Build them with `make utils`.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tree_sitter/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The deepest section nesting a boundary can record.
+#define TREE_SITTER_DJOT_MAX_SECTION_DEPTH 16
+
+// A boundary between two top-level blocks, where a parse can be resumed.
+//
+// Sections are the only blocks that are open at a boundary, so the state of
+// the external scanner is fully described by the levels of those sections.
+typedef struct {
+  uint32_t start_byte;
+  TSPoint start_point;
+  // The number of open sections.
+  uint8_t section_depth;
+  // The heading levels of the open sections, outermost first.
+  uint8_t section_levels[TREE_SITTER_DJOT_MAX_SECTION_DEPTH];
+} TSDjotBoundary;
+
+// Collect the boundaries before every top-level block of `tree`, including the
+// blocks nested inside sections.
+//
+// If `tree` was parsed with `tree_sitter_djot_parse_from`, pass the boundary
+// it was parsed from as `base` so the open sections before it are accounted
+// for. Otherwise pass NULL.
+//
+// Boundaries next to syntax errors are skipped, as are the ones nested deeper
+// than `TREE_SITTER_DJOT_MAX_SECTION_DEPTH`.
+//
+// Returns an array allocated with `malloc` that the caller must `free`, and
+// writes its length to `length`.
+TSDjotBoundary *tree_sitter_djot_boundaries(const TSTree *tree,
+                                            const TSDjotBoundary *base,
+                                            uint32_t *length);
+
+// Parse `string` starting from `boundary` instead of from the beginning.
+//
+// Only the bytes after the boundary are read, so when a document only grows at
+// the end, the parse costs are proportional to the last block and the
+// appended text. Nodes in the returned tree have positions relative to the
+// start of `string`, and the sections open at `boundary` are not part of it.
+//
+// The included ranges of `parser` are reset afterwards.
+TSTree *tree_sitter_djot_parse_from(TSParser *parser,
+                                    const TSDjotBoundary *boundary,
+                                    const char *string, uint32_t length);
+
+typedef enum {
+  TSDjotLineBlank,
+  // The first byte can't start a block marker, so this is text or a
+  // continuation of the block before it.
+  TSDjotLineText,
+  // The first byte is one of `#`, `>`, `|`, a backtick, `:`, `-`, `*`, `+`,
+  // `[` or a digit, which the external scanner looks at to open and close
+  // blocks.
+  TSDjotLineMarker,
+} TSDjotLineKind;
+
+// A line in the index built by `tree_sitter_djot_lines`.
+typedef struct {
+  uint32_t start_byte;
+  // Whitespace before the first byte, saturated at `UINT16_MAX`.
+  uint16_t indent;
+  // The first byte that isn't whitespace, or 0 for blank lines.
+  char first;
+  uint8_t kind;
+} TSDjotLine;
+
+// Index the lines of `string` without parsing it, with SIMD where available.
+// The split points, the streaming parse and the chunked parse find their
+// lines with the same scan.
+//
+// Returns an array allocated with `malloc` that the caller must `free`, and
+// writes its length to `count`.
+TSDjotLine *tree_sitter_djot_lines(const char *string, uint32_t length,
+                                   uint32_t *count);
+
+// Find boundaries to split `string` into chunks of at least `chunk_size`
+// bytes, without parsing it.
+//
+// A split point is a line after a blank line that starts a heading or a
+// paragraph without indentation, outside of code blocks and divs. The levels
+// of the open sections are tracked from the headings. The first boundary is
+// always the start of `string`.
+//
+// Returns an array allocated with `malloc` that the caller must `free`, and
+// writes its length to `count`.
+TSDjotBoundary *tree_sitter_djot_split_points(const char *string,
+                                              uint32_t length,
+                                              uint32_t chunk_size,
+                                              uint32_t *count);
+
+// A part of a document that was parsed on its own.
+typedef struct {
+  // Nodes have positions relative to the start of the whole document.
+  TSTree *tree;
+  // Where the chunk starts, with the sections that are open there.
+  TSDjotBoundary start;
+  uint32_t end_byte;
+  TSPoint end_point;
+} TSDjotChunk;
+
+// Split `string` with `tree_sitter_djot_split_points` and parse the chunks on
+// `thread_count` threads, each with its own parser.
+//
+// Chunks that end inside a code block, raw block or div that the split missed
+// are parsed again together with the next chunk, so every chunk tree is the
+// same as the corresponding part of a full parse, apart from the sections
+// open at its start. When a chunk still ends inside a block after a few
+// merges, the rest of the document is parsed with it as one chunk.
+//
+// Returns an array in document order that must be freed with
+// `tree_sitter_djot_chunks_delete`, and writes its length to `chunk_count`,
+// or NULL if memory runs out.
+TSDjotChunk *tree_sitter_djot_parse_chunked(const char *string,
+                                            uint32_t length,
+                                            uint32_t chunk_size,
+                                            uint32_t thread_count,
+                                            uint32_t *chunk_count);
+
+// Delete the trees of `chunks` and free the array.
+void tree_sitter_djot_chunks_delete(TSDjotChunk *chunks, uint32_t count);
+
+// Parse only the part of `string` from `start_byte` to `end_byte`, like the
+// lines visible in an editor, and `margin` bytes around it, so the time to
+// the first highlight doesn't depend on the size of the document.
+//
+// The parse starts at the last of `boundaries` before the margin and stops at
+// the first one after it, or at the ends of `string`. Pass the boundaries from
+// `tree_sitter_djot_boundaries` of an earlier parse, or from
+// `tree_sitter_djot_split_points`, which can be found once and kept while the
+// document is open. They must be in document order. Boundaries that are
+// shifted by edits since then are only safe if the edits didn't change the
+// blocks around them; boundaries past the end of `string` are ignored.
+//
+// The result is like a chunk of `tree_sitter_djot_parse_chunked`: nodes have
+// positions relative to the start of `string`, and the sections open at the
+// start are recorded in `result->start` but are not part of the tree, because
+// tree-sitter always starts the external scanner without open blocks. Delete
+// the tree with `ts_tree_delete`.
+//
+// The included ranges of `parser` are reset afterwards. Returns false if the
+// parse was cancelled or timed out.
+bool tree_sitter_djot_parse_viewport(TSParser *parser,
+                                     const TSDjotBoundary *boundaries,
+                                     uint32_t boundary_count,
+                                     const char *string, uint32_t length,
+                                     uint32_t start_byte, uint32_t end_byte,
+                                     uint32_t margin, TSDjotChunk *result);
+
+// A part of a streamed document.
+typedef struct {
+  // Node positions are relative to the start of the part.
+  const TSTree *tree;
+  uint64_t start_byte;
+  uint64_t start_row;
+  // The sections open at the start of the part, as in `TSDjotBoundary`.
+  uint8_t section_depth;
+  uint8_t section_levels[TREE_SITTER_DJOT_MAX_SECTION_DEPTH];
+} TSDjotStreamPart;
+
+// Called for every part of a streamed document in order. The tree is deleted
+// when the callback returns, so copy what you need. Return false to stop.
+typedef bool (*TSDjotStreamCallback)(void *payload,
+                                     const TSDjotStreamPart *part);
+
+// Parse the input read from `fd` in parts of at least `part_size` bytes,
+// split like `tree_sitter_djot_split_points`, and hand each part to
+// `callback`.
+//
+// Only the part being parsed is kept in memory, so memory use is bounded by
+// the largest part rather than by the size of the input. A part can't be
+// larger than 2 GiB.
+//
+// A part that ends inside a code block, raw block or div is parsed again
+// with the lines after it, until the part is 8 times `part_size`. If the
+// block is still open, the part is cut there anyway, and the rest of the
+// block is parsed as part of the next one.
+//
+// Returns false if reading fails, with `errno` set, or if a parse times out or
+// is cancelled, with `errno` set to ECANCELED. The parts before it have been
+// handed to `callback` then.
+bool tree_sitter_djot_parse_stream(TSParser *parser, int fd,
+                                   uint32_t part_size,
+                                   TSDjotStreamCallback callback,
+                                   void *payload);
+
+// A range of a document in another language, like the code of a code block.
+typedef struct {
+  // The name of the language, which points into the source, or to "latex"
+  // for math and "comment" for comments, and isn't NUL-terminated.
+  const char *language;
+  uint32_t language_length;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  TSPoint start_point;
+  TSPoint end_point;
+  // A hash of the language and the content.
+  uint32_t hash;
+  // The index of the first injection with the same language and content,
+  // which is the index of this one if there's none before it.
+  uint32_t first;
+} TSDjotInjection;
+
+// List the injections of `tree`, parsed from `source`, that touch the range
+// from `start_byte` to `end_byte`, without parsing them. These are the same
+// as the ones of `queries/injections.scm`: code blocks and raw blocks with a
+// language, raw inlines, math, the frontmatter and comments.
+//
+// This lets an editor load languages and parse injections only when they're
+// needed, like when they scroll into view, and parse identical blocks once,
+// by setting the included ranges of a parser of the language to the range of
+// an injection. Pass 0 and `UINT32_MAX` for the whole document.
+//
+// Returns an array in document order allocated with `malloc` that the caller
+// must `free`, or NULL if there are none or if memory runs out, with `errno`
+// set to `ENOMEM`, and writes its length to `count`.
+TSDjotInjection *tree_sitter_djot_injections(const TSTree *tree,
+                                             const char *source,
+                                             uint32_t start_byte,
+                                             uint32_t end_byte,
+                                             uint32_t *count);
+
+// The first four bytes of an exported tree, "DJOT" in ASCII.
+#define TREE_SITTER_DJOT_EXPORT_MAGIC 0x544F4A44
+#define TREE_SITTER_DJOT_EXPORT_VERSION 1
+// The parent of the root node.
+#define TREE_SITTER_DJOT_EXPORT_NO_PARENT UINT32_MAX
+
+// An exported tree starts with this header, followed by `node_count` nodes.
+// Fields are little-endian, so on little-endian machines an export can be
+// read in place through these structs.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t source_length;
+} TSDjotExportHeader;
+
+typedef enum {
+  TSDjotExportNamed = 1,
+  TSDjotExportMissing = 2,
+  TSDjotExportExtra = 4,
+  TSDjotExportError = 8,
+} TSDjotExportFlags;
+
+// A node of an exported tree. Nodes are stored in pre-order, so the root is
+// node 0, the first child of node `i` is node `i + 1` if `subtree_end > i +
+// 1`, and the next sibling of a child `c` is node `c.subtree_end`.
+typedef struct {
+  // The symbol of the node, as in `ts_node_symbol`. The names are given by
+  // `ts_language_symbol_name`.
+  uint16_t kind;
+  // The field of the node in its parent, or 0, as in
+  // `ts_tree_cursor_current_field_id`.
+  uint8_t field;
+  // `TSDjotExportFlags`.
+  uint8_t flags;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  // The index of the parent, or `TREE_SITTER_DJOT_EXPORT_NO_PARENT`.
+  uint32_t parent;
+  // The index after the last descendant of the node.
+  uint32_t subtree_end;
+} TSDjotExportNode;
+
+// Write every node of `tree` into a flat buffer that can be saved, mapped and
+// read in place from any language, without going through the tree-sitter
+// API for every node.
+//
+// Returns a buffer allocated with `malloc` that the caller must `free`, and
+// writes its size to `length`, or NULL with `errno` set to ENOMEM if memory
+// runs out.
+uint8_t *tree_sitter_djot_export(const TSTree *tree, size_t *length);
+
+// Called with the rendered HTML in pieces of about 64 KiB, in order. Return
+// false to stop rendering.
+typedef bool (*TSDjotHtmlCallback)(void *payload, const char *data,
+                                   size_t length);
+
+// Render `tree`, parsed from `source`, as HTML and hand it to `callback`.
+//
+// The tree is walked once to collect link reference definitions, footnotes
+// and inline attributes, and once to render it. Text is escaped straight from
+// `source` into the output. Footnotes are rendered at the end, in the order
+// they are referred to.
+//
+// Returns false if the callback stopped rendering, if `tree` covers more than
+// `length` bytes, or if memory ran out, with `errno` set to `ENOMEM`.
+bool tree_sitter_djot_render_html(const TSTree *tree, const char *source,
+                                  uint32_t length, TSDjotHtmlCallback callback,
+                                  void *payload);
+
+// Render `tree` like `tree_sitter_djot_render_html`, into a string.
+//
+// Returns a NUL-terminated string allocated with `malloc` that the caller must
+// `free`, and writes its length to `html_length`, or NULL if `tree` covers
+// more than `length` bytes or if memory ran out, with `errno` set to
+// `ENOMEM`.
+char *tree_sitter_djot_html(const TSTree *tree, const char *source,
+                            uint32_t length, size_t *html_length);
+
+// An index of the link reference definitions and footnotes of a document, and
+// of the references to them, by label.
+typedef struct TSDjotReferenceIndex TSDjotReferenceIndex;
+
+typedef enum {
+  TSDjotReferenceLink,
+  TSDjotReferenceFootnote,
+} TSDjotReferenceKind;
+
+typedef struct {
+  TSDjotReferenceKind kind;
+  uint32_t definition_count;
+  uint32_t reference_count;
+  // The range of the first definition, if there is one.
+  uint32_t start_byte;
+  uint32_t end_byte;
+} TSDjotReferenceLabel;
+
+typedef enum {
+  // A reference to a label without a definition.
+  TSDjotReferenceUnresolved,
+  // A definition of a label that was defined before. The first one is used.
+  TSDjotReferenceDuplicate,
+} TSDjotReferenceProblemType;
+
+typedef struct {
+  TSDjotReferenceProblemType type;
+  TSDjotReferenceKind kind;
+  // The range of the reference or definition.
+  uint32_t start_byte;
+  uint32_t end_byte;
+} TSDjotReferenceProblem;
+
+// Index the definitions and references in `tree`, parsed from `source`, in
+// one walk. Labels are hashed with whitespace collapsed, so lookups take
+// constant time. If memory runs out for a larger table of labels, labels are
+// added to the old one until it's full, and then left out with their
+// definitions and references.
+//
+// Returns NULL if memory runs out, with `errno` set to `ENOMEM`. Delete the
+// index with `tree_sitter_djot_reference_index_delete`.
+TSDjotReferenceIndex *tree_sitter_djot_reference_index_new(const TSTree *tree,
+                                                          const char *source);
+
+void tree_sitter_djot_reference_index_delete(TSDjotReferenceIndex *self);
+
+// Find the label of `kind` written as `label`, which may be surrounded by
+// other whitespace than in the document.
+//
+// Returns false if nothing in the document has the label.
+bool tree_sitter_djot_reference_index_lookup(TSDjotReferenceIndex *self,
+                                            TSDjotReferenceKind kind,
+                                            const char *label, uint32_t length,
+                                            TSDjotReferenceLabel *result);
+
+// Record an edit, with the same values as given to `ts_tree_edit`. Call this
+// for every edit between two updates.
+void tree_sitter_djot_reference_index_edit(TSDjotReferenceIndex *self,
+                                          const TSInputEdit *edit);
+
+// Bring the index up to date with `new_tree`, parsed from `source` with
+// `old_tree` after the edits. Only the ranges that were edited or that
+// `ts_tree_get_changed_ranges` reports are walked again.
+void tree_sitter_djot_reference_index_update(TSDjotReferenceIndex *self,
+                                            const TSTree *old_tree,
+                                            const TSTree *new_tree,
+                                            const char *source);
+
+// List the unresolved references and duplicate definitions in document order.
+//
+// Returns an array allocated with `malloc` that the caller must `free`, or
+// NULL if there are none, and writes its length to `count`.
+TSDjotReferenceProblem *
+tree_sitter_djot_reference_index_problems(const TSDjotReferenceIndex *self,
+                                          uint32_t *count);
+
+// The outline of a document: the headings of its sections.
+typedef struct TSDjotOutline TSDjotOutline;
+
+typedef struct {
+  // The number of `#` in the marker.
+  uint32_t level;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  // The text of the heading, without the marker and the trailing whitespace.
+  // Headings continued on more lines include the markers of those lines.
+  uint32_t title_start_byte;
+  uint32_t title_end_byte;
+  // The end of the section of the heading, which holds the sections of the
+  // headings with a higher level after it.
+  uint32_t section_end_byte;
+} TSDjotHeading;
+
+// Read the outline of `tree`, parsed from `source`. Only sections and their
+// headings are visited, not the blocks inside them, and headings that aren't
+// part of a section, like in divs, are left out.
+//
+// Returns NULL if memory runs out, with `errno` set to `ENOMEM`. Delete the
+// outline with `tree_sitter_djot_outline_delete`.
+TSDjotOutline *tree_sitter_djot_outline_new(const TSTree *tree,
+                                            const char *source);
+
+void tree_sitter_djot_outline_delete(TSDjotOutline *self);
+
+// Get the headings in document order. The array is owned by the outline and
+// is valid until the next update.
+const TSDjotHeading *tree_sitter_djot_outline_headings(const TSDjotOutline *self,
+                                                       uint32_t *count);
+
+// Record an edit, with the same values as given to `ts_tree_edit`. Call this
+// for every edit between two updates.
+void tree_sitter_djot_outline_edit(TSDjotOutline *self,
+                                   const TSInputEdit *edit);
+
+// Bring the outline up to date with `new_tree`, parsed from `source` with
+// `old_tree` after the edits. Only the sections that touch the edits or the
+// ranges that `ts_tree_get_changed_ranges` reports are read again.
+void tree_sitter_djot_outline_update(TSDjotOutline *self,
+                                     const TSTree *old_tree,
+                                     const TSTree *new_tree,
+                                     const char *source);
+
+// The fold ranges of a document.
+typedef struct TSDjotFolds TSDjotFolds;
+
+typedef struct {
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t start_row;
+  // The last row of the block, not the row after its last newline.
+  uint32_t end_row;
+} TSDjotFold;
+
+// Find the same folds in `tree` as `queries/folds.scm`, of sections, code
+// blocks, raw blocks, lists and divs, with a cursor walk instead of a query.
+// Blocks on a single row aren't folds.
+//
+// Returns NULL if memory runs out, with `errno` set to `ENOMEM`. Delete the
+// folds with `tree_sitter_djot_folds_delete`.
+TSDjotFolds *tree_sitter_djot_folds_new(const TSTree *tree);
+
+void tree_sitter_djot_folds_delete(TSDjotFolds *self);
+
+// Get the folds in document order. The array is owned by the folds and is
+// valid until the next update.
+const TSDjotFold *tree_sitter_djot_folds_ranges(const TSDjotFolds *self,
+                                                uint32_t *count);
+
+// Record an edit, with the same values as given to `ts_tree_edit`, including
+// the points. Call this for every edit between two updates.
+void tree_sitter_djot_folds_edit(TSDjotFolds *self, const TSInputEdit *edit);
+
+// Bring the folds up to date with `new_tree`, parsed with `old_tree` after the
+// edits. Only the blocks that touch the edits or the ranges that
+// `ts_tree_get_changed_ranges` reports are walked again, and the other folds
+// are kept.
+void tree_sitter_djot_folds_update(TSDjotFolds *self, const TSTree *old_tree,
+                                   const TSTree *new_tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_DJOT_UTILS_H_
@@ -9,6 +9,36 @@ extern "C" {
 
 const TSLanguage *tree_sitter_djot(void);
 
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+#include <stddef.h>
+
+// The memory allocated by the external scanners of all parsers, when the
+// scanner is built with `TREE_SITTER_DJOT_MEMORY_STATS`. The trees and the
+// parse stacks of tree-sitter aren't part of it.
+typedef struct {
+  // Bytes allocated and not freed yet.
+  size_t live_bytes;
+  // The most bytes that were live at once since the start or the last reset.
+  size_t peak_bytes;
+  // Allocations of the scanners themselves, one per parser.
+  size_t scanner_allocations;
+  // Allocations of open blocks and inline elements, once the slots inside the
+  // scanner are taken. With `TREE_SITTER_DJOT_ARENA` these are whole slabs.
+  size_t block_allocations;
+  size_t inline_allocations;
+  // Allocations when the stacks of open blocks and inline elements grow. With
+  // `TREE_SITTER_DJOT_ARENA` these are slabs too, and only when a stack needs
+  // more than the current slab has left.
+  size_t stack_allocations;
+  size_t frees;
+} TSDjotScannerMemoryStats;
+
+void tree_sitter_djot_scanner_memory_stats(TSDjotScannerMemoryStats *stats);
+
+// Set the counts to 0 and the peak to the bytes that are live now.
+void tree_sitter_djot_scanner_memory_stats_reset(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,12 +2,101 @@ package tree_sitter_djot
 
 // #cgo CFLAGS: -std=c11 -fPIC
 // #include "../../src/parser.c"
-// // NOTE: if your language has an external scanner, add it here.
+// #include "../../src/scanner.c"
 import "C"
 
-import "unsafe"
+import (
+	"bytes"
+	"context"
+	"unsafe"
+
+	sitter "github.com/smacker/go-tree-sitter"
+)
+
+// How many bytes ParseWithContext adds to the parsed prefix at a time.
+const prefixStep = 64 * 1024
 
 // Get the tree-sitter Language for this grammar.
 func Language() unsafe.Pointer {
 	return unsafe.Pointer(C.tree_sitter_djot())
 }
+
+// ParseWithContext parses content, giving up when ctx is done. It then
+// returns the tree of the longest prefix of content that ends at a blank line
+// and was parsed in time, and truncated is true.
+//
+// The parser must be set to the Djot language.
+func ParseWithContext(ctx context.Context, parser *sitter.Parser, content []byte) (tree *sitter.Tree, truncated bool, err error) {
+	tree, err = parser.ParseCtx(context.Background(), nil, []byte{})
+	if err != nil {
+		return nil, false, err
+	}
+
+	end := 0
+	endPoint := sitter.Point{}
+	for end < len(content) {
+		if ctx.Err() != nil {
+			return tree, true, nil
+		}
+
+		next := nextPrefixEnd(content, end)
+		nextPoint := advancePoint(endPoint, content[end:next])
+		oldTree := tree.Copy()
+		oldTree.Edit(sitter.EditInput{
+			StartIndex:  uint32(end),
+			OldEndIndex: uint32(end),
+			NewEndIndex: uint32(next),
+			StartPoint:  endPoint,
+			OldEndPoint: endPoint,
+			NewEndPoint: nextPoint,
+		})
+
+		nextTree, err := parser.ParseCtx(ctx, oldTree, content[:next])
+		oldTree.Close()
+		if err == sitter.ErrOperationLimit {
+			// Don't resume this parse the next time the parser is used.
+			parser.Reset()
+			return tree, true, nil
+		} else if err != nil {
+			return nil, false, err
+		}
+		tree.Close()
+		tree = nextTree
+		end = next
+		endPoint = nextPoint
+	}
+	return tree, false, nil
+}
+
+// nextPrefixEnd returns the end of the first blank line at least prefixStep
+// bytes after start, or the end of content.
+func nextPrefixEnd(content []byte, start int) int {
+	end := min(start+prefixStep, len(content))
+	for {
+		i := bytes.IndexByte(content[end:], '\n')
+		if i < 0 {
+			return len(content)
+		}
+		lineStart := end + i + 1
+		lineEnd := len(content)
+		if j := bytes.IndexByte(content[lineStart:], '\n'); j >= 0 {
+			lineEnd = lineStart + j + 1
+		}
+		if len(bytes.Trim(content[lineStart:lineEnd], " \t\r\n")) == 0 {
+			return lineEnd
+		}
+		end = lineStart
+	}
+}
+
+func advancePoint(point sitter.Point, content []byte) sitter.Point {
+	for _, b := range content {
+		if b == '\n' {
+			point.Row++
+			point.Column = 0
+		} else {
+			point.Column++
+		}
+	}
+	return point
+}
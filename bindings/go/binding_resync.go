@@ -0,0 +1,9 @@
+//go:build djot_error_resync
+
+package tree_sitter_djot
+
+// Built with `-tags djot_error_resync`, the scanner skips from a parse error
+// to the next blank line. See TREE_SITTER_DJOT_ERROR_RESYNC in src/scanner.c.
+
+// #cgo CFLAGS: -DTREE_SITTER_DJOT_ERROR_RESYNC
+import "C"
@@ -1,7 +1,10 @@
 package tree_sitter_djot_test
 
 import (
+	"context"
+	"strings"
 	"testing"
+	"time"
 
 	tree_sitter "github.com/smacker/go-tree-sitter"
 	"github.com/tree-sitter/tree-sitter-djot"
@@ -13,3 +16,48 @@ func TestCanLoadGrammar(t *testing.T) {
 		t.Errorf("Error loading Djot grammar")
 	}
 }
+
+func newParser() *tree_sitter.Parser {
+	parser := tree_sitter.NewParser()
+	parser.SetLanguage(tree_sitter.NewLanguage(tree_sitter_djot.Language()))
+	return parser
+}
+
+func TestParseWithContextCompletes(t *testing.T) {
+	content := []byte("# Heading\n\nSome *text* with [a link](url).\n")
+	tree, truncated, err := tree_sitter_djot.ParseWithContext(context.Background(), newParser(), content)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if truncated {
+		t.Errorf("Expected a complete parse")
+	}
+	if end := tree.RootNode().EndByte(); end != uint32(len(content)) {
+		t.Errorf("Expected the tree to end at %d, got %d", len(content), end)
+	}
+}
+
+func TestParseWithContextTimesOut(t *testing.T) {
+	ctx, cancel := context.WithDeadline(context.Background(), time.Now())
+	defer cancel()
+	tree, truncated, err := tree_sitter_djot.ParseWithContext(ctx, newParser(), []byte("Some text.\n"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !truncated || tree.RootNode().EndByte() != 0 {
+		t.Errorf("Expected an empty truncated parse")
+	}
+}
+
+func TestParseWithContextCancelled(t *testing.T) {
+	ctx, cancel := context.WithCancel(context.Background())
+	cancel()
+	content := []byte(strings.Repeat("Some text.\n\n", 20_000))
+	tree, truncated, err := tree_sitter_djot.ParseWithContext(ctx, newParser(), content)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !truncated || tree.RootNode().EndByte() != 0 {
+		t.Errorf("Expected an empty truncated parse")
+	}
+}
@@ -4,6 +4,10 @@ typedef struct TSLanguage TSLanguage;
 
 extern "C" TSLanguage *tree_sitter_djot();
 
+#ifdef TREE_SITTER_DJOT_PARSE
+void InitParse(Napi::Env env, Napi::Object exports);
+#endif
+
 // "tree-sitter", "language" hashed with BLAKE2
 const napi_type_tag LANGUAGE_TYPE_TAG = {
   0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16
@@ -14,6 +18,9 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
     auto language = Napi::External<TSLanguage>::New(env, tree_sitter_djot());
     language.TypeTag(&LANGUAGE_TYPE_TAG);
     exports["language"] = language;
+#ifdef TREE_SITTER_DJOT_PARSE
+    InitParse(env, exports);
+#endif
     return exports;
 }
 
@@ -0,0 +1,149 @@
+const assert = require("node:assert");
+const { test } = require("node:test");
+const Parser = require("tree-sitter");
+const language = require(".");
+
+function newParser() {
+  const parser = new Parser();
+  parser.setLanguage(language);
+  return parser;
+}
+
+test("can load grammar", () => {
+  assert.doesNotThrow(() => newParser());
+});
+
+test("parseWithTimeout completes", () => {
+  const input = "# Heading\n\nSome *text* with [a link](url).\n";
+  const { tree, truncated } = language.parseWithTimeout(
+    newParser(),
+    input,
+    10_000_000
+  );
+  assert.strictEqual(truncated, false);
+  assert.strictEqual(tree.rootNode.endIndex, input.length);
+});
+
+test("parseWithTimeout truncates", () => {
+  const parser = newParser();
+  const { tree, truncated } = language.parseWithTimeout(
+    parser,
+    "Some text.\n",
+    0
+  );
+  assert.strictEqual(truncated, true);
+  assert.strictEqual(tree.rootNode.endIndex, 0);
+
+  // The parser is usable again afterwards.
+  assert.strictEqual(parser.parse("Done\n").rootNode.endIndex, 5);
+});
+
+test("parseWithTimeout cancels between prefixes", () => {
+  // Several prefixes of 64 KiB.
+  const input = "Some text.\n\n".repeat(20_000);
+  let checks = 0;
+  const { tree, truncated } = language.parseWithTimeout(
+    newParser(),
+    input,
+    10_000_000,
+    () => ++checks > 1
+  );
+  assert.strictEqual(truncated, true);
+  // Only the first prefix was parsed.
+  assert.ok(tree.rootNode.endIndex > 0);
+  assert.ok(tree.rootNode.endIndex < input.length);
+});
+
+// The nodes of `tree` in the order a cursor visits them.
+function walk(tree) {
+  const nodes = [];
+  const cursor = tree.walk();
+  for (;;) {
+    nodes.push(cursor.currentNode);
+    if (cursor.gotoFirstChild()) {
+      continue;
+    }
+    while (!cursor.gotoNextSibling()) {
+      if (!cursor.gotoParent()) {
+        return nodes;
+      }
+    }
+  }
+}
+
+const withRuntime = {
+  skip: !language.parseMany && "built without the tree-sitter runtime",
+};
+
+const documents = [
+  "# Title\n\nSome *text*.\n\n## Section\n\n- one\n- two\n",
+  "",
+  Buffer.from("Just a paragraph with `code`.\n"),
+  "### Deep\n\n{broken\n\n# Again\n",
+];
+
+test("parseMany matches synchronous parses", withRuntime, async () => {
+  const results = await language.parseMany(documents, 3);
+  assert.strictEqual(results.length, documents.length);
+  const parser = newParser();
+  documents.forEach((source, i) => {
+    assert.deepStrictEqual(results[i], language.parseToExport(source));
+
+    const nodes = walk(parser.parse(source.toString()));
+    const tree = new language.ExportedTree(results[i], language.kindNames);
+    assert.strictEqual(tree.nodeCount, nodes.length);
+    nodes.forEach((node, j) => {
+      assert.strictEqual(tree.kind(j), node.type);
+      assert.strictEqual(tree.startByte(j), node.startIndex);
+      assert.strictEqual(tree.endByte(j), node.endIndex);
+    });
+  });
+});
+
+test("parseMany keeps the order with any thread count", withRuntime, async () => {
+  const many = Array.from({ length: 20 }, (_, i) => documents[i % 4]);
+  const expected = many.map((source) => language.parseToExport(source));
+  for (const threads of [undefined, 1, 2, 64]) {
+    assert.deepStrictEqual(await language.parseMany(many, threads), expected);
+  }
+  assert.deepStrictEqual(await language.parseMany([]), []);
+});
+
+test("parseMany rejects bad input", withRuntime, async () => {
+  await assert.rejects(async () => language.parseMany("# Title\n"), TypeError);
+  await assert.rejects(async () => language.parseMany(["# Title\n", 42]), TypeError);
+  await assert.rejects(async () => language.parseMany(documents, 0), RangeError);
+});
+
+test("ExportedTree reads little-endian", () => {
+  // A document node with one named paragraph child, at an odd offset.
+  const data = Buffer.alloc(1 + 16 + 2 * 20);
+  let offset = 1;
+  for (const word of [0x544f4a44, 1, 2, 300]) {
+    offset = data.writeUInt32LE(word, offset);
+  }
+  for (const [kind, field, flags, ...words] of [
+    [0x0102, 0, 1, 0, 300, 0xffffffff, 2],
+    [0x0203, 4, 1 | 8, 5, 0x01020304, 0, 2],
+  ]) {
+    offset = data.writeUInt16LE(kind, offset);
+    offset = data.writeUInt8(field, offset);
+    offset = data.writeUInt8(flags, offset);
+    for (const word of words) {
+      offset = data.writeUInt32LE(word, offset);
+    }
+  }
+
+  const tree = new language.ExportedTree(data.subarray(1));
+  assert.strictEqual(tree.nodeCount, 2);
+  assert.strictEqual(tree.sourceLength, 300);
+  assert.strictEqual(tree.kindId(1), 0x0203);
+  assert.strictEqual(tree.fieldId(1), 4);
+  assert.ok(tree.isNamed(1) && tree.isError(1));
+  assert.ok(!tree.isMissing(1) && !tree.isExtra(1));
+  assert.strictEqual(tree.startByte(1), 5);
+  assert.strictEqual(tree.endByte(1), 0x01020304);
+  assert.strictEqual(tree.parent(0), -1);
+  assert.strictEqual(tree.parent(1), 0);
+  assert.deepStrictEqual([...tree.children(0)], [1]);
+});
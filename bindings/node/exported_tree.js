@@ -0,0 +1,107 @@
+// A reader for trees written by `tree_sitter_djot_export`, see
+// `bindings/c/tree-sitter-djot-utils.h` for the format.
+//
+// Nodes are read straight from the buffer, which can be a file mapped into
+// memory, without creating an object for every node.
+
+const MAGIC = 0x544f4a44;
+const VERSION = 1;
+const HEADER_SIZE = 16;
+const NODE_SIZE = 20;
+const NO_PARENT = 0xffffffff;
+
+function flags(view, node) {
+  return view.getUint8(HEADER_SIZE + node * NODE_SIZE + 3);
+}
+
+class ExportedTree {
+  /**
+   * @param {Uint8Array} buffer
+   * @param {string[]} [kindNames] the names of the node kinds by id, like the
+   *   `kindNames` of the binding
+   */
+  constructor(buffer, kindNames) {
+    // The export is little-endian whatever the machine, which a `DataView`
+    // reads at any alignment.
+    this.view = new DataView(buffer.buffer, buffer.byteOffset, buffer.byteLength);
+    if (
+      this.view.byteLength < HEADER_SIZE ||
+      this.view.getUint32(0, true) !== MAGIC ||
+      this.view.getUint32(4, true) !== VERSION
+    ) {
+      throw new Error("Not an exported Djot tree");
+    }
+    this.nodeCount = this.view.getUint32(8, true);
+    this.sourceLength = this.view.getUint32(12, true);
+    if (this.view.byteLength < HEADER_SIZE + this.nodeCount * NODE_SIZE) {
+      throw new Error("Truncated exported Djot tree");
+    }
+    this.kindNames = kindNames;
+  }
+
+  kindId(node) {
+    return this.view.getUint16(HEADER_SIZE + node * NODE_SIZE, true);
+  }
+
+  /** The name of the node kind, if the names were given. */
+  kind(node) {
+    const id = this.kindId(node);
+    return id === 0xffff ? "ERROR" : this.kindNames[id];
+  }
+
+  fieldId(node) {
+    return this.view.getUint8(HEADER_SIZE + node * NODE_SIZE + 2);
+  }
+
+  isNamed(node) {
+    return (flags(this.view, node) & 1) !== 0;
+  }
+
+  isMissing(node) {
+    return (flags(this.view, node) & 2) !== 0;
+  }
+
+  isExtra(node) {
+    return (flags(this.view, node) & 4) !== 0;
+  }
+
+  isError(node) {
+    return (flags(this.view, node) & 8) !== 0;
+  }
+
+  startByte(node) {
+    return this.view.getUint32(HEADER_SIZE + node * NODE_SIZE + 4, true);
+  }
+
+  endByte(node) {
+    return this.view.getUint32(HEADER_SIZE + node * NODE_SIZE + 8, true);
+  }
+
+  /** The index of the parent, or -1 for the root. */
+  parent(node) {
+    const parent = this.view.getUint32(HEADER_SIZE + node * NODE_SIZE + 12, true);
+    return parent === NO_PARENT ? -1 : parent;
+  }
+
+  /** The index after the last descendant of the node. */
+  subtreeEnd(node) {
+    return this.view.getUint32(HEADER_SIZE + node * NODE_SIZE + 16, true);
+  }
+
+  /** The indices of the children of the node. */
+  *children(node) {
+    const end = this.subtreeEnd(node);
+    let child = node + 1;
+    while (child < end) {
+      yield child;
+      const next = this.subtreeEnd(child);
+      // Don't loop or leave the parent on a broken export.
+      if (next <= child || next > end) {
+        throw new Error(`Invalid node ${child} in exported Djot tree`);
+      }
+      child = next;
+    }
+  }
+}
+
+module.exports = { ExportedTree };
@@ -18,10 +18,65 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+/**
+ * A tree written by `tree_sitter_djot_export`, read in place. Nodes are
+ * referred to by their index in pre-order, with the root at 0.
+ */
+declare class ExportedTree {
+  constructor(buffer: Uint8Array, kindNames?: string[]);
+  readonly nodeCount: number;
+  readonly sourceLength: number;
+  kindId(node: number): number;
+  kind(node: number): string | undefined;
+  fieldId(node: number): number;
+  isNamed(node: number): boolean;
+  isMissing(node: number): boolean;
+  isExtra(node: number): boolean;
+  isError(node: number): boolean;
+  startByte(node: number): number;
+  endByte(node: number): number;
+  /** The index of the parent of the node, or -1 for the root. */
+  parent(node: number): number;
+  /** The index after the last descendant of the node. */
+  subtreeEnd(node: number): number;
+  children(node: number): IterableIterator<number>;
+}
+
 type Language = {
   name: string;
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  /**
+   * Parse `source` and return the tree in the format of
+   * `tree_sitter_djot_export`, to read with `ExportedTree`. Only available
+   * when the binding was built with the `tree-sitter` package installed.
+   */
+  parseToExport?(source: string | Buffer): Buffer;
+  /**
+   * Parse the documents on the libuv thread pool instead of blocking the
+   * event loop, and resolve to their exported trees in the same order.
+   * `threads` parses run at once, `UV_THREADPOOL_SIZE` by default. Only
+   * available like `parseToExport`.
+   */
+  parseMany?(sources: (string | Buffer)[], threads?: number): Promise<Buffer[]>;
+  /** The names of the node kinds in exported trees, by kind id. */
+  kindNames?: string[];
+  ExportedTree: typeof ExportedTree;
+  /**
+   * Parse `input` with a `tree-sitter` parser, giving up after
+   * `timeoutMicros` microseconds. If time runs out, `tree` only covers a
+   * prefix of the input that ends at a blank line and `truncated` is true.
+   *
+   * `isCancelled` is checked between prefixes, since a running parse can't be
+   * stopped. It has to read state that another thread sets, like a
+   * `SharedArrayBuffer`, because the event loop doesn't run meanwhile.
+   */
+  parseWithTimeout<Tree>(
+    parser: { parse(input: unknown, oldTree?: Tree): Tree },
+    input: string,
+    timeoutMicros: number,
+    isCancelled?: () => boolean
+  ): { tree: Tree; truncated: boolean };
 };
 
 declare const language: Language;
@@ -5,3 +5,113 @@ module.exports = require("node-gyp-build")(root);
 try {
   module.exports.nodeTypeInfo = require("../../src/node-types.json");
 } catch (_) {}
+
+module.exports.ExportedTree = require("./exported_tree").ExportedTree;
+
+// How many characters `parseWithTimeout` adds to the parsed prefix at a time.
+const PREFIX_STEP = 64 * 1024;
+
+/**
+ * Parse `input`, giving up after `timeoutMicros` microseconds with the tree
+ * of the longest prefix that ends at a blank line, as described in the
+ * README.
+ *
+ * node-tree-sitter has no cancellation flag, so a parse can't be stopped
+ * while it runs. If `isCancelled` is given, it's called before each prefix
+ * and the parse stops like on a timeout when it returns true. The event loop
+ * doesn't run during the parse, so it has to check something that another
+ * thread sets, like an `Int32Array` over a `SharedArrayBuffer` with
+ * `Atomics.load`. A prefix that has started still runs until it's done or the
+ * timeout is reached.
+ *
+ * `parser` must be a `tree-sitter` parser set to the Djot language.
+ */
+module.exports.parseWithTimeout = function (
+  parser,
+  input,
+  timeoutMicros,
+  isCancelled
+) {
+  const deadline = process.hrtime.bigint() + BigInt(timeoutMicros) * 1000n;
+  parser.setTimeoutMicros(0);
+  let tree = parser.parse("");
+  let end = 0;
+  let endPosition = { row: 0, column: 0 };
+  let truncated = false;
+
+  while (end < input.length) {
+    const remaining = (deadline - process.hrtime.bigint()) / 1000n;
+    if (remaining <= 0n || (isCancelled && isCancelled())) {
+      truncated = true;
+      break;
+    }
+
+    const next = nextPrefixEnd(input, end);
+    const nextPosition = advancePosition(endPosition, input, end, next);
+    // Trees can't be copied from JavaScript, so edit this one, and undo the
+    // edit if the parse doesn't finish.
+    tree.edit({
+      startIndex: end,
+      oldEndIndex: end,
+      newEndIndex: next,
+      startPosition: endPosition,
+      oldEndPosition: endPosition,
+      newEndPosition: nextPosition,
+    });
+
+    parser.setTimeoutMicros(Number(remaining > 1n ? remaining : 1n));
+    let nextTree;
+    try {
+      nextTree = parser.parse(prefixReader(input, next), tree);
+    } catch (_) {}
+    if (!nextTree) {
+      tree.edit({
+        startIndex: end,
+        oldEndIndex: next,
+        newEndIndex: end,
+        startPosition: endPosition,
+        oldEndPosition: nextPosition,
+        newEndPosition: endPosition,
+      });
+      // Don't resume this parse the next time the parser is used.
+      parser.reset();
+      truncated = true;
+      break;
+    }
+    tree = nextTree;
+    end = next;
+    endPosition = nextPosition;
+  }
+
+  parser.setTimeoutMicros(0);
+  return { tree, truncated };
+};
+
+// The end of the first blank line at least `PREFIX_STEP` characters after
+// `start`, or the end of `input`.
+function nextPrefixEnd(input, start) {
+  const blankLine = /\n[ \t\r]*(?:\n|$)/g;
+  blankLine.lastIndex = Math.min(start + PREFIX_STEP, input.length);
+  const match = blankLine.exec(input);
+  return match ? match.index + match[0].length : input.length;
+}
+
+function advancePosition(position, input, start, end) {
+  let { row, column } = position;
+  for (let i = start; i < end; i++) {
+    if (input.charCodeAt(i) === 10) {
+      row++;
+      column = 0;
+    } else {
+      column++;
+    }
+  }
+  return { row, column };
+}
+
+// Slicing the whole prefix for every step would copy the document over and
+// over, so hand it to the parser in pieces.
+function prefixReader(input, end) {
+  return (index) =>
+    index < end ? input.slice(index, Math.min(end, index + PREFIX_STEP)) : null;
+}
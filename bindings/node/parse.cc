@@ -0,0 +1,208 @@
+#include <napi.h>
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-djot-utils.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" const TSLanguage *tree_sitter_djot();
+
+namespace {
+
+// Parsers aren't thread-safe, so every parse takes a parser that isn't in use
+// and puts it back afterwards. There are never more parsers than threads
+// parsing at once.
+std::mutex parsers_mutex;
+std::vector<TSParser *> idle_parsers;
+
+TSParser *TakeParser() {
+    {
+        std::lock_guard<std::mutex> lock(parsers_mutex);
+        if (!idle_parsers.empty()) {
+            TSParser *parser = idle_parsers.back();
+            idle_parsers.pop_back();
+            return parser;
+        }
+    }
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_djot());
+    return parser;
+}
+
+void ReturnParser(TSParser *parser) {
+    std::lock_guard<std::mutex> lock(parsers_mutex);
+    idle_parsers.push_back(parser);
+}
+
+// Parse `source` into the format of `tree_sitter_djot_export`. Returns false
+// if the export couldn't be allocated.
+bool ParseToExport(TSParser *parser, const std::string &source,
+                   std::string *result) {
+    TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                          static_cast<uint32_t>(source.size()));
+    size_t length;
+    uint8_t *exported = tree_sitter_djot_export(tree, &length);
+    ts_tree_delete(tree);
+    if (!exported) {
+        return false;
+    }
+    result->assign(reinterpret_cast<char *>(exported), length);
+    free(exported);
+    return true;
+}
+
+// Copy a source out of a string or a buffer, so the parse doesn't depend on
+// JavaScript values that could be collected or changed while it runs.
+std::string GetSource(Napi::Env env, Napi::Value value) {
+    if (value.IsBuffer()) {
+        auto buffer = value.As<Napi::Buffer<char>>();
+        return std::string(buffer.Data(), buffer.Length());
+    }
+    if (value.IsString()) {
+        return value.As<Napi::String>().Utf8Value();
+    }
+    throw Napi::TypeError::New(env, "Expected a string or a Buffer");
+}
+
+Napi::Value ParseSync(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    std::string source = GetSource(env, info[0]);
+    TSParser *parser = TakeParser();
+    std::string result;
+    bool ok = ParseToExport(parser, source, &result);
+    ReturnParser(parser);
+    if (!ok) {
+        throw Napi::Error::New(env, "Out of memory exporting the tree");
+    }
+    return Napi::Buffer<char>::Copy(env, result.data(), result.size());
+}
+
+// The documents of one `parseMany` call, shared by the workers that parse
+// them. Each worker takes the next document that nobody has taken, so a few
+// large documents don't leave the other threads idle.
+struct Batch {
+    std::vector<std::string> sources;
+    std::vector<std::string> results;
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    // Only touched on the event loop.
+    unsigned running_workers = 0;
+    Napi::Promise::Deferred deferred;
+
+    explicit Batch(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+};
+
+class BatchWorker : public Napi::AsyncWorker {
+  public:
+    BatchWorker(Napi::Env env, std::shared_ptr<Batch> batch)
+        : Napi::AsyncWorker(env), batch_(std::move(batch)) {}
+
+  protected:
+    void Execute() override {
+        TSParser *parser = TakeParser();
+        size_t i;
+        while (!batch_->failed.load(std::memory_order_relaxed) &&
+               (i = batch_->next.fetch_add(1)) < batch_->sources.size()) {
+            if (!ParseToExport(parser, batch_->sources[i],
+                               &batch_->results[i])) {
+                batch_->failed = true;
+            }
+            // The source isn't needed anymore.
+            std::string().swap(batch_->sources[i]);
+        }
+        ReturnParser(parser);
+    }
+
+    // Settle the promise once the last worker of the batch is done.
+    void OnOK() override {
+        if (--batch_->running_workers > 0) {
+            return;
+        }
+        Napi::Env env = Env();
+        if (batch_->failed) {
+            batch_->deferred.Reject(
+                Napi::Error::New(env, "Out of memory exporting the tree")
+                    .Value());
+            return;
+        }
+        auto results = Napi::Array::New(env, batch_->results.size());
+        for (size_t i = 0; i < batch_->results.size(); ++i) {
+            const std::string &result = batch_->results[i];
+            results[i] = Napi::Buffer<char>::Copy(env, result.data(),
+                                                  result.size());
+        }
+        batch_->deferred.Resolve(results);
+    }
+
+  private:
+    std::shared_ptr<Batch> batch_;
+};
+
+// The threads of the libuv pool, which is what runs the workers.
+unsigned PoolThreads() {
+    const char *size = getenv("UV_THREADPOOL_SIZE");
+    int threads = size ? atoi(size) : 0;
+    return threads > 0 ? static_cast<unsigned>(threads) : 4;
+}
+
+// Parse the documents on the libuv thread pool, so the event loop keeps
+// running, and resolve to their exported trees in the same order.
+Napi::Value ParseMany(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        throw Napi::TypeError::New(env, "Expected an array of sources");
+    }
+    auto sources = info[0].As<Napi::Array>();
+    unsigned threads = PoolThreads();
+    if (info.Length() > 1 && info[1].IsNumber()) {
+        int requested = info[1].As<Napi::Number>().Int32Value();
+        if (requested < 1) {
+            throw Napi::RangeError::New(env, "threads must be at least 1");
+        }
+        threads = static_cast<unsigned>(requested);
+    }
+
+    auto batch = std::make_shared<Batch>(env);
+    batch->sources.reserve(sources.Length());
+    for (uint32_t i = 0; i < sources.Length(); ++i) {
+        batch->sources.push_back(GetSource(env, sources[i]));
+    }
+    batch->results.resize(batch->sources.size());
+    Napi::Promise promise = batch->deferred.Promise();
+
+    if (batch->sources.empty()) {
+        batch->deferred.Resolve(Napi::Array::New(env));
+        return promise;
+    }
+    if (threads > batch->sources.size()) {
+        threads = static_cast<unsigned>(batch->sources.size());
+    }
+    batch->running_workers = threads;
+    for (unsigned i = 0; i < threads; ++i) {
+        (new BatchWorker(env, batch))->Queue();
+    }
+    return promise;
+}
+
+} // namespace
+
+void InitParse(Napi::Env env, Napi::Object exports) {
+    exports["parseToExport"] =
+        Napi::Function::New(env, ParseSync, "parseToExport");
+    exports["parseMany"] = Napi::Function::New(env, ParseMany, "parseMany");
+
+    // The names of the node kinds in exported trees, by kind id.
+    const TSLanguage *language = tree_sitter_djot();
+    uint32_t count = ts_language_symbol_count(language);
+    auto names = Napi::Array::New(env, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        names[i] = Napi::String::New(env, ts_language_symbol_name(language, i));
+    }
+    exports["kindNames"] = names;
+}
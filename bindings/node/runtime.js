@@ -0,0 +1,14 @@
+// Prints the tree-sitter runtime sources bundled with the `tree-sitter`
+// package, or nothing if it isn't installed. `binding.gyp` compiles the
+// parsing functions of the binding against it.
+
+const fs = require("fs");
+const path = require("path");
+
+try {
+  const root = path.dirname(require.resolve("tree-sitter/package.json"));
+  const runtime = path.join(root, "vendor", "tree-sitter", "lib");
+  if (fs.existsSync(path.join(runtime, "src", "lib.c"))) {
+    process.stdout.write(runtime);
+  }
+} catch (_) {}
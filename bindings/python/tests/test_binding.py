@@ -0,0 +1,177 @@
+from struct import pack
+from unittest import TestCase, skipUnless
+
+from tree_sitter import Language, Parser
+
+import tree_sitter_djot
+
+
+def new_parser():
+    return Parser(Language(tree_sitter_djot.language()))
+
+
+class TestLanguage(TestCase):
+    def test_can_load_grammar(self):
+        try:
+            new_parser()
+        except Exception:
+            self.fail("Error loading Djot grammar")
+
+
+class TestParseWithTimeout(TestCase):
+    def test_completes(self):
+        source = b"# Heading\n\nSome *text* with [a link](url).\n"
+        tree, truncated = tree_sitter_djot.parse_with_timeout(
+            new_parser(), source, 10_000_000
+        )
+        self.assertFalse(truncated)
+        self.assertEqual(tree.root_node.end_byte, len(source))
+
+    def test_truncates(self):
+        tree, truncated = tree_sitter_djot.parse_with_timeout(
+            new_parser(), b"Some text.\n", 0
+        )
+        self.assertTrue(truncated)
+        self.assertEqual(tree.root_node.end_byte, 0)
+
+    def test_keeps_the_last_complete_prefix(self):
+        # Fails the parse of the second prefix, like a timeout in it would.
+        class FailingParser:
+            def __init__(self):
+                self.parser = new_parser()
+                self.parses = 0
+                self.resets = 0
+                self.timeout_micros = 0
+
+            def parse(self, source, old_tree=None):
+                self.parses += 1
+                if self.parses == 3:
+                    return None
+                return self.parser.parse(source, old_tree)
+
+            def reset(self):
+                self.resets += 1
+                self.parser.reset()
+
+        source = b"Some text.\n\n" * (tree_sitter_djot._PREFIX_STEP // 6)
+        parser = FailingParser()
+        tree, truncated = tree_sitter_djot.parse_with_timeout(
+            parser, source, 10_000_000
+        )
+        self.assertTrue(truncated)
+        self.assertEqual(
+            tree.root_node.end_byte, tree_sitter_djot._next_prefix_end(source, 0)
+        )
+        self.assertEqual(parser.resets, 1)
+        self.assertEqual(parser.timeout_micros, 0)
+
+    def test_prefixes_end_at_blank_lines(self):
+        paragraph = b"text\n" * (tree_sitter_djot._PREFIX_STEP // 5)
+        source = paragraph + b"more\n \r\nnext\n"
+        end = tree_sitter_djot._next_prefix_end(source, 0)
+        self.assertEqual(source[:end], paragraph + b"more\n \r\n")
+        self.assertEqual(tree_sitter_djot._next_prefix_end(source, end), len(source))
+
+
+def walk(tree):
+    """The nodes of `tree` in the order a cursor visits them."""
+    cursor = tree.walk()
+    while True:
+        yield cursor.node
+        if cursor.goto_first_child():
+            continue
+        while not cursor.goto_next_sibling():
+            if not cursor.goto_parent():
+                return
+
+
+@skipUnless(
+    "parse_many" in tree_sitter_djot.__all__, "built without the tree-sitter runtime"
+)
+class TestParseMany(TestCase):
+    DOCUMENTS = [
+        b"# Title\n\nSome *text*.\n\n## Section\n\n- one\n- two\n",
+        b"",
+        b"Just a paragraph with `code`.\n",
+        b"### Deep\n\n{broken\n\n# Again\n",
+    ]
+
+    def test_matches_parse(self):
+        results = tree_sitter_djot.parse_many(
+            self.DOCUMENTS, threads=3, sexp=True, export=True
+        )
+        self.assertEqual(len(results), len(self.DOCUMENTS))
+        parser = new_parser()
+        for source, result in zip(self.DOCUMENTS, results):
+            tree = parser.parse(source)
+            nodes = list(walk(tree))
+            self.assertEqual(result["node_count"], len(nodes))
+            self.assertEqual(result["has_error"], tree.root_node.has_error)
+            self.assertEqual(result["sexp"], str(tree.root_node))
+
+            headings = []
+            for node in nodes:
+                marker = node.child_by_field_name("marker")
+                if node.type == "heading" and marker is not None:
+                    level = len(marker.text) - len(marker.text.lstrip(b"#"))
+                    headings.append((level, node.start_byte, node.end_byte))
+            self.assertEqual(result["headings"], headings)
+
+            exported = tree_sitter_djot.ExportedTree(result["export"])
+            self.assertEqual(exported.node_count, len(nodes))
+            self.assertEqual(exported.source_length, tree.root_node.end_byte)
+            for i, node in enumerate(nodes):
+                self.assertEqual(exported.kind_id(i), node.kind_id)
+                self.assertEqual(exported.start_byte(i), node.start_byte)
+                self.assertEqual(exported.end_byte(i), node.end_byte)
+
+    def test_same_with_any_thread_count(self):
+        documents = self.DOCUMENTS * 5
+        single = tree_sitter_djot.parse_many(documents, threads=1, sexp=True)
+        for threads in (0, 2, 64):
+            self.assertEqual(
+                tree_sitter_djot.parse_many(documents, threads=threads, sexp=True),
+                single,
+            )
+
+    def test_only_asked_results(self):
+        (result,) = tree_sitter_djot.parse_many([b"# Title\n"])
+        self.assertNotIn("sexp", result)
+        self.assertNotIn("export", result)
+        self.assertEqual(tree_sitter_djot.parse_many([]), [])
+
+    def test_rejects_non_bytes(self):
+        with self.assertRaises(TypeError):
+            tree_sitter_djot.parse_many([b"# Title\n", "not bytes"])
+        with self.assertRaises(TypeError):
+            tree_sitter_djot.parse_many(None)
+
+
+class TestExportedTree(TestCase):
+    def test_reads_little_endian(self):
+        # A document node with one named paragraph child, at an odd offset.
+        nodes = [
+            (0x0102, 0, 1, 0, 300, 0xFFFFFFFF, 2),
+            (0x0203, 4, 1 | 8, 5, 0x01020304, 0, 2),
+        ]
+        data = b"x" + pack("<4I", 0x544F4A44, 1, len(nodes), 300)
+        for kind, field, flags, *words in nodes:
+            data += pack("<HBB4I", kind, field, flags, *words)
+
+        tree = tree_sitter_djot.ExportedTree(memoryview(data)[1:])
+        self.assertEqual(tree.node_count, 2)
+        self.assertEqual(tree.source_length, 300)
+        self.assertEqual(tree.kind_id(1), 0x0203)
+        self.assertEqual(tree.field_id(1), 4)
+        self.assertTrue(tree.is_named(1) and tree.is_error(1))
+        self.assertFalse(tree.is_missing(1) or tree.is_extra(1))
+        self.assertEqual(tree.start_byte(1), 5)
+        self.assertEqual(tree.end_byte(1), 0x01020304)
+        self.assertIsNone(tree.parent(0))
+        self.assertEqual(tree.parent(1), 0)
+        self.assertEqual(list(tree.children(0)), [1])
+
+    def test_rejects_truncated(self):
+        data = pack("<4I", 0x544F4A44, 1, 1, 0)
+        with self.assertRaises(ValueError):
+            tree_sitter_djot.ExportedTree(data)
@@ -1,5 +1,94 @@
 "Djot grammar for tree-sitter"
 
+import re
+from time import monotonic
+
 from ._binding import language
+from .exported_tree import ExportedTree
+
+__all__ = ["ExportedTree", "language", "parse_with_timeout"]
+
+try:
+    from ._binding import kind_names, parse_many
+
+    __all__ += ["kind_names", "parse_many"]
+except ImportError:
+    # Built without the tree-sitter runtime.
+    pass
+
+# How many bytes `parse_with_timeout` adds to the parsed prefix at a time.
+_PREFIX_STEP = 64 * 1024
+
+# A line break followed by a blank line.
+_BLANK_LINE = re.compile(rb"\n[ \t\r]*(?:\n|\Z)")
+
+
+def parse_with_timeout(parser, source, timeout_micros):
+    """Parse `source`, giving up after `timeout_micros` microseconds.
+
+    `parser` must be a `tree_sitter.Parser` set to the Djot language. Returns
+    a `(tree, truncated)` tuple, where `truncated` is true if the tree only
+    covers a prefix of `source` that ends at a blank line.
+    """
+    deadline = monotonic() + timeout_micros / 1e6
+    parser.timeout_micros = 0
+    tree = parser.parse(b"")
+    end = 0
+    end_point = (0, 0)
+    truncated = False
+
+    while end < len(source):
+        remaining = deadline - monotonic()
+        if remaining <= 0:
+            truncated = True
+            break
+
+        next_end = _next_prefix_end(source, end)
+        next_point = _advance_point(end_point, source, end, next_end)
+        old_tree = tree.copy()
+        old_tree.edit(
+            start_byte=end,
+            old_end_byte=end,
+            new_end_byte=next_end,
+            start_point=end_point,
+            old_end_point=end_point,
+            new_end_point=next_point,
+        )
+
+        parser.timeout_micros = max(1, int(remaining * 1e6))
+        try:
+            next_tree = parser.parse(_prefix_reader(source, next_end), old_tree)
+        except ValueError:
+            next_tree = None
+        if next_tree is None:
+            # Don't resume this parse the next time the parser is used.
+            parser.reset()
+            truncated = True
+            break
+        tree = next_tree
+        end = next_end
+        end_point = next_point
+
+    parser.timeout_micros = 0
+    return tree, truncated
+
+
+def _next_prefix_end(source, start):
+    match = _BLANK_LINE.search(source, min(start + _PREFIX_STEP, len(source)))
+    return len(source) if match is None else match.end()
+
+
+def _advance_point(point, source, start, end):
+    newlines = source.count(b"\n", start, end)
+    if newlines == 0:
+        return (point[0], point[1] + end - start)
+    return (point[0] + newlines, end - source.rfind(b"\n", start, end) - 1)
+
+
+def _prefix_reader(source, end):
+    # Slicing the whole prefix for every step would copy the document over and
+    # over, so hand it to the parser in pieces.
+    def read(byte, _point):
+        return source[byte:min(end, byte + _PREFIX_STEP)]
 
-__all__ = ["language"]
+    return read
@@ -1 +1,45 @@
+from typing import Any, Iterator, Optional, Sequence, TypedDict
+
 def language() -> int: ...
+
+def parse_with_timeout(
+    parser: Any, source: bytes, timeout_micros: int
+) -> tuple[Any, bool]: ...
+
+# Not in builds without the tree-sitter runtime, which drop everything up to
+# the end marker below.
+class _ParseResult(TypedDict, total=False):
+    node_count: int
+    has_error: bool
+    headings: list[tuple[int, int, int]]
+    sexp: str
+    export: bytes
+
+def parse_many(
+    documents: Sequence[bytes],
+    threads: int = 0,
+    sexp: bool = False,
+    export: bool = False,
+) -> list[_ParseResult]: ...
+
+def kind_names() -> list[str]: ...
+
+# End of the functions that need the runtime.
+
+class ExportedTree:
+    node_count: int
+    source_length: int
+    kind_names: Optional[Sequence[str]]
+    def __init__(self, buffer: Any, kind_names: Optional[Sequence[str]] = None) -> None: ...
+    def kind_id(self, node: int) -> int: ...
+    def kind(self, node: int) -> str: ...
+    def field_id(self, node: int) -> int: ...
+    def is_named(self, node: int) -> bool: ...
+    def is_missing(self, node: int) -> bool: ...
+    def is_extra(self, node: int) -> bool: ...
+    def is_error(self, node: int) -> bool: ...
+    def start_byte(self, node: int) -> int: ...
+    def end_byte(self, node: int) -> int: ...
+    def parent(self, node: int) -> Optional[int]: ...
+    def subtree_end(self, node: int) -> int: ...
+    def children(self, node: int) -> Iterator[int]: ...
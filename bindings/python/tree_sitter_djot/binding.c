@@ -8,9 +8,274 @@ static PyObject* _binding_language(PyObject *self, PyObject *args) {
     return PyLong_FromVoidPtr(tree_sitter_djot());
 }
 
+#ifdef TREE_SITTER_DJOT_PARSE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <tree_sitter/api.h>
+#include <unistd.h>
+
+#include "tree-sitter-djot-utils.h"
+#include "tree_sitter/array.h"
+
+typedef struct {
+    uint32_t level;
+    uint32_t start_byte;
+    uint32_t end_byte;
+} Heading;
+
+// The results of parsing one document, computed without the GIL and turned
+// into Python objects afterwards.
+typedef struct {
+    const char *source;
+    uint32_t length;
+    uint32_t node_count;
+    bool has_error;
+    Array(Heading) headings;
+    char *sexp;
+    uint8_t *exported;
+    size_t exported_length;
+} Document;
+
+typedef struct {
+    Document *documents;
+    uint32_t count;
+    bool sexp;
+    bool export;
+    // The next document that no thread has taken yet.
+    atomic_uint next;
+} Job;
+
+static void summarize(Document *document, TSTree *tree) {
+    const TSLanguage *language = ts_tree_language(tree);
+    TSSymbol heading = ts_language_symbol_for_name(language, "heading", 7, true);
+    TSFieldId marker = ts_language_field_id_for_name(language, "marker", 6);
+
+    TSNode root = ts_tree_root_node(tree);
+    document->has_error = ts_node_has_error(root);
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        ++document->node_count;
+        TSNode heading_marker = ts_node_symbol(node) == heading
+                                    ? ts_node_child_by_field_id(node, marker)
+                                    : (TSNode){0};
+        // Error recovery can leave a heading without its marker.
+        if (!ts_node_is_null(heading_marker)) {
+            uint32_t start = ts_node_start_byte(heading_marker);
+            uint32_t level = 0;
+            while (start + level < document->length && document->source[start + level] == '#') {
+                ++level;
+            }
+            Heading h = {level, ts_node_start_byte(node), ts_node_end_byte(node)};
+            array_push(&document->headings, h);
+        }
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+// Every thread has its own parser and takes documents until there are none
+// left.
+static void *parse_documents(void *payload) {
+    Job *job = payload;
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_djot());
+    for (;;) {
+        uint32_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            break;
+        }
+        Document *document = &job->documents[i];
+        TSTree *tree = ts_parser_parse_string(parser, NULL, document->source, document->length);
+        summarize(document, tree);
+        if (job->sexp) {
+            document->sexp = ts_node_string(ts_tree_root_node(tree));
+        }
+        if (job->export) {
+            document->exported = tree_sitter_djot_export(tree, &document->exported_length);
+        }
+        ts_tree_delete(tree);
+    }
+    ts_parser_delete(parser);
+    return NULL;
+}
+
+static void parse_job(Job *job, uint32_t thread_count) {
+    if (thread_count > job->count) {
+        thread_count = job->count;
+    }
+    // The calling thread parses documents too.
+    uint32_t started = 0;
+    pthread_t *threads = NULL;
+    if (thread_count > 1) {
+        // Without room for the threads, the calling thread parses everything.
+        threads = malloc((thread_count - 1) * sizeof(pthread_t));
+        while (threads && started < thread_count - 1 &&
+               pthread_create(&threads[started], NULL, parse_documents, job) == 0) {
+            ++started;
+        }
+    }
+    parse_documents(job);
+    for (uint32_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+static PyObject *document_result(const Job *job, const Document *document) {
+    if (job->export && !document->exported) {
+        return PyErr_NoMemory();
+    }
+    PyObject *headings = PyList_New(document->headings.size);
+    if (!headings) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < document->headings.size; ++i) {
+        const Heading *h = array_get(&document->headings, i);
+        PyObject *item = Py_BuildValue("(III)", h->level, h->start_byte, h->end_byte);
+        if (!item) {
+            Py_DECREF(headings);
+            return NULL;
+        }
+        PyList_SetItem(headings, i, item);
+    }
+
+    PyObject *result = Py_BuildValue("{s:I,s:O,s:N}",
+                                     "node_count", document->node_count,
+                                     "has_error", document->has_error ? Py_True : Py_False,
+                                     "headings", headings);
+    if (result && document->sexp) {
+        PyObject *sexp = PyUnicode_FromString(document->sexp);
+        if (!sexp || PyDict_SetItemString(result, "sexp", sexp) < 0) {
+            Py_XDECREF(sexp);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(sexp);
+    }
+    if (result && document->exported) {
+        PyObject *exported = PyBytes_FromStringAndSize((const char *)document->exported,
+                                                       (Py_ssize_t)document->exported_length);
+        if (!exported || PyDict_SetItemString(result, "export", exported) < 0) {
+            Py_XDECREF(exported);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(exported);
+    }
+    return result;
+}
+
+static PyObject *_binding_parse_many(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"documents", "threads", "sexp", "export", NULL};
+    PyObject *sequence;
+    unsigned int thread_count = 0;
+    int sexp = 0;
+    int export = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Ipp", keywords, &sequence, &thread_count,
+                                     &sexp, &export)) {
+        return NULL;
+    }
+    if (thread_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+
+    // A tuple keeps the documents alive, and unchanged, while the GIL is
+    // released.
+    PyObject *documents = PySequence_Tuple(sequence);
+    if (!documents) {
+        return NULL;
+    }
+    Py_ssize_t count = PyTuple_Size(documents);
+    Job job = {
+        .documents = calloc(count > 0 ? count : 1, sizeof(Document)),
+        .count = (uint32_t)count,
+        .sexp = sexp,
+        .export = export,
+    };
+    atomic_init(&job.next, 0);
+
+    PyObject *results = NULL;
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        char *source;
+        Py_ssize_t length;
+        if (PyBytes_AsStringAndSize(PyTuple_GetItem(documents, i), &source, &length) < 0) {
+            goto done;
+        }
+        if ((size_t)length > UINT32_MAX) {
+            PyErr_SetString(PyExc_ValueError, "Documents can't be larger than 4 GiB");
+            goto done;
+        }
+        job.documents[i].source = source;
+        job.documents[i].length = (uint32_t)length;
+        array_init(&job.documents[i].headings);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    parse_job(&job, thread_count);
+    Py_END_ALLOW_THREADS
+
+    results = PyList_New(count);
+    for (Py_ssize_t i = 0; results && i < count; ++i) {
+        PyObject *result = document_result(&job, &job.documents[i]);
+        if (!result) {
+            Py_CLEAR(results);
+            break;
+        }
+        PyList_SetItem(results, i, result);
+    }
+
+done:
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        array_delete(&job.documents[i].headings);
+        free(job.documents[i].sexp);
+        free(job.documents[i].exported);
+    }
+    free(job.documents);
+    Py_DECREF(documents);
+    return results;
+}
+
+static PyObject *_binding_kind_names(PyObject *self, PyObject *args) {
+    const TSLanguage *language = tree_sitter_djot();
+    uint32_t count = ts_language_symbol_count(language);
+    PyObject *names = PyList_New(count);
+    for (uint32_t i = 0; names && i < count; ++i) {
+        PyObject *name = PyUnicode_FromString(ts_language_symbol_name(language, i));
+        if (!name) {
+            Py_CLEAR(names);
+            break;
+        }
+        PyList_SetItem(names, i, name);
+    }
+    return names;
+}
+
+#endif
+
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+#ifdef TREE_SITTER_DJOT_PARSE
+    {"parse_many", (PyCFunction)(void (*)(void))_binding_parse_many, METH_VARARGS | METH_KEYWORDS,
+     "Parse a list of documents given as bytes on native threads, without holding the GIL.\n\n"
+     "`threads` defaults to the number of CPUs. Returns a dict for every document, with\n"
+     "its `node_count`, whether it `has_error`, its `headings` as (level, start_byte,\n"
+     "end_byte) tuples, its tree as an S-expression under `sexp` if `sexp` is true, and\n"
+     "in the format of `tree_sitter_djot_export` under `export` if `export` is true."},
+    {"kind_names", _binding_kind_names, METH_NOARGS,
+     "Get the names of the node kinds in exported trees, by kind id."},
+#endif
     {NULL, NULL, 0, NULL}
 };
 
@@ -0,0 +1,98 @@
+"""A reader for trees written by `tree_sitter_djot_export`.
+
+See `bindings/c/tree-sitter-djot-utils.h` for the format. Nodes are read
+straight from the buffer, which can be an `mmap`, without creating an object
+for every node.
+"""
+
+from struct import Struct
+
+_MAGIC = 0x544F4A44
+_VERSION = 1
+_HEADER_SIZE = 16
+_NODE_SIZE = 20
+_NO_PARENT = 0xFFFFFFFF
+
+# The export is little-endian whatever the machine.
+_HEADER = Struct("<4I")
+_U16 = Struct("<H")
+_U32 = Struct("<I")
+
+
+class ExportedTree:
+    """An exported tree, with nodes referred to by their index.
+
+    `kind_names` are the names of the node kinds by id, as returned by
+    `kind_names()`.
+    """
+
+    def __init__(self, buffer, kind_names=None):
+        self._buffer = memoryview(buffer).cast("B")
+        if len(self._buffer) < _HEADER_SIZE:
+            raise ValueError("Not an exported Djot tree")
+        magic, version, self.node_count, self.source_length = _HEADER.unpack_from(
+            self._buffer
+        )
+        if magic != _MAGIC:
+            raise ValueError("Not an exported Djot tree")
+        if version != _VERSION:
+            raise ValueError(f"Unsupported export version {version}")
+        if len(self._buffer) < _HEADER_SIZE + self.node_count * _NODE_SIZE:
+            raise ValueError("Truncated exported Djot tree")
+        self.kind_names = kind_names
+
+    def _u32(self, node, offset):
+        return _U32.unpack_from(self._buffer, _HEADER_SIZE + node * _NODE_SIZE + offset)[0]
+
+    def _flags(self, node):
+        return self._buffer[_HEADER_SIZE + node * _NODE_SIZE + 3]
+
+    def kind_id(self, node):
+        return _U16.unpack_from(self._buffer, _HEADER_SIZE + node * _NODE_SIZE)[0]
+
+    def kind(self, node):
+        """The name of the node kind, if the names were given."""
+        kind = self.kind_id(node)
+        return "ERROR" if kind == 0xFFFF else self.kind_names[kind]
+
+    def field_id(self, node):
+        return self._buffer[_HEADER_SIZE + node * _NODE_SIZE + 2]
+
+    def is_named(self, node):
+        return bool(self._flags(node) & 1)
+
+    def is_missing(self, node):
+        return bool(self._flags(node) & 2)
+
+    def is_extra(self, node):
+        return bool(self._flags(node) & 4)
+
+    def is_error(self, node):
+        return bool(self._flags(node) & 8)
+
+    def start_byte(self, node):
+        return self._u32(node, 4)
+
+    def end_byte(self, node):
+        return self._u32(node, 8)
+
+    def parent(self, node):
+        """The index of the parent, or None for the root."""
+        parent = self._u32(node, 12)
+        return None if parent == _NO_PARENT else parent
+
+    def subtree_end(self, node):
+        """The index after the last descendant of the node."""
+        return self._u32(node, 16)
+
+    def children(self, node):
+        """The indices of the children of the node."""
+        end = self.subtree_end(node)
+        child = node + 1
+        while child < end:
+            yield child
+            next_child = self.subtree_end(child)
+            # Don't loop or leave the parent on a broken export.
+            if not child < next_child <= end:
+                raise ValueError(f"Invalid node {child} in exported Djot tree")
+            child = next_child
@@ -9,6 +9,9 @@ fn main() {
         .flag_if_supported("-Wno-trigraphs");
     #[cfg(target_env = "msvc")]
     c_config.flag("-utf-8");
+    if std::env::var_os("CARGO_FEATURE_ERROR_RESYNC").is_some() {
+        c_config.define("TREE_SITTER_DJOT_ERROR_RESYNC", None);
+    }
 
     let parser_path = src_dir.join("parser.c");
     c_config.file(&parser_path);
@@ -20,6 +23,23 @@ fn main() {
     c_config.compile("parser");
     println!("cargo:rerun-if-changed={}", parser_path.to_str().unwrap());
 
+    // `export` wraps the C writer, which needs the headers of the tree-sitter
+    // runtime that the tree-sitter crate builds.
+    if std::env::var_os("CARGO_FEATURE_EXPORT").is_some() {
+        let runtime_include = std::env::var("DEP_TREE_SITTER_INCLUDE").expect(
+            "The `export` feature needs a tree-sitter crate that exports its include directory",
+        );
+        let export_path = std::path::Path::new("lib").join("export.c");
+        cc::Build::new()
+            .include(&src_dir)
+            .include("bindings/c")
+            .include(runtime_include)
+            .flag_if_supported("-std=c11")
+            .file(&export_path)
+            .compile("djot-export");
+        println!("cargo:rerun-if-changed={}", export_path.to_str().unwrap());
+    }
+
     // If your language uses an external scanner written in C++,
     // then include this block of code:
 
@@ -0,0 +1,264 @@
+//! A flat binary format for Djot trees, written by `tree_sitter_djot_export` in the C helpers.
+//! See `bindings/c/tree-sitter-djot-utils.h` for the layout.
+//!
+//! An exported tree can be saved, memory-mapped and read in place, by other processes too,
+//! without going through the tree-sitter API for every node.
+
+use std::convert::TryInto;
+use std::ffi::c_void;
+use std::slice;
+
+use tree_sitter::{ffi, Tree};
+
+const MAGIC: u32 = 0x544F_4A44;
+const VERSION: u32 = 1;
+const HEADER_SIZE: usize = 16;
+const NODE_SIZE: usize = 20;
+const NO_PARENT: u32 = u32::MAX;
+
+const NAMED: u32 = 1;
+const MISSING: u32 = 2;
+const EXTRA: u32 = 4;
+const ERROR: u32 = 8;
+
+extern "C" {
+    fn tree_sitter_djot_export(tree: *const ffi::TSTree, length: *mut usize) -> *mut u8;
+    fn free(ptr: *mut c_void);
+}
+
+/// Write every node of `tree` in pre-order, with `tree_sitter_djot_export` of the C helpers.
+pub fn export(tree: &Tree) -> Vec<u8> {
+    // Only an owned tree gives out its pointer, and copies share their nodes.
+    let raw = tree.clone().into_raw();
+    let mut length = 0;
+    unsafe {
+        let data = tree_sitter_djot_export(raw, &mut length);
+        drop(Tree::from_raw(raw));
+        assert!(!data.is_null(), "out of memory exporting the tree");
+        let result = slice::from_raw_parts(data, length).to_vec();
+        free(data as *mut c_void);
+        result
+    }
+}
+
+/// An error reading an exported tree.
+#[derive(Debug, PartialEq, Eq)]
+pub enum ExportError {
+    NotAnExport,
+    UnsupportedVersion(u32),
+    Truncated,
+    /// The parent of the node doesn't come before it, or its subtree ends before it or past the
+    /// last node.
+    InvalidNode(usize),
+}
+
+/// An exported tree read in place. Nodes are referred to by their index, with the root at 0.
+#[derive(Clone, Copy)]
+pub struct ExportedTree<'a> {
+    data: &'a [u8],
+    node_count: usize,
+}
+
+impl<'a> ExportedTree<'a> {
+    /// Check the header and the links between the nodes, which takes a pass over the nodes, so
+    /// that walking the tree can't go out of bounds or loop.
+    pub fn new(data: &'a [u8]) -> Result<Self, ExportError> {
+        if data.len() < HEADER_SIZE || read_u32(data, 0) != MAGIC {
+            return Err(ExportError::NotAnExport);
+        }
+        let version = read_u32(data, 4);
+        if version != VERSION {
+            return Err(ExportError::UnsupportedVersion(version));
+        }
+        let node_count = read_u32(data, 8) as usize;
+        match node_count.checked_mul(NODE_SIZE) {
+            Some(size) if node_count > 0 && data.len() - HEADER_SIZE >= size => {}
+            _ => return Err(ExportError::Truncated),
+        }
+        let tree = Self { data, node_count };
+        for node in 0..node_count {
+            let subtree_end = tree.subtree_end(node);
+            let parent_valid = match tree.parent(node) {
+                None => node == 0,
+                Some(parent) => parent < node,
+            };
+            if subtree_end <= node || subtree_end > node_count || !parent_valid {
+                return Err(ExportError::InvalidNode(node));
+            }
+        }
+        Ok(tree)
+    }
+
+    pub fn node_count(&self) -> usize {
+        self.node_count
+    }
+
+    pub fn source_length(&self) -> usize {
+        read_u32(self.data, 12) as usize
+    }
+
+    fn word(&self, node: usize, word: usize) -> u32 {
+        assert!(node < self.node_count);
+        read_u32(self.data, HEADER_SIZE + node * NODE_SIZE + word * 4)
+    }
+
+    /// The symbol of the node, as in [tree_sitter::Node::kind_id].
+    pub fn kind_id(&self, node: usize) -> u16 {
+        self.word(node, 0) as u16
+    }
+
+    pub fn kind(&self, node: usize) -> &'static str {
+        match self.kind_id(node) {
+            u16::MAX => "ERROR",
+            id => super::language().node_kind_for_id(id).unwrap_or(""),
+        }
+    }
+
+    /// The field of the node in its parent, or 0.
+    pub fn field_id(&self, node: usize) -> u16 {
+        (self.word(node, 0) >> 16) as u16 & 0xFF
+    }
+
+    pub fn is_named(&self, node: usize) -> bool {
+        (self.word(node, 0) >> 24) & NAMED != 0
+    }
+
+    pub fn is_missing(&self, node: usize) -> bool {
+        (self.word(node, 0) >> 24) & MISSING != 0
+    }
+
+    pub fn is_extra(&self, node: usize) -> bool {
+        (self.word(node, 0) >> 24) & EXTRA != 0
+    }
+
+    pub fn is_error(&self, node: usize) -> bool {
+        (self.word(node, 0) >> 24) & ERROR != 0
+    }
+
+    pub fn start_byte(&self, node: usize) -> usize {
+        self.word(node, 1) as usize
+    }
+
+    pub fn end_byte(&self, node: usize) -> usize {
+        self.word(node, 2) as usize
+    }
+
+    pub fn parent(&self, node: usize) -> Option<usize> {
+        match self.word(node, 3) {
+            NO_PARENT => None,
+            parent => Some(parent as usize),
+        }
+    }
+
+    /// The index after the last descendant of the node.
+    pub fn subtree_end(&self, node: usize) -> usize {
+        self.word(node, 4) as usize
+    }
+
+    pub fn children(&self, node: usize) -> Children<'a> {
+        Children {
+            tree: *self,
+            next: node + 1,
+            end: self.subtree_end(node),
+        }
+    }
+}
+
+/// The children of a node in an [ExportedTree].
+pub struct Children<'a> {
+    tree: ExportedTree<'a>,
+    next: usize,
+    end: usize,
+}
+
+impl Iterator for Children<'_> {
+    type Item = usize;
+
+    fn next(&mut self) -> Option<usize> {
+        if self.next >= self.end {
+            return None;
+        }
+        let child = self.next;
+        self.next = self.tree.subtree_end(child);
+        Some(child)
+    }
+}
+
+fn read_u32(data: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes(data[offset..offset + 4].try_into().unwrap())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_export_matches_cursor() {
+        let mut parser = tree_sitter::Parser::new();
+        parser
+            .set_language(crate::language())
+            .expect("Error loading Djot language");
+        let source = "# Heading\n\nSome _text_ with [a link](url).\n\n- a\n- b\n";
+        let tree = parser.parse(source, None).unwrap();
+        let data = export(&tree);
+        let exported = ExportedTree::new(&data).unwrap();
+        assert_eq!(exported.source_length(), source.len());
+
+        // Walk both trees in the same order.
+        fn compare(exported: &ExportedTree, index: usize, node: tree_sitter::Node) {
+            assert_eq!(exported.kind(index), node.kind());
+            assert_eq!(exported.is_named(index), node.is_named());
+            assert_eq!(exported.start_byte(index), node.start_byte());
+            assert_eq!(exported.end_byte(index), node.end_byte());
+            let mut cursor = node.walk();
+            let children: Vec<_> = node.children(&mut cursor).collect();
+            let exported_children: Vec<_> = exported.children(index).collect();
+            assert_eq!(children.len(), exported_children.len());
+            for (child, exported_child) in children.into_iter().zip(exported_children) {
+                assert_eq!(exported.parent(exported_child), Some(index));
+                compare(exported, exported_child, child);
+            }
+        }
+        compare(&exported, 0, tree.root_node());
+        assert_eq!(exported.subtree_end(0), exported.node_count());
+    }
+
+    #[test]
+    fn test_rejects_other_data() {
+        assert!(ExportedTree::new(b"not a tree at all").is_err());
+    }
+
+    fn tree_data(nodes: &[[u32; 5]]) -> Vec<u8> {
+        let mut data = Vec::new();
+        for word in [MAGIC, VERSION, nodes.len() as u32, 0].iter().chain(nodes.iter().flatten()) {
+            data.extend_from_slice(&word.to_le_bytes());
+        }
+        data
+    }
+
+    #[test]
+    fn test_rejects_invalid_links() {
+        let root = [0, 0, 0, NO_PARENT, 2];
+        assert!(ExportedTree::new(&tree_data(&[root, [0, 0, 0, 0, 2]])).is_ok());
+        // A child that would be its own next sibling.
+        assert_eq!(
+            ExportedTree::new(&tree_data(&[root, [0, 0, 0, 0, 1]])).err(),
+            Some(ExportError::InvalidNode(1))
+        );
+        // A subtree past the last node.
+        assert_eq!(
+            ExportedTree::new(&tree_data(&[root, [0, 0, 0, 0, 3]])).err(),
+            Some(ExportError::InvalidNode(1))
+        );
+        // A parent after the node.
+        assert_eq!(
+            ExportedTree::new(&tree_data(&[root, [0, 0, 0, 1, 2]])).err(),
+            Some(ExportError::InvalidNode(1))
+        );
+        // A second root.
+        assert_eq!(
+            ExportedTree::new(&tree_data(&[root, [0, 0, 0, NO_PARENT, 2]])).err(),
+            Some(ExportError::InvalidNode(1))
+        );
+    }
+}
@@ -15,7 +15,15 @@
 //! [Parser]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Parser.html
 //! [tree-sitter]: https://tree-sitter.github.io/
 
-use tree_sitter::Language;
+use std::sync::atomic::AtomicUsize;
+use std::time::{Duration, Instant};
+
+use tree_sitter::{InputEdit, Language, Parser, Point, Tree};
+
+#[cfg(feature = "export")]
+pub mod export;
+#[cfg(feature = "parallel")]
+pub mod parallel;
 
 extern "C" {
     fn tree_sitter_djot() -> Language;
@@ -36,12 +44,129 @@ pub const NODE_TYPES: &'static str = include_str!("../../src/node-types.json");
 // Uncomment these to include any queries that this grammar contains
 
 pub const HIGHLIGHTS_QUERY: &'static str = include_str!("../../queries/highlights.scm");
+/// A reduced [HIGHLIGHTS_QUERY] for large documents, with only headings, emphasis, code and
+/// links.
+pub const FAST_HIGHLIGHTS_QUERY: &'static str = include_str!("../../queries/highlights-fast.scm");
 pub const INJECTIONS_QUERY: &'static str = include_str!("../../queries/injections.scm");
 // pub const LOCALS_QUERY: &'static str = include_str!("../../queries/locals.scm");
 // pub const TAGS_QUERY: &'static str = include_str!("../../queries/tags.scm");
 
+/// How many bytes [parse_with_timeout] adds to the parsed prefix at a time.
+const PREFIX_STEP: usize = 64 * 1024;
+
+/// The result of [parse_with_timeout].
+pub struct TimedParse {
+    /// The tree of the longest prefix of the text that was parsed in time.
+    pub tree: Tree,
+    /// If the tree only covers a prefix of the text.
+    pub truncated: bool,
+}
+
+/// Parse `text`, giving up after `timeout` or once `cancellation_flag` is set to a non-zero
+/// value.
+///
+/// When it gives up, [TimedParse::tree] is the tree of the longest prefix of `text` that ends at a
+/// blank line and was parsed in time.
+///
+/// `parser` must be set to the Djot language. Its timeout and cancellation flag are cleared
+/// afterwards.
+// 0.25 deprecates the timeout and cancellation flag in favor of progress callbacks, which the
+// versions before it don't have.
+#[allow(deprecated)]
+pub fn parse_with_timeout(
+    parser: &mut Parser,
+    text: &[u8],
+    timeout: Duration,
+    cancellation_flag: Option<&AtomicUsize>,
+) -> TimedParse {
+    let deadline = Instant::now() + timeout;
+    parser.set_timeout_micros(0);
+    let mut tree = parser
+        .parse(b"", None)
+        .expect("The parser has no language set");
+    let mut end = 0;
+    let mut end_point = Point::new(0, 0);
+    let mut truncated = false;
+
+    unsafe { parser.set_cancellation_flag(cancellation_flag) };
+    while end < text.len() {
+        let remaining = deadline.saturating_duration_since(Instant::now());
+        if remaining.is_zero() {
+            truncated = true;
+            break;
+        }
+
+        let next = next_prefix_end(text, end);
+        let next_point = advance_point(end_point, &text[end..next]);
+        let mut old_tree = tree.clone();
+        old_tree.edit(&InputEdit {
+            start_byte: end,
+            old_end_byte: end,
+            new_end_byte: next,
+            start_position: end_point,
+            old_end_position: end_point,
+            new_end_position: next_point,
+        });
+
+        parser.set_timeout_micros(remaining.as_micros().max(1) as u64);
+        match parser.parse(&text[..next], Some(&old_tree)) {
+            Some(next_tree) => {
+                tree = next_tree;
+                end = next;
+                end_point = next_point;
+            }
+            None => {
+                // Don't resume this parse the next time the parser is used.
+                parser.reset();
+                truncated = true;
+                break;
+            }
+        }
+    }
+    unsafe { parser.set_cancellation_flag(None) };
+    parser.set_timeout_micros(0);
+
+    TimedParse { tree, truncated }
+}
+
+/// The end of the first blank line at least [PREFIX_STEP] bytes after `start`, or the end of
+/// `text`.
+fn next_prefix_end(text: &[u8], start: usize) -> usize {
+    let mut end = (start + PREFIX_STEP).min(text.len());
+    while let Some(i) = text[end..].iter().position(|&b| b == b'\n') {
+        let line_start = end + i + 1;
+        let line_end = match text[line_start..].iter().position(|&b| b == b'\n') {
+            Some(j) => line_start + j + 1,
+            None => text.len(),
+        };
+        if text[line_start..line_end]
+            .iter()
+            .all(|&b| matches!(b, b' ' | b'\t' | b'\r' | b'\n'))
+        {
+            return line_end;
+        }
+        end = line_start;
+    }
+    text.len()
+}
+
+fn advance_point(mut point: Point, text: &[u8]) -> Point {
+    for &b in text {
+        if b == b'\n' {
+            point.row += 1;
+            point.column = 0;
+        } else {
+            point.column += 1;
+        }
+    }
+    point
+}
+
 #[cfg(test)]
 mod tests {
+    use std::sync::atomic::AtomicUsize;
+    use std::time::Duration;
+
     #[test]
     fn test_can_load_grammar() {
         let mut parser = tree_sitter::Parser::new();
@@ -49,4 +174,66 @@ mod tests {
             .set_language(super::language())
             .expect("Error loading Djot language");
     }
+
+    #[test]
+    fn test_can_load_highlights_queries() {
+        tree_sitter::Query::new(super::language(), super::HIGHLIGHTS_QUERY)
+            .expect("Error loading highlights query");
+        tree_sitter::Query::new(super::language(), super::FAST_HIGHLIGHTS_QUERY)
+            .expect("Error loading fast highlights query");
+    }
+
+    fn new_parser() -> tree_sitter::Parser {
+        let mut parser = tree_sitter::Parser::new();
+        parser
+            .set_language(super::language())
+            .expect("Error loading Djot language");
+        parser
+    }
+
+    #[test]
+    fn test_parse_with_timeout_completes() {
+        let mut parser = new_parser();
+        let text = b"# Heading\n\nSome *text* with [a link](url).\n";
+        let result = super::parse_with_timeout(&mut parser, text, Duration::from_secs(10), None);
+        assert!(!result.truncated);
+        assert_eq!(result.tree.root_node().end_byte(), text.len());
+    }
+
+    #[test]
+    fn test_next_prefix_end() {
+        let paragraph = "text\n".repeat(super::PREFIX_STEP / 5);
+        let text = format!("{paragraph}more\n \r\nnext\n");
+        let end = super::next_prefix_end(text.as_bytes(), 0);
+        assert_eq!(&text[..end], format!("{paragraph}more\n \r\n"));
+        assert_eq!(super::next_prefix_end(text.as_bytes(), end), text.len());
+    }
+
+    #[test]
+    fn test_parse_with_timeout_truncates() {
+        let mut parser = new_parser();
+        let result = super::parse_with_timeout(&mut parser, b"Some text.\n", Duration::ZERO, None);
+        assert!(result.truncated);
+        assert_eq!(result.tree.root_node().end_byte(), 0);
+    }
+
+    #[test]
+    fn test_parse_with_timeout_cancelled() {
+        let mut parser = new_parser();
+        // Several prefixes, the first of which is cancelled while it's parsed.
+        let text = "Some text.\n\n".repeat(20_000);
+        let flag = AtomicUsize::new(1);
+        let result = super::parse_with_timeout(
+            &mut parser,
+            text.as_bytes(),
+            Duration::from_secs(10),
+            Some(&flag),
+        );
+        assert!(result.truncated);
+        assert_eq!(result.tree.root_node().end_byte(), 0);
+
+        // The parser is usable again afterwards.
+        let tree = parser.parse("Done\n", None).unwrap();
+        assert_eq!(tree.root_node().end_byte(), 5);
+    }
 }
@@ -0,0 +1,200 @@
+//! Parsing many files at once, enabled by the `parallel` feature.
+//!
+//! ```no_run
+//! use tree_sitter_djot::parallel::{parse_paths_parallel, ParserPool};
+//!
+//! let pool = ParserPool::new();
+//! let paths = ["a.dj", "b.dj"];
+//! for result in parse_paths_parallel(&pool, &paths, |file| file.tree.root_node().child_count()) {
+//!     println!("{} top-level blocks", result.unwrap());
+//! }
+//! ```
+
+use std::fs::File;
+use std::io;
+use std::ops::{Deref, DerefMut};
+use std::path::Path;
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+use memmap2::Mmap;
+use rayon::prelude::*;
+use tree_sitter::{Parser, Tree};
+
+/// A thread-safe pool of Djot parsers.
+///
+/// Creating a parser allocates its stacks and the external scanner, so reusing parsers saves
+/// that work on every parse. The pool never holds more parsers than were in use at once.
+#[derive(Default)]
+pub struct ParserPool {
+    parsers: Mutex<Vec<Parser>>,
+}
+
+impl ParserPool {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Take a parser from the pool, creating one if none is free. It goes back to the pool when
+    /// the returned guard is dropped.
+    pub fn get(&self) -> PooledParser<'_> {
+        let parser = self.parsers.lock().unwrap().pop().unwrap_or_else(|| {
+            let mut parser = Parser::new();
+            parser
+                .set_language(super::language())
+                .expect("Error loading Djot language");
+            parser
+        });
+        PooledParser {
+            pool: self,
+            parser: Some(parser),
+        }
+    }
+}
+
+/// A parser taken from a [ParserPool].
+pub struct PooledParser<'a> {
+    pool: &'a ParserPool,
+    parser: Option<Parser>,
+}
+
+impl Deref for PooledParser<'_> {
+    type Target = Parser;
+
+    fn deref(&self) -> &Parser {
+        self.parser.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledParser<'_> {
+    fn deref_mut(&mut self) -> &mut Parser {
+        self.parser.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledParser<'_> {
+    // The timeout and cancellation flag are deprecated from 0.25 on, but callers of earlier
+    // versions can still set them.
+    #[allow(deprecated)]
+    fn drop(&mut self) {
+        let mut parser = self.parser.take().unwrap();
+        // Drop the state of a parse that timed out or was cancelled, and what the last user set
+        // to stop the next parse early. The flag may not outlive the guard.
+        parser.reset();
+        parser.set_timeout_micros(0);
+        unsafe { parser.set_cancellation_flag(None) };
+        self.pool.parsers.lock().unwrap().push(parser);
+    }
+}
+
+/// How long it took to handle a file in [parse_paths_parallel].
+#[derive(Clone, Copy, Debug, Default)]
+pub struct FileTiming {
+    /// Opening and mapping the file.
+    pub read: Duration,
+    pub parse: Duration,
+}
+
+/// A file parsed by [parse_paths_parallel].
+pub struct ParsedFile<'a> {
+    pub path: &'a Path,
+    /// The contents of the file, mapped into memory.
+    pub source: &'a [u8],
+    pub tree: Tree,
+    pub timing: FileTiming,
+}
+
+/// Parse the files at `paths` on the rayon thread pool and pass each one to `f`.
+///
+/// Files are memory-mapped rather than read, and the source is only mapped while `f` runs, so
+/// copy what you need out of it. Rayon's work stealing keeps all threads busy however the file
+/// sizes are spread, and parsers are taken from `pool`.
+///
+/// Returns the results of `f` in the order of `paths`, or the error from opening or mapping the
+/// file, or an error of kind [io::ErrorKind::Other] if the parse didn't finish.
+pub fn parse_paths_parallel<P, F, T>(pool: &ParserPool, paths: &[P], f: F) -> Vec<io::Result<T>>
+where
+    P: AsRef<Path> + Sync,
+    F: Fn(ParsedFile<'_>) -> T + Sync,
+    T: Send,
+{
+    paths
+        .par_iter()
+        .map(|path| -> io::Result<T> {
+            let path = path.as_ref();
+            let start = Instant::now();
+            let file = File::open(path)?;
+            // Mapping an empty file fails on some platforms.
+            let mmap = if file.metadata()?.len() > 0 {
+                Some(unsafe { Mmap::map(&file)? })
+            } else {
+                None
+            };
+            let source: &[u8] = mmap.as_deref().unwrap_or(&[]);
+            let read = start.elapsed();
+
+            let start = Instant::now();
+            let tree = pool.get().parse(source, None).ok_or_else(|| {
+                io::Error::new(io::ErrorKind::Other, "The parse was cancelled")
+            })?;
+            let parse = start.elapsed();
+
+            Ok(f(ParsedFile {
+                path,
+                source,
+                tree,
+                timing: FileTiming { read, parse },
+            }))
+        })
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+    use std::sync::atomic::AtomicUsize;
+
+    #[test]
+    #[allow(deprecated)]
+    fn test_pool_clears_timeout_and_cancellation() {
+        let pool = ParserPool::new();
+        let cancelled = AtomicUsize::new(1);
+        {
+            let mut parser = pool.get();
+            parser.set_timeout_micros(1);
+            unsafe { parser.set_cancellation_flag(Some(&cancelled)) };
+        }
+
+        let mut parser = pool.get();
+        assert_eq!(parser.timeout_micros(), 0);
+        assert!(unsafe { parser.cancellation_flag() }.is_none());
+        let tree = parser.parse("# Heading\n", None).unwrap();
+        assert_eq!(tree.root_node().end_byte(), 10);
+    }
+
+    #[test]
+    fn test_parse_paths_parallel() {
+        let dir = std::env::temp_dir().join(format!("tree-sitter-djot-{}", std::process::id()));
+        fs::create_dir_all(&dir).unwrap();
+        let mut paths = Vec::new();
+        for i in 0..20 {
+            let path = dir.join(format!("{}.dj", i));
+            fs::write(&path, "# Heading\n\nText\n".repeat(i)).unwrap();
+            paths.push(path);
+        }
+        paths.push(dir.join("missing.dj"));
+
+        let pool = ParserPool::new();
+        let results = parse_paths_parallel(&pool, &paths, |file| {
+            assert_eq!(file.tree.root_node().end_byte(), file.source.len());
+            file.source.len()
+        });
+        fs::remove_dir_all(&dir).unwrap();
+
+        for (i, result) in results[..20].iter().enumerate() {
+            assert_eq!(*result.as_ref().unwrap(), 16 * i);
+        }
+        assert!(results[20].is_err());
+    }
+}
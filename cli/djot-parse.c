@@ -0,0 +1,561 @@
+// Parse many Djot files at once and report statistics about every one.
+//
+// Usage: djot-parse [-j THREADS] PATH...
+//
+// Every PATH is a file, or a directory that is searched for `.dj` files,
+// skipping hidden ones and without following symbolic links. The files are
+// mapped into memory and parsed on THREADS threads, the number of processors
+// by default. Every thread has its own queue of files and takes files from
+// the others once its own is empty, so a few large files don't hold up the
+// rest. Directories are searched while the files are parsed, so the first
+// results come out right away however many files there are.
+//
+// For every file, one line of JSON is written to stdout as soon as it's
+// parsed, so the lines aren't in any particular order:
+//
+//   {"path": "doc.dj", "bytes": 1234, "parse_ms": 0.081, "nodes": 321,
+//    "errors": 0, "missing": 0, "max_depth": 9,
+//    "kinds": {"document": 1, "section": 2, "paragraph": 12, ...},
+//    "scanner": {"peak_bytes": 1184, "allocations": 3}}
+//
+// "nodes" counts all the nodes, and "kinds" the named ones by kind. "errors"
+// counts the ERROR nodes and "missing" the nodes the parser made up to
+// recover. "scanner" is what the external scanner allocated during the
+// parse. It's only there with one thread, as the counts are shared by all
+// parsers. Files that can't be read get a line with the "path" and an
+// "error" instead.
+//
+// Once all files are parsed, a summary is written to stderr, with what the
+// scanners allocated in all parses. The exit status is 1 if a file couldn't
+// be read, or else 2 if a file has errors, so this can check that the
+// documents of a repository parse cleanly.
+//
+// Run `make djot-parse` to build it.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "tree-sitter-djot.h"
+#include "tree_sitter/array.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <tree_sitter/api.h>
+#include <unistd.h>
+
+#ifndef TREE_SITTER_DJOT_MEMORY_STATS
+#error "djot-parse needs the scanner built with TREE_SITTER_DJOT_MEMORY_STATS"
+#endif
+
+// Files waiting in the queues at most, per thread.
+#define QUEUED_PER_THREAD 256
+
+typedef Array(char) Buffer;
+
+// The files of one thread. It takes them from the back, and the other
+// threads take them from the front.
+typedef struct {
+  pthread_mutex_t lock;
+  Array(char *) paths;
+  uint32_t head;
+} Queue;
+
+typedef struct {
+  const TSLanguage *language;
+  uint32_t symbol_count;
+  // The symbol that counts the nodes of every symbol, so that aliases with the
+  // same name are counted together.
+  TSSymbol *kinds;
+
+  Queue *queues;
+  uint32_t queue_count;
+  // Guards the fields below, and is taken before the lock of a queue.
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t room;
+  uint32_t queued;
+  uint32_t next_queue;
+  bool searched;
+
+  // Guards stdout and the totals.
+  pthread_mutex_t output_lock;
+  uint64_t files;
+  uint64_t bytes;
+  uint64_t failed;
+  uint64_t with_errors;
+  double parse_ms;
+  // What the scanners allocated. With one thread, the counts are reset for
+  // every file, so they're added here first.
+  TSDjotScannerMemoryStats scanner;
+} Pool;
+
+typedef struct {
+  Pool *pool;
+  uint32_t index;
+  pthread_t thread;
+  TSParser *parser;
+  uint32_t *counts;
+  Buffer output;
+} Worker;
+
+typedef struct {
+  uint32_t nodes;
+  uint32_t errors;
+  uint32_t missing;
+  uint32_t max_depth;
+} Stats;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Add the scanner counts since the last reset to `totals`.
+static void add_scanner_stats(TSDjotScannerMemoryStats *totals) {
+  TSDjotScannerMemoryStats stats;
+  tree_sitter_djot_scanner_memory_stats(&stats);
+  totals->live_bytes = stats.live_bytes;
+  if (stats.peak_bytes > totals->peak_bytes) {
+    totals->peak_bytes = stats.peak_bytes;
+  }
+  totals->scanner_allocations += stats.scanner_allocations;
+  totals->block_allocations += stats.block_allocations;
+  totals->inline_allocations += stats.inline_allocations;
+  totals->stack_allocations += stats.stack_allocations;
+  totals->frees += stats.frees;
+}
+
+// Output
+
+static void append(Buffer *buffer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  array_reserve(buffer, buffer->size + length + 1);
+  va_start(args, format);
+  vsnprintf(buffer->contents + buffer->size, length + 1, format, args);
+  va_end(args);
+  buffer->size += length;
+}
+
+static void append_string(Buffer *buffer, const char *string) {
+  array_push(buffer, '"');
+  for (const char *c = string; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      array_push(buffer, '\\');
+      array_push(buffer, *c);
+    } else if ((unsigned char)*c < 0x20) {
+      append(buffer, "\\u%04x", (unsigned char)*c);
+    } else {
+      array_push(buffer, *c);
+    }
+  }
+  array_push(buffer, '"');
+}
+
+// Parsing
+
+static void count_nodes(Worker *w, TSTree *tree, Stats *stats) {
+  const Pool *pool = w->pool;
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  uint32_t depth = 1;
+  stats->max_depth = 1;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    TSSymbol symbol = ts_node_symbol(node);
+    ++stats->nodes;
+    if (ts_node_is_error(node)) {
+      ++stats->errors;
+    } else if (ts_node_is_missing(node)) {
+      ++stats->missing;
+    } else if (symbol < pool->symbol_count && ts_node_is_named(node)) {
+      ++w->counts[pool->kinds[symbol]];
+    }
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      if (++depth > stats->max_depth) {
+        stats->max_depth = depth;
+      }
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+      --depth;
+    }
+  }
+}
+
+// Map the file at `path` into memory, or return an errno.
+static int map_file(const char *path, const char **contents,
+                    uint32_t *length) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return errno;
+  }
+  struct stat st;
+  int error = 0;
+  if (fstat(fd, &st) != 0) {
+    error = errno;
+  } else if (!S_ISREG(st.st_mode)) {
+    error = EINVAL;
+  } else if ((uint64_t)st.st_size > UINT32_MAX) {
+    error = EFBIG;
+  } else if (st.st_size == 0) {
+    *contents = "";
+    *length = 0;
+  } else {
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      error = errno;
+    } else {
+      *contents = mapped;
+      *length = (uint32_t)st.st_size;
+    }
+  }
+  close(fd);
+  return error;
+}
+
+static void parse_file(Worker *w, const char *path) {
+  Pool *pool = w->pool;
+  Buffer *out = &w->output;
+  array_clear(out);
+  append(out, "{\"path\": ");
+  append_string(out, path);
+
+  const char *contents = NULL;
+  uint32_t length = 0;
+  int error = map_file(path, &contents, &length);
+  Stats stats = {0};
+  double elapsed = 0;
+  if (error != 0) {
+    char message[256];
+    if (strerror_r(error, message, sizeof(message)) != 0) {
+      snprintf(message, sizeof(message), "error %d", error);
+    }
+    append(out, ", \"error\": ");
+    append_string(out, message);
+  } else {
+    bool one_thread = pool->queue_count == 1;
+    if (one_thread) {
+      add_scanner_stats(&pool->scanner);
+      tree_sitter_djot_scanner_memory_stats_reset();
+    }
+    double start = now_ms();
+    TSTree *tree = ts_parser_parse_string(w->parser, NULL, contents, length);
+    elapsed = now_ms() - start;
+
+    memset(w->counts, 0, pool->symbol_count * sizeof(uint32_t));
+    count_nodes(w, tree, &stats);
+    ts_tree_delete(tree);
+    if (length > 0) {
+      munmap((void *)contents, length);
+    }
+
+    append(out,
+           ", \"bytes\": %u, \"parse_ms\": %.3f, \"nodes\": %u, "
+           "\"errors\": %u, \"missing\": %u, \"max_depth\": %u, \"kinds\": {",
+           length, elapsed, stats.nodes, stats.errors, stats.missing,
+           stats.max_depth);
+    bool first = true;
+    for (uint32_t symbol = 0; symbol < pool->symbol_count; ++symbol) {
+      if (w->counts[symbol] == 0) {
+        continue;
+      }
+      append(out, "%s\"%s\": %u", first ? "" : ", ",
+             ts_language_symbol_name(pool->language, (TSSymbol)symbol),
+             w->counts[symbol]);
+      first = false;
+    }
+    array_push(out, '}');
+
+    if (one_thread) {
+      TSDjotScannerMemoryStats scanner;
+      tree_sitter_djot_scanner_memory_stats(&scanner);
+      append(out, ", \"scanner\": {\"peak_bytes\": %zu, \"allocations\": %zu}",
+             scanner.peak_bytes,
+             scanner.scanner_allocations + scanner.block_allocations +
+                 scanner.inline_allocations + scanner.stack_allocations);
+    }
+  }
+  append(out, "}\n");
+
+  pthread_mutex_lock(&pool->output_lock);
+  fwrite(out->contents, 1, out->size, stdout);
+  ++pool->files;
+  if (error != 0) {
+    ++pool->failed;
+  } else {
+    pool->bytes += length;
+    pool->parse_ms += elapsed;
+    if (stats.errors > 0 || stats.missing > 0) {
+      ++pool->with_errors;
+    }
+  }
+  pthread_mutex_unlock(&pool->output_lock);
+}
+
+// The queues
+
+static void add_file(Pool *pool, const char *path) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->queued >= QUEUED_PER_THREAD * pool->queue_count) {
+    pthread_cond_wait(&pool->room, &pool->lock);
+  }
+  Queue *queue = &pool->queues[pool->next_queue];
+  pool->next_queue = (pool->next_queue + 1) % pool->queue_count;
+  pthread_mutex_lock(&queue->lock);
+  array_push(&queue->paths, strdup(path));
+  pthread_mutex_unlock(&queue->lock);
+  ++pool->queued;
+  pthread_cond_signal(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static char *take_back(Queue *queue) {
+  char *path = NULL;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->paths.size > queue->head) {
+    path = array_pop(&queue->paths);
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return path;
+}
+
+static char *take_front(Queue *queue) {
+  char *path = NULL;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->paths.size > queue->head) {
+    path = queue->paths.contents[queue->head++];
+    if (queue->head == queue->paths.size) {
+      array_clear(&queue->paths);
+      queue->head = 0;
+    }
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return path;
+}
+
+// Take a file from the queue of the worker, or else from the others.
+static char *take_file(Worker *w) {
+  Pool *pool = w->pool;
+  char *path = take_back(&pool->queues[w->index]);
+  for (uint32_t i = 1; !path && i < pool->queue_count; ++i) {
+    path = take_front(&pool->queues[(w->index + i) % pool->queue_count]);
+  }
+  if (path) {
+    pthread_mutex_lock(&pool->lock);
+    --pool->queued;
+    pthread_cond_signal(&pool->room);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return path;
+}
+
+static void *run_worker(void *payload) {
+  Worker *w = payload;
+  Pool *pool = w->pool;
+  for (;;) {
+    char *path = take_file(w);
+    if (path) {
+      parse_file(w, path);
+      free(path);
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued == 0 && !pool->searched) {
+      pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    bool done = pool->queued == 0 && pool->searched;
+    pthread_mutex_unlock(&pool->lock);
+    if (done) {
+      return NULL;
+    }
+  }
+}
+
+// Searching
+
+static bool is_djot(const char *name) {
+  size_t length = strlen(name);
+  return length > 3 && strcmp(name + length - 3, ".dj") == 0;
+}
+
+// Add the `.dj` files under the directory at `path`, which is extended with
+// the names inside it while they're searched.
+static void add_directory(Pool *pool, Buffer *path) {
+  array_push(path, '\0');
+  DIR *dir = opendir(path->contents);
+  --path->size;
+  if (!dir) {
+    perror(path->contents);
+    return;
+  }
+  uint32_t length = path->size;
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    path->size = length;
+    array_push(path, '/');
+    array_extend(path, strlen(entry->d_name) + 1, entry->d_name);
+    --path->size;
+
+    bool is_dir = false;
+    bool is_file = false;
+    bool known = false;
+#ifdef DT_DIR
+    // Saves a stat per file on most file systems.
+    is_dir = entry->d_type == DT_DIR;
+    is_file = entry->d_type == DT_REG;
+    known = entry->d_type != DT_UNKNOWN;
+#endif
+    struct stat st;
+    if (!known && lstat(path->contents, &st) == 0) {
+      is_dir = S_ISDIR(st.st_mode);
+      is_file = S_ISREG(st.st_mode);
+    }
+    if (is_dir) {
+      add_directory(pool, path);
+    } else if (is_file && is_djot(entry->d_name)) {
+      add_file(pool, path->contents);
+    }
+  }
+  path->size = length;
+  closedir(dir);
+}
+
+static void add_path(Pool *pool, const char *path) {
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+    Buffer buffer = array_new();
+    array_extend(&buffer, strlen(path), path);
+    while (buffer.size > 1 && buffer.contents[buffer.size - 1] == '/') {
+      --buffer.size;
+    }
+    add_directory(pool, &buffer);
+    array_delete(&buffer);
+  } else {
+    // Reported by the worker if it can't be read.
+    add_file(pool, path);
+  }
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-j THREADS] PATH...\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "j:")) != -1) {
+    switch (opt) {
+    case 'j':
+      threads = atol(optarg);
+      if (threads <= 0) {
+        usage(argv[0]);
+      }
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+  }
+  if (threads <= 0) {
+    threads = 1;
+  }
+
+  Pool pool = {
+      .language = tree_sitter_djot(),
+      .queue_count = (uint32_t)threads,
+  };
+  pool.symbol_count = ts_language_symbol_count(pool.language);
+  pool.kinds = calloc(pool.symbol_count, sizeof(TSSymbol));
+  for (uint32_t symbol = 0; symbol < pool.symbol_count; ++symbol) {
+    const char *name = ts_language_symbol_name(pool.language, symbol);
+    TSSymbol kind = ts_language_symbol_for_name(pool.language, name,
+                                                strlen(name), true);
+    pool.kinds[symbol] = kind < pool.symbol_count ? kind : symbol;
+  }
+  pool.queues = calloc(pool.queue_count, sizeof(Queue));
+  for (uint32_t i = 0; i < pool.queue_count; ++i) {
+    pthread_mutex_init(&pool.queues[i].lock, NULL);
+  }
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.room, NULL);
+  pthread_mutex_init(&pool.output_lock, NULL);
+
+  double start = now_ms();
+  Worker *workers = calloc(pool.queue_count, sizeof(Worker));
+  for (uint32_t i = 0; i < pool.queue_count; ++i) {
+    Worker *w = &workers[i];
+    w->pool = &pool;
+    w->index = i;
+    w->parser = ts_parser_new();
+    ts_parser_set_language(w->parser, pool.language);
+    w->counts = calloc(pool.symbol_count, sizeof(uint32_t));
+    pthread_create(&w->thread, NULL, run_worker, w);
+  }
+
+  for (int i = optind; i < argc; ++i) {
+    add_path(&pool, argv[i]);
+  }
+  pthread_mutex_lock(&pool.lock);
+  pool.searched = true;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+
+  for (uint32_t i = 0; i < pool.queue_count; ++i) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (uint32_t i = 0; i < pool.queue_count; ++i) {
+    Worker *w = &workers[i];
+    ts_parser_delete(w->parser);
+    free(w->counts);
+    array_delete(&w->output);
+    array_delete(&pool.queues[i].paths);
+    pthread_mutex_destroy(&pool.queues[i].lock);
+  }
+  double elapsed = now_ms() - start;
+
+  add_scanner_stats(&pool.scanner);
+  const TSDjotScannerMemoryStats *scanner = &pool.scanner;
+  fprintf(stderr,
+          "{\"files\": %llu, \"bytes\": %llu, \"failed\": %llu, "
+          "\"with_errors\": %llu, \"parse_ms\": %.3f, \"wall_ms\": %.3f, "
+          "\"threads\": %u, \"scanner\": {\"peak_bytes\": %zu, "
+          "\"scanners\": %zu, \"blocks\": %zu, \"inlines\": %zu, "
+          "\"stacks\": %zu, \"frees\": %zu}}\n",
+          (unsigned long long)pool.files, (unsigned long long)pool.bytes,
+          (unsigned long long)pool.failed,
+          (unsigned long long)pool.with_errors, pool.parse_ms, elapsed,
+          pool.queue_count, scanner->peak_bytes,
+          scanner->scanner_allocations, scanner->block_allocations,
+          scanner->inline_allocations, scanner->stack_allocations,
+          scanner->frees);
+
+  free(workers);
+  free(pool.queues);
+  free(pool.kinds);
+  return pool.failed > 0 ? 1 : pool.with_errors > 0 ? 2 : 0;
+}
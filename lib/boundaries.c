@@ -0,0 +1,147 @@
+#include "results.h"
+#include "tree-sitter-djot-utils.h"
+#include <string.h>
+
+typedef struct {
+  Array(TSDjotBoundary) boundaries;
+  // The sections open at the current position in the walk.
+  TSDjotBoundary current;
+  // Sections open before the tree starts, when it was parsed from a boundary.
+  const TSDjotBoundary *base;
+
+  TSSymbol section;
+  TSSymbol section_content;
+  TSSymbol heading;
+  TSSymbol thematic_break;
+} Collector;
+
+static TSSymbol symbol(const TSLanguage *language, const char *name) {
+  return ts_language_symbol_for_name(language, name, strlen(name), true);
+}
+
+// The number of `#` in a heading, from the length of its `## ` marker.
+static uint8_t heading_level(TSNode heading) {
+  TSNode marker = ts_node_named_child(heading, 0);
+  if (ts_node_is_null(marker)) {
+    return 0;
+  }
+  uint32_t length = ts_node_end_byte(marker) - ts_node_start_byte(marker);
+  return length > 1 ? (uint8_t)(length - 1) : 0;
+}
+
+static void add_boundary(Collector *c, TSNode node) {
+  TSDjotBoundary boundary = c->current;
+  TSPoint start = ts_node_start_point(node);
+  // Blocks may be indented, but we always resume from the start of the line.
+  boundary.start_byte = ts_node_start_byte(node) - start.column;
+  boundary.start_point = (TSPoint){start.row, 0};
+
+  // Sections from the base are closed by the first section in the tree with
+  // the same or a lower level, exactly like the scanner closes them.
+  if (c->base) {
+    uint8_t lowest = boundary.section_depth > 0 ? boundary.section_levels[0]
+                                                : UINT8_MAX;
+    uint8_t depth = 0;
+    uint8_t levels[TREE_SITTER_DJOT_MAX_SECTION_DEPTH];
+    for (uint8_t i = 0; i < c->base->section_depth; ++i) {
+      if (c->base->section_levels[i] < lowest) {
+        levels[depth++] = c->base->section_levels[i];
+      }
+    }
+    if (depth + boundary.section_depth > TREE_SITTER_DJOT_MAX_SECTION_DEPTH) {
+      return;
+    }
+    memmove(boundary.section_levels + depth, boundary.section_levels,
+            boundary.section_depth);
+    memcpy(boundary.section_levels, levels, depth);
+    boundary.section_depth += depth;
+  }
+
+  array_push(&c->boundaries, boundary);
+}
+
+// Record a boundary before every block below the cursor, which points to the
+// document or to the content of a section.
+static void collect_blocks(Collector *c, TSTreeCursor *cursor) {
+  if (!ts_tree_cursor_goto_first_child(cursor)) {
+    return;
+  }
+
+  bool previous_has_error = false;
+  do {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    if (!ts_node_is_named(node)) {
+      continue;
+    }
+
+    // We can't know the state after a syntax error, and a thematic break
+    // looks like a frontmatter marker when we start parsing from it.
+    TSSymbol symbol = ts_node_symbol(node);
+    if (!previous_has_error && !ts_node_is_error(node) &&
+        symbol != c->thematic_break) {
+      add_boundary(c, node);
+    }
+    previous_has_error = ts_node_has_error(node);
+
+    if (symbol != c->section ||
+        c->current.section_depth == TREE_SITTER_DJOT_MAX_SECTION_DEPTH) {
+      continue;
+    }
+
+    // Descend into the content of the section, with the section open.
+    if (!ts_tree_cursor_goto_first_child(cursor)) {
+      continue;
+    }
+    uint8_t level = 0;
+    do {
+      TSNode child = ts_tree_cursor_current_node(cursor);
+      TSSymbol child_symbol = ts_node_symbol(child);
+      if (child_symbol == c->heading) {
+        level = heading_level(child);
+      } else if (child_symbol == c->section_content && level > 0) {
+        c->current.section_levels[c->current.section_depth++] = level;
+        collect_blocks(c, cursor);
+        --c->current.section_depth;
+      }
+    } while (ts_tree_cursor_goto_next_sibling(cursor));
+    ts_tree_cursor_goto_parent(cursor);
+  } while (ts_tree_cursor_goto_next_sibling(cursor));
+
+  ts_tree_cursor_goto_parent(cursor);
+}
+
+TSDjotBoundary *tree_sitter_djot_boundaries(const TSTree *tree,
+                                            const TSDjotBoundary *base,
+                                            uint32_t *length) {
+  const TSLanguage *language = ts_tree_language(tree);
+  Collector c = {
+      .base = base,
+      .section = symbol(language, "section"),
+      .section_content = symbol(language, "section_content"),
+      .heading = symbol(language, "heading"),
+      .thematic_break = symbol(language, "thematic_break"),
+  };
+  array_init(&c.boundaries);
+
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  collect_blocks(&c, &cursor);
+  ts_tree_cursor_delete(&cursor);
+
+  *length = c.boundaries.size;
+  return array_release(&c.boundaries);
+}
+
+TSTree *tree_sitter_djot_parse_from(TSParser *parser,
+                                    const TSDjotBoundary *boundary,
+                                    const char *string, uint32_t length) {
+  TSRange range = {
+      .start_point = boundary->start_point,
+      .end_point = {UINT32_MAX, UINT32_MAX},
+      .start_byte = boundary->start_byte,
+      .end_byte = UINT32_MAX,
+  };
+  ts_parser_set_included_ranges(parser, &range, 1);
+  TSTree *tree = ts_parser_parse_string(parser, NULL, string, length);
+  ts_parser_set_included_ranges(parser, NULL, 0);
+  return tree;
+}
@@ -0,0 +1,218 @@
+#include "edits.h"
+#include <stdlib.h>
+
+void edit_ranges_add_edit(EditRanges *ranges, const TSInputEdit *edit) {
+  for (uint32_t i = 0; i < ranges->size; ++i) {
+    EditRange *range = &ranges->contents[i];
+    range->start_byte = edit_shift(range->start_byte, edit);
+    range->end_byte = edit_shift(range->end_byte, edit);
+  }
+  EditRange range = {edit->start_byte, edit->new_end_byte};
+  array_push(ranges, range);
+}
+
+void edit_ranges_add_changed(EditRanges *ranges, const TSTree *old_tree,
+                             const TSTree *new_tree) {
+  uint32_t count = 0;
+  TSRange *changed = ts_tree_get_changed_ranges(old_tree, new_tree, &count);
+  for (uint32_t i = 0; i < count; ++i) {
+    EditRange range = {changed[i].start_byte, changed[i].end_byte};
+    array_push(ranges, range);
+  }
+  free(changed);
+}
+
+static int compare_ranges(const void *a, const void *b) {
+  const EditRange *x = a, *y = b;
+  return x->start_byte < y->start_byte ? -1 : x->start_byte > y->start_byte;
+}
+
+void edit_ranges_merge(EditRanges *ranges) {
+  if (ranges->size < 2) {
+    return;
+  }
+  qsort(ranges->contents, ranges->size, sizeof(EditRange), compare_ranges);
+  uint32_t merged = 0;
+  for (uint32_t i = 1; i < ranges->size; ++i) {
+    EditRange *last = &ranges->contents[merged];
+    const EditRange *range = &ranges->contents[i];
+    if (range->start_byte <= last->end_byte) {
+      if (range->end_byte > last->end_byte) {
+        last->end_byte = range->end_byte;
+      }
+    } else {
+      ranges->contents[++merged] = *range;
+    }
+  }
+  ranges->size = merged + 1;
+}
+
+void edit_walk(TSNode root, const EditRange *range, EditVisitor visit,
+               void *payload) {
+  // The first child that ends at the start of the range or after it.
+  uint32_t goal = range->start_byte > 0 ? range->start_byte - 1 : 0;
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  if (ts_tree_cursor_goto_first_child_for_byte(&cursor, goal) < 0) {
+    ts_tree_cursor_delete(&cursor);
+    return;
+  }
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    uint32_t start = ts_node_start_byte(node);
+    bool descend = edit_range_touches(start, ts_node_end_byte(node), range) &&
+                   visit(payload, node);
+
+    if (descend &&
+        ts_tree_cursor_goto_first_child_for_byte(&cursor, goal) >= 0) {
+      continue;
+    }
+    // The following siblings start after the range once this one does.
+    while (start > range->end_byte ||
+           !ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+      start = 0;
+    }
+  }
+}
+
+void edit_tracker_init(EditTracker *self, size_t item_size,
+                       size_t start_offset, size_t end_offset,
+                       int (*compare)(const void *, const void *)) {
+  *self = (EditTracker){
+      .item_size = item_size,
+      .start_offset = start_offset,
+      .end_offset = end_offset,
+      .compare = compare,
+  };
+  array_init(&self->edits);
+  array_init(&self->walked);
+  array_init(&self->dropped);
+}
+
+void edit_tracker_delete(EditTracker *self) {
+  array_delete(&self->edits);
+  array_delete(&self->walked);
+  array_delete(&self->dropped);
+}
+
+static uint32_t item_byte(const EditTracker *self, const void *items,
+                          uint32_t index, size_t offset) {
+  const char *item = (const char *)items + index * self->item_size;
+  return *(const uint32_t *)(item + offset);
+}
+
+bool edit_tracker_begin_update(EditTracker *self, const TSTree *old_tree,
+                               const TSTree *new_tree, const void *items,
+                               uint32_t count) {
+  edit_ranges_add_changed(&self->edits, old_tree, new_tree);
+  if (self->edits.size == 0) {
+    return false;
+  }
+  edit_ranges_merge(&self->edits);
+
+  array_clear(&self->walked);
+  array_push_all(&self->walked, &self->edits);
+  array_clear(&self->dropped);
+  uint32_t last_byte = array_back(&self->edits)->end_byte;
+  uint32_t range = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t start = item_byte(self, items, i, self->start_offset);
+    if (start > last_byte) {
+      break;
+    }
+    while (range < self->edits.size &&
+           self->edits.contents[range].end_byte < start) {
+      ++range;
+    }
+    if (range < self->edits.size &&
+        edit_range_touches(start, item_byte(self, items, i, self->end_offset),
+                           &self->edits.contents[range])) {
+      EditRange walked = {start, start};
+      array_push(&self->walked, walked);
+      array_push(&self->dropped, i);
+    }
+  }
+  edit_ranges_merge(&self->walked);
+  return true;
+}
+
+// Find the first item at or after `index` that starts at `byte` or after it.
+static uint32_t find_item(const EditTracker *self, const Array *items,
+                          uint32_t index, uint32_t byte) {
+  uint32_t end = items->size;
+  while (index < end) {
+    uint32_t middle = index + (end - index) / 2;
+    if (item_byte(self, items->contents, middle, self->start_offset) < byte) {
+      index = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return index;
+}
+
+// Append the items from `start` to `end` that weren't dropped. `dropped` is
+// the next of the dropped indices, which are sorted.
+static void copy_kept(const EditTracker *self, const Array *items,
+                      uint32_t start, uint32_t end, uint32_t *dropped,
+                      Array *result) {
+  while (start < end) {
+    uint32_t stop = end;
+    if (*dropped < self->dropped.size &&
+        self->dropped.contents[*dropped] < end) {
+      stop = self->dropped.contents[*dropped];
+    }
+    _array__splice(result, self->item_size, result->size, 0, stop - start,
+                   (const char *)items->contents + start * self->item_size);
+    start = stop;
+    while (start < end && *dropped < self->dropped.size &&
+           self->dropped.contents[*dropped] == start) {
+      ++start;
+      ++*dropped;
+    }
+  }
+}
+
+void edit_tracker_end_update(EditTracker *self, Array *items, Array *added,
+                             Array *spare) {
+  // An item that touches two ranges is found twice, before the items in the
+  // second range.
+  if (added->size > 1) {
+    qsort(added->contents, added->size, self->item_size, self->compare);
+  }
+
+  // Copy the kept items between the new ones. Both are few, so this is
+  // mostly a few `memcpy`s into the spare array, which is kept so it isn't
+  // allocated again.
+  array_clear(spare);
+  _array__reserve(spare, self->item_size, items->size + added->size);
+  uint32_t next = 0;
+  uint32_t dropped = 0;
+  for (uint32_t i = 0; i < added->size; ++i) {
+    uint32_t start = item_byte(self, added->contents, i, self->start_offset);
+    if (spare->size > 0 &&
+        item_byte(self, spare->contents, spare->size - 1,
+                  self->start_offset) == start) {
+      continue;
+    }
+    uint32_t end = find_item(self, items, next, start);
+    copy_kept(self, items, next, end, &dropped, spare);
+    next = end;
+    if (next < items->size &&
+        item_byte(self, items->contents, next, self->start_offset) == start) {
+      if (dropped < self->dropped.size &&
+          self->dropped.contents[dropped] == next) {
+        ++dropped;
+      }
+      ++next;
+    }
+    _array__splice(spare, self->item_size, spare->size, 0, 1,
+                   (const char *)added->contents + i * self->item_size);
+  }
+  copy_kept(self, items, next, items->size, &dropped, spare);
+  _array__swap(items, spare);
+  array_clear(&self->edits);
+}
@@ -0,0 +1,115 @@
+#ifndef TREE_SITTER_DJOT_EDITS_H_
+#define TREE_SITTER_DJOT_EDITS_H_
+
+// Shared by the helpers that walk the nodes in a byte range and keep what
+// they find up to date after edits, like the reference index and the outline.
+
+#include "tree-sitter-djot-utils.h"
+#include "tree_sitter/array.h"
+#include <string.h>
+
+typedef struct {
+  uint32_t start_byte;
+  uint32_t end_byte;
+} EditRange;
+
+typedef Array(EditRange) EditRanges;
+
+static inline TSSymbol edit_symbol(const TSLanguage *language,
+                                   const char *name) {
+  return ts_language_symbol_for_name(language, name, (uint32_t)strlen(name),
+                                     true);
+}
+
+// Move `byte` like `ts_tree_edit` moves nodes: bytes after the edit move with
+// its end, and bytes in removed text move to its end.
+static inline uint32_t edit_shift(uint32_t byte, const TSInputEdit *edit) {
+  if (byte >= edit->old_end_byte) {
+    return byte - edit->old_end_byte + edit->new_end_byte;
+  }
+  if (byte > edit->new_end_byte) {
+    return edit->new_end_byte;
+  }
+  return byte;
+}
+
+// Move `row`, the row of `byte`, along with `byte` in `edit_shift`.
+static inline uint32_t edit_shift_row(uint32_t byte, uint32_t row,
+                                      const TSInputEdit *edit) {
+  if (byte >= edit->old_end_byte) {
+    return row - edit->old_end_point.row + edit->new_end_point.row;
+  }
+  if (byte > edit->new_end_byte) {
+    return edit->new_end_point.row;
+  }
+  return row;
+}
+
+// If the range from `start` to `end` overlaps `range` or is next to it.
+static inline bool edit_range_touches(uint32_t start, uint32_t end,
+                                      const EditRange *range) {
+  return start <= range->end_byte && end >= range->start_byte;
+}
+
+// Shift the ranges recorded since the last update by `edit`, and add the
+// range of the new text.
+void edit_ranges_add_edit(EditRanges *ranges, const TSInputEdit *edit);
+
+// Add the ranges that `ts_tree_get_changed_ranges` reports. Edits that keep
+// the structure of the tree, like typing in a paragraph, aren't reported,
+// which is why the edits are recorded too.
+void edit_ranges_add_changed(EditRanges *ranges, const TSTree *old_tree,
+                             const TSTree *new_tree);
+
+// Sort the ranges and merge the ones that overlap.
+void edit_ranges_merge(EditRanges *ranges);
+
+// Called with every node that touches the walked range, in document order.
+// Returns true to visit the children of the node that touch it too.
+typedef bool (*EditVisitor)(void *payload, TSNode node);
+
+// Visit the nodes below `root` that touch `range`. Only those nodes are
+// visited, skipping to them with `ts_tree_cursor_goto_first_child_for_byte`.
+void edit_walk(TSNode root, const EditRange *range, EditVisitor visit,
+               void *payload);
+
+// Keeps an array of items, like the headings of the outline, up to date. The
+// items are sorted by their start byte, and no two start at the same byte.
+//
+// An update drops the items that touch the changed ranges, and walks those
+// ranges and the starts of the dropped items again: an item that ended in
+// removed text may not touch the ranges anymore. The items it finds replace
+// the kept ones with the same start.
+typedef struct {
+  size_t item_size;
+  // Where the start and end bytes of the item are.
+  size_t start_offset;
+  size_t end_offset;
+  // Orders items by their start byte, for `qsort`.
+  int (*compare)(const void *, const void *);
+
+  // The ranges of the edits since the last update.
+  EditRanges edits;
+  // The ranges to walk again, and the indices of the dropped items.
+  EditRanges walked;
+  Array(uint32_t) dropped;
+} EditTracker;
+
+void edit_tracker_init(EditTracker *self, size_t item_size,
+                       size_t start_offset, size_t end_offset,
+                       int (*compare)(const void *, const void *));
+
+void edit_tracker_delete(EditTracker *self);
+
+// Add the changed ranges and find the items to drop and the ranges to walk.
+// Returns false if nothing changed.
+bool edit_tracker_begin_update(EditTracker *self, const TSTree *old_tree,
+                               const TSTree *new_tree, const void *items,
+                               uint32_t count);
+
+// Replace `items` with the kept ones and the `added` ones found by walking
+// `walked`, using `spare` for the merge. All three are arrays of items.
+void edit_tracker_end_update(EditTracker *self, Array *items, Array *added,
+                             Array *spare);
+
+#endif // TREE_SITTER_DJOT_EDITS_H_
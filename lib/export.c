@@ -0,0 +1,102 @@
+#include "tree-sitter-djot-utils.h"
+#include "tree_sitter/array.h"
+#include <errno.h>
+#include <stdlib.h>
+
+// The nodes are written in the order a cursor visits them, so a node's
+// descendants are the nodes after it, up to its `subtree_end`. That's all a
+// reader needs to walk the tree without following pointers.
+//
+// The fields are written in little-endian byte order whatever the machine, so
+// an export can be read on another one.
+
+static uint8_t *write_u16(uint8_t *p, uint16_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  return p + 2;
+}
+
+static uint8_t *write_u32(uint8_t *p, uint32_t value) {
+  p = write_u16(p, (uint16_t)value);
+  return write_u16(p, (uint16_t)(value >> 16));
+}
+
+static uint8_t flags(TSNode node) {
+  return (ts_node_is_named(node) ? TSDjotExportNamed : 0) |
+         (ts_node_is_missing(node) ? TSDjotExportMissing : 0) |
+         (ts_node_is_extra(node) ? TSDjotExportExtra : 0) |
+         (ts_node_is_error(node) ? TSDjotExportError : 0);
+}
+
+uint8_t *tree_sitter_djot_export(const TSTree *tree, size_t *length) {
+  TSNode root = ts_tree_root_node(tree);
+  Array(TSDjotExportNode) nodes = array_new();
+  array_reserve(&nodes, ts_node_descendant_count(root));
+  // The indices of the nodes the cursor is inside of.
+  Array(uint32_t) parents = array_new();
+
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    uint32_t index = nodes.size;
+    TSDjotExportNode exported = {
+        .kind = ts_node_symbol(node),
+        .field = (uint8_t)ts_tree_cursor_current_field_id(&cursor),
+        .flags = flags(node),
+        .start_byte = ts_node_start_byte(node),
+        .end_byte = ts_node_end_byte(node),
+        .parent = parents.size > 0 ? *array_back(&parents)
+                                   : TREE_SITTER_DJOT_EXPORT_NO_PARENT,
+    };
+    array_push(&nodes, exported);
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      array_push(&parents, index);
+      continue;
+    }
+    nodes.contents[index].subtree_end = nodes.size;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        goto done;
+      }
+      nodes.contents[array_pop(&parents)].subtree_end = nodes.size;
+    }
+  }
+
+done:
+  ts_tree_cursor_delete(&cursor);
+  array_delete(&parents);
+
+  TSDjotExportHeader header = {
+      .magic = TREE_SITTER_DJOT_EXPORT_MAGIC,
+      .version = TREE_SITTER_DJOT_EXPORT_VERSION,
+      .node_count = nodes.size,
+      .source_length = ts_node_end_byte(root),
+  };
+  size_t nodes_size = nodes.size * sizeof(TSDjotExportNode);
+  uint8_t *result = malloc(sizeof(header) + nodes_size);
+  if (!result) {
+    array_delete(&nodes);
+    errno = ENOMEM;
+    return NULL;
+  }
+  uint8_t *p = result;
+  p = write_u32(p, header.magic);
+  p = write_u32(p, header.version);
+  p = write_u32(p, header.node_count);
+  p = write_u32(p, header.source_length);
+  for (uint32_t i = 0; i < nodes.size; ++i) {
+    const TSDjotExportNode *node = &nodes.contents[i];
+    p = write_u16(p, node->kind);
+    *p++ = node->field;
+    *p++ = node->flags;
+    p = write_u32(p, node->start_byte);
+    p = write_u32(p, node->end_byte);
+    p = write_u32(p, node->parent);
+    p = write_u32(p, node->subtree_end);
+  }
+  array_delete(&nodes);
+
+  *length = sizeof(header) + nodes_size;
+  return result;
+}
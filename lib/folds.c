@@ -0,0 +1,153 @@
+#include "edits.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// The same folds as `queries/folds.scm`, from a cursor walk that steps over
+// paragraphs, headings, tables and code, which can't hold any.
+//
+// Updates work like for the outline: edits shift the folds after them, and
+// an update walks only the blocks that touch the changed ranges again. Every
+// folded block starts with its own marker or heading, so two folds never
+// start at the same byte, and a new fold replaces the kept one with the same
+// start.
+
+typedef Array(TSDjotFold) Folds;
+
+struct TSDjotFolds {
+  TSSymbol section;
+  TSSymbol code_block;
+  TSSymbol raw_block;
+  TSSymbol list;
+  TSSymbol div;
+  TSSymbol paragraph;
+  TSSymbol heading;
+  TSSymbol table;
+
+  Folds folds;
+  EditTracker tracker;
+
+  // Reused by updates.
+  Folds added;
+  Folds spare;
+};
+
+typedef struct {
+  const TSDjotFolds *self;
+  Folds *result;
+} Collector;
+
+static void add_fold(TSNode node, Folds *result) {
+  TSPoint start = ts_node_start_point(node);
+  TSPoint end = ts_node_end_point(node);
+  // Blocks end after their last newline, on the next row.
+  uint32_t end_row = end.column == 0 && end.row > start.row ? end.row - 1
+                                                            : end.row;
+  if (end_row == start.row) {
+    return;
+  }
+  TSDjotFold fold = {
+      .start_byte = ts_node_start_byte(node),
+      .end_byte = ts_node_end_byte(node),
+      .start_row = start.row,
+      .end_row = end_row,
+  };
+  array_push(result, fold);
+}
+
+static bool visit(void *payload, TSNode node) {
+  Collector *c = payload;
+  TSSymbol symbol = ts_node_symbol(node);
+  if (symbol == c->self->section || symbol == c->self->list ||
+      symbol == c->self->div) {
+    add_fold(node, c->result);
+    return true;
+  }
+  if (symbol == c->self->code_block || symbol == c->self->raw_block) {
+    add_fold(node, c->result);
+    return false;
+  }
+  return symbol != c->self->paragraph && symbol != c->self->heading &&
+         symbol != c->self->table;
+}
+
+// Collect the folds of the blocks that touch `range`, in document order.
+static void collect(const TSDjotFolds *self, TSNode root,
+                    const EditRange *range, Folds *result) {
+  Collector c = {self, result};
+  edit_walk(root, range, visit, &c);
+}
+
+static int compare_folds(const void *a, const void *b) {
+  const TSDjotFold *x = a, *y = b;
+  return x->start_byte < y->start_byte ? -1 : x->start_byte > y->start_byte;
+}
+
+TSDjotFolds *tree_sitter_djot_folds_new(const TSTree *tree) {
+  const TSLanguage *language = ts_tree_language(tree);
+  TSDjotFolds *self = calloc(1, sizeof(TSDjotFolds));
+  if (!self) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  edit_tracker_init(&self->tracker, sizeof(TSDjotFold),
+                    offsetof(TSDjotFold, start_byte),
+                    offsetof(TSDjotFold, end_byte), compare_folds);
+  self->section = edit_symbol(language, "section");
+  self->code_block = edit_symbol(language, "code_block");
+  self->raw_block = edit_symbol(language, "raw_block");
+  self->list = edit_symbol(language, "list");
+  self->div = edit_symbol(language, "div");
+  self->paragraph = edit_symbol(language, "paragraph");
+  self->heading = edit_symbol(language, "heading");
+  self->table = edit_symbol(language, "table");
+
+  TSNode root = ts_tree_root_node(tree);
+  EditRange everything = {0, ts_node_end_byte(root)};
+  collect(self, root, &everything, &self->folds);
+  return self;
+}
+
+void tree_sitter_djot_folds_delete(TSDjotFolds *self) {
+  array_delete(&self->folds);
+  edit_tracker_delete(&self->tracker);
+  array_delete(&self->added);
+  array_delete(&self->spare);
+  free(self);
+}
+
+const TSDjotFold *tree_sitter_djot_folds_ranges(const TSDjotFolds *self,
+                                                uint32_t *count) {
+  *count = self->folds.size;
+  return self->folds.contents;
+}
+
+void tree_sitter_djot_folds_edit(TSDjotFolds *self, const TSInputEdit *edit) {
+  // Folds that touched the edit still touch its range once they're shifted,
+  // so the update finds them.
+  for (uint32_t i = 0; i < self->folds.size; ++i) {
+    TSDjotFold *fold = &self->folds.contents[i];
+    if (fold->end_byte >= edit->start_byte) {
+      fold->start_row = edit_shift_row(fold->start_byte, fold->start_row, edit);
+      fold->end_row = edit_shift_row(fold->end_byte, fold->end_row, edit);
+      fold->start_byte = edit_shift(fold->start_byte, edit);
+      fold->end_byte = edit_shift(fold->end_byte, edit);
+    }
+  }
+  edit_ranges_add_edit(&self->tracker.edits, edit);
+}
+
+void tree_sitter_djot_folds_update(TSDjotFolds *self, const TSTree *old_tree,
+                                   const TSTree *new_tree) {
+  if (!edit_tracker_begin_update(&self->tracker, old_tree, new_tree,
+                                 self->folds.contents, self->folds.size)) {
+    return;
+  }
+  array_clear(&self->added);
+  TSNode root = ts_tree_root_node(new_tree);
+  for (uint32_t i = 0; i < self->tracker.walked.size; ++i) {
+    collect(self, root, &self->tracker.walked.contents[i], &self->added);
+  }
+  edit_tracker_end_update(&self->tracker, (Array *)&self->folds,
+                          (Array *)&self->added, (Array *)&self->spare);
+}
@@ -0,0 +1,1886 @@
+#include "tree-sitter-djot-utils.h"
+#include "tree_sitter/array.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The tree is rendered in one walk with a cursor, after a pre-pass that
+// collects what can be referred to before it is defined: link reference
+// definitions, footnotes and inline attributes, which follow the element they
+// apply to. Text is the source between the nodes that aren't text, escaped
+// and copied straight into the output.
+//
+// The output follows the reference implementation where the tree allows it.
+// Headings get ids from their text, without deduplication.
+//
+// When an allocation fails, the renderer stops emitting and growing its
+// arrays, and the render fails with `errno` set to `ENOMEM`.
+
+// How much output is collected before it's passed to the callback.
+#define FLUSH_SIZE (64 * 1024)
+
+typedef enum {
+  OTHER,
+  // Anonymous nodes are the text they cover, like a `_` that doesn't start
+  // emphasis.
+  TEXT,
+  // Nodes that are neither text nor output, like block quote markers.
+  SKIP,
+
+  SECTION,
+  SECTION_CONTENT,
+  HEADING,
+  CONTENT,
+  MARKER,
+  PARAGRAPH,
+  LIST,
+  LIST_ITEM,
+  LIST_ITEM_CONTENT,
+  TERM,
+  DEFINITION,
+  BLOCK_QUOTE,
+  DIV,
+  CLASS_NAME,
+  CODE_BLOCK,
+  LANGUAGE,
+  CODE,
+  RAW_BLOCK,
+  RAW_BLOCK_INFO,
+  THEMATIC_BREAK,
+  MATH,
+  MATH_MARKER,
+  LINK_REFERENCE_DEFINITION,
+  LINK_LABEL,
+  LINK_DESTINATION,
+  BLOCK_ATTRIBUTE,
+  INLINE_ATTRIBUTE,
+  ARGS,
+  CLASS,
+  IDENTIFIER,
+  KEY_VALUE,
+  KEY,
+  VALUE,
+  FOOTNOTE,
+  FOOTNOTE_CONTENT,
+  REFERENCE_LABEL,
+  FOOTNOTE_REFERENCE,
+  TABLE,
+  TABLE_HEADER,
+  TABLE_ROW,
+  TABLE_SEPARATOR,
+  TABLE_CELL,
+  TABLE_CELL_ALIGNMENT,
+  TABLE_CAPTION,
+
+  LIST_MARKER_BULLET,
+  LIST_MARKER_TASK,
+  LIST_MARKER_DEFINITION,
+  LIST_MARKER_DECIMAL,
+  LIST_MARKER_LOWER_ALPHA,
+  LIST_MARKER_UPPER_ALPHA,
+  LIST_MARKER_LOWER_ROMAN,
+  LIST_MARKER_UPPER_ROMAN,
+  CHECKED,
+
+  EMPHASIS,
+  STRONG,
+  HIGHLIGHTED,
+  SUPERSCRIPT,
+  SUBSCRIPT,
+  INSERT,
+  DELETE,
+  SPAN,
+  VERBATIM,
+  RAW_INLINE,
+  RAW_INLINE_ATTRIBUTE,
+  AUTOLINK,
+  BACKSLASH_ESCAPE,
+  HARD_LINE_BREAK,
+  QUOTATION_MARKS,
+  ELLIPSIS,
+  EM_DASH,
+  EN_DASH,
+  INLINE_LINK,
+  FULL_REFERENCE_LINK,
+  COLLAPSED_REFERENCE_LINK,
+  INLINE_IMAGE,
+  FULL_REFERENCE_IMAGE,
+  COLLAPSED_REFERENCE_IMAGE,
+  LINK_TEXT,
+  IMAGE_DESCRIPTION,
+  INLINE_LINK_DESTINATION,
+} Kind;
+
+typedef struct {
+  const char *name;
+  Kind kind;
+} KindName;
+
+// The named node kinds the renderer tells apart. Kinds that are only text,
+// like `symbol` or `todo`, aren't listed and are output as they are.
+static const KindName KIND_NAMES[] = {
+    {"section", SECTION},
+    {"section_content", SECTION_CONTENT},
+    {"heading", HEADING},
+    {"content", CONTENT},
+    {"marker", MARKER},
+    {"paragraph", PARAGRAPH},
+    {"list", LIST},
+    {"list_item", LIST_ITEM},
+    {"list_item_content", LIST_ITEM_CONTENT},
+    {"term", TERM},
+    {"definition", DEFINITION},
+    {"block_quote", BLOCK_QUOTE},
+    {"block_quote_marker", SKIP},
+    {"div", DIV},
+    {"class_name", CLASS_NAME},
+    {"code_block", CODE_BLOCK},
+    {"language", LANGUAGE},
+    {"code", CODE},
+    {"raw_block", RAW_BLOCK},
+    {"raw_block_info", RAW_BLOCK_INFO},
+    {"thematic_break", THEMATIC_BREAK},
+    {"math", MATH},
+    {"math_marker", MATH_MARKER},
+    {"link_reference_definition", LINK_REFERENCE_DEFINITION},
+    {"link_label", LINK_LABEL},
+    {"link_destination", LINK_DESTINATION},
+    {"block_attribute", BLOCK_ATTRIBUTE},
+    {"inline_attribute", INLINE_ATTRIBUTE},
+    {"args", ARGS},
+    {"class", CLASS},
+    {"identifier", IDENTIFIER},
+    {"key_value", KEY_VALUE},
+    {"key", KEY},
+    {"value", VALUE},
+    {"comment", SKIP},
+    {"inline_comment", SKIP},
+    {"frontmatter", SKIP},
+    {"footnote", FOOTNOTE},
+    {"footnote_content", FOOTNOTE_CONTENT},
+    {"reference_label", REFERENCE_LABEL},
+    {"footnote_reference", FOOTNOTE_REFERENCE},
+    {"table", TABLE},
+    {"table_header", TABLE_HEADER},
+    {"table_row", TABLE_ROW},
+    {"table_separator", TABLE_SEPARATOR},
+    {"table_cell", TABLE_CELL},
+    {"table_cell_alignment", TABLE_CELL_ALIGNMENT},
+    {"table_caption", TABLE_CAPTION},
+    {"list_marker_dash", LIST_MARKER_BULLET},
+    {"list_marker_plus", LIST_MARKER_BULLET},
+    {"list_marker_star", LIST_MARKER_BULLET},
+    {"list_marker_task", LIST_MARKER_TASK},
+    {"list_marker_definition", LIST_MARKER_DEFINITION},
+    {"list_marker_decimal_period", LIST_MARKER_DECIMAL},
+    {"list_marker_decimal_paren", LIST_MARKER_DECIMAL},
+    {"list_marker_decimal_parens", LIST_MARKER_DECIMAL},
+    {"list_marker_lower_alpha_period", LIST_MARKER_LOWER_ALPHA},
+    {"list_marker_lower_alpha_paren", LIST_MARKER_LOWER_ALPHA},
+    {"list_marker_lower_alpha_parens", LIST_MARKER_LOWER_ALPHA},
+    {"list_marker_upper_alpha_period", LIST_MARKER_UPPER_ALPHA},
+    {"list_marker_upper_alpha_paren", LIST_MARKER_UPPER_ALPHA},
+    {"list_marker_upper_alpha_parens", LIST_MARKER_UPPER_ALPHA},
+    {"list_marker_lower_roman_period", LIST_MARKER_LOWER_ROMAN},
+    {"list_marker_lower_roman_paren", LIST_MARKER_LOWER_ROMAN},
+    {"list_marker_lower_roman_parens", LIST_MARKER_LOWER_ROMAN},
+    {"list_marker_upper_roman_period", LIST_MARKER_UPPER_ROMAN},
+    {"list_marker_upper_roman_paren", LIST_MARKER_UPPER_ROMAN},
+    {"list_marker_upper_roman_parens", LIST_MARKER_UPPER_ROMAN},
+    {"checked", CHECKED},
+    {"emphasis", EMPHASIS},
+    {"strong", STRONG},
+    {"highlighted", HIGHLIGHTED},
+    {"superscript", SUPERSCRIPT},
+    {"subscript", SUBSCRIPT},
+    {"insert", INSERT},
+    {"delete", DELETE},
+    {"span", SPAN},
+    {"verbatim", VERBATIM},
+    {"raw_inline", RAW_INLINE},
+    {"raw_inline_attribute", RAW_INLINE_ATTRIBUTE},
+    {"autolink", AUTOLINK},
+    {"backslash_escape", BACKSLASH_ESCAPE},
+    {"hard_line_break", HARD_LINE_BREAK},
+    {"quotation_marks", QUOTATION_MARKS},
+    {"ellipsis", ELLIPSIS},
+    {"em_dash", EM_DASH},
+    {"en_dash", EN_DASH},
+    {"inline_link", INLINE_LINK},
+    {"full_reference_link", FULL_REFERENCE_LINK},
+    {"collapsed_reference_link", COLLAPSED_REFERENCE_LINK},
+    {"inline_image", INLINE_IMAGE},
+    {"full_reference_image", FULL_REFERENCE_IMAGE},
+    {"collapsed_reference_image", COLLAPSED_REFERENCE_IMAGE},
+    {"link_text", LINK_TEXT},
+    {"image_description", IMAGE_DESCRIPTION},
+    {"inline_link_destination", INLINE_LINK_DESTINATION},
+};
+
+typedef struct {
+  // Into `Renderer.labels` while collecting, and then a pointer.
+  union {
+    uint32_t offset;
+    const char *string;
+  } label;
+  uint32_t label_length;
+  // In document order, so the first of several definitions wins.
+  uint32_t index;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  // For footnotes, the number given by the first reference, or 0.
+  uint32_t number;
+  TSNode content;
+} Definition;
+
+typedef struct {
+  uint32_t start_byte;
+  TSNode node;
+} Attribute;
+
+// A footnote in the order of the references.
+typedef struct {
+  // The definition, or NULL for references to undefined footnotes.
+  const Definition *definition;
+} Note;
+
+typedef Array(char) String;
+typedef Array(Definition) Definitions;
+
+typedef struct {
+  const char *source;
+
+  char *output;
+  size_t size;
+  size_t capacity;
+  TSDjotHtmlCallback callback;
+  void *payload;
+  bool stopped;
+  // An allocation failed.
+  bool failed;
+
+  uint8_t *kinds;
+  uint32_t kind_count;
+
+  // For looking ahead of the node being rendered, and for reading
+  // attributes.
+  TSTreeCursor ahead;
+  TSTreeCursor args;
+
+  String labels;
+  String scratch;
+  Definitions references;
+  Definitions footnotes;
+  Array(Note) notes;
+  Array(Attribute) attributes;
+  // Block attributes waiting for the block they apply to.
+  Array(TSNode) pending;
+  Array(uint8_t) alignments;
+
+  // Whether paragraphs are rendered without `<p>`, in tight lists.
+  bool tight;
+  // The paragraph that ends with the backlink of the footnote being
+  // rendered.
+  uint32_t backlink_paragraph;
+  uint32_t backlink_number;
+} Renderer;
+
+static void render_blocks(Renderer *r, TSTreeCursor *c);
+static void render_inline(Renderer *r, TSTreeCursor *c, uint32_t start,
+                          uint32_t end);
+
+// Make room for one more element in `array`, or mark the render as failed.
+// `array_push` would write through a NULL pointer when it can't grow.
+static bool grow(Renderer *r, void *array, size_t element_size) {
+  Array *self = array;
+  if (r->failed) {
+    return false;
+  }
+  if (self->size < self->capacity) {
+    return true;
+  }
+  uint32_t capacity = self->capacity < 8 ? 8 : self->capacity * 2;
+  void *contents = realloc(self->contents, capacity * element_size);
+  if (!contents) {
+    r->failed = true;
+    return false;
+  }
+  self->contents = contents;
+  self->capacity = capacity;
+  return true;
+}
+
+// Push `element` onto `array`, returning false if there was no memory for it.
+#define push(r, array, element)                                                \
+  (grow((r), (array), array_elem_size(array))                                  \
+       ? (array_push((array), (element)), true)                                \
+       : false)
+
+// Output
+
+static void flush(Renderer *r) {
+  if (r->size > 0 && !r->stopped && !r->callback(r->payload, r->output, r->size)) {
+    r->stopped = true;
+  }
+  r->size = 0;
+}
+
+static bool reserve(Renderer *r, size_t length) {
+  if (r->size + length > r->capacity) {
+    if (r->callback && r->size > 0) {
+      flush(r);
+      if (length <= r->capacity) {
+        return true;
+      }
+    }
+    size_t capacity = (r->size + length) * 2;
+    char *output = realloc(r->output, capacity);
+    if (!output) {
+      r->failed = true;
+      return false;
+    }
+    r->output = output;
+    r->capacity = capacity;
+  }
+  return true;
+}
+
+static void emit(Renderer *r, const char *data, size_t length) {
+  if (r->failed || !reserve(r, length)) {
+    return;
+  }
+  memcpy(r->output + r->size, data, length);
+  r->size += length;
+  if (r->callback && r->size >= FLUSH_SIZE) {
+    flush(r);
+  }
+}
+
+#define EMIT(r, literal) emit(r, literal, sizeof(literal) - 1)
+
+static void emit_number(Renderer *r, uint32_t number) {
+  char digits[10];
+  int i = sizeof(digits);
+  do {
+    digits[--i] = (char)('0' + number % 10);
+    number /= 10;
+  } while (number > 0);
+  emit(r, digits + i, sizeof(digits) - i);
+}
+
+// Characters to escape in text, and the ones to escape in attributes too.
+#define ESCAPE_TEXT 1
+#define ESCAPE_ATTRIBUTE 2
+
+static const uint8_t ESCAPES[256] = {
+    ['&'] = ESCAPE_TEXT | ESCAPE_ATTRIBUTE,
+    ['<'] = ESCAPE_TEXT | ESCAPE_ATTRIBUTE,
+    ['>'] = ESCAPE_TEXT | ESCAPE_ATTRIBUTE,
+    ['"'] = ESCAPE_ATTRIBUTE,
+};
+
+static void emit_escaped(Renderer *r, const char *string, size_t length,
+                         uint8_t mask) {
+  size_t run = 0;
+  for (size_t i = 0; i < length; ++i) {
+    char c = string[i];
+    if (!(ESCAPES[(uint8_t)c] & mask)) {
+      continue;
+    }
+    emit(r, string + run, i - run);
+    run = i + 1;
+    switch (c) {
+    case '&':
+      EMIT(r, "&amp;");
+      break;
+    case '<':
+      EMIT(r, "&lt;");
+      break;
+    case '>':
+      EMIT(r, "&gt;");
+      break;
+    default:
+      EMIT(r, "&quot;");
+      break;
+    }
+  }
+  emit(r, string + run, length - run);
+}
+
+static void emit_text(Renderer *r, uint32_t start, uint32_t end) {
+  if (start < end) {
+    emit_escaped(r, r->source + start, end - start, ESCAPE_TEXT);
+  }
+}
+
+static void emit_attribute_text(Renderer *r, uint32_t start, uint32_t end) {
+  if (start < end) {
+    emit_escaped(r, r->source + start, end - start, ESCAPE_ATTRIBUTE);
+  }
+}
+
+// Destinations can be broken over lines, which aren't part of the URL.
+static void emit_url(Renderer *r, uint32_t start, uint32_t end) {
+  uint32_t run = start;
+  for (uint32_t i = start; i < end; ++i) {
+    if (r->source[i] == '\n' || r->source[i] == '\r') {
+      emit_attribute_text(r, run, i);
+      run = i + 1;
+    }
+  }
+  emit_attribute_text(r, run, end);
+}
+
+// Nodes
+
+static Kind kind_of(const Renderer *r, TSNode node) {
+  TSSymbol symbol = ts_node_symbol(node);
+  return symbol < r->kind_count ? (Kind)r->kinds[symbol] : OTHER;
+}
+
+static void build_kinds(Renderer *r, const TSLanguage *language) {
+  r->kind_count = ts_language_symbol_count(language);
+  r->kinds = calloc(r->kind_count, 1);
+  if (!r->kinds) {
+    // Every node is then `OTHER`, and nothing is emitted.
+    r->kind_count = 0;
+    r->failed = true;
+    return;
+  }
+  for (uint32_t symbol = 0; symbol < r->kind_count; ++symbol) {
+    const char *name = ts_language_symbol_name(language, (TSSymbol)symbol);
+    switch (ts_language_symbol_type(language, (TSSymbol)symbol)) {
+    case TSSymbolTypeRegular:
+      for (size_t i = 0; i < sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]); ++i) {
+        if (name[0] == KIND_NAMES[i].name[0] &&
+            strcmp(name, KIND_NAMES[i].name) == 0) {
+          r->kinds[symbol] = KIND_NAMES[i].kind;
+          break;
+        }
+      }
+      break;
+    case TSSymbolTypeAnonymous:
+      // Carriage returns are extras, and not part of the text.
+      r->kinds[symbol] = strcmp(name, "\r") == 0 ? SKIP : TEXT;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static TSNode null_node(void) {
+  TSNode node = {{0}, NULL, NULL};
+  return node;
+}
+
+// Only used on nodes with a handful of children.
+static TSNode child_of_kind(const Renderer *r, TSNode node, Kind kind) {
+  uint32_t count = ts_node_child_count(node);
+  for (uint32_t i = 0; i < count; ++i) {
+    TSNode child = ts_node_child(node, i);
+    if (kind_of(r, child) == kind) {
+      return child;
+    }
+  }
+  return null_node();
+}
+
+static bool source_equals(const Renderer *r, TSNode node, const char *string) {
+  uint32_t start = ts_node_start_byte(node);
+  uint32_t length = ts_node_end_byte(node) - start;
+  return length == strlen(string) &&
+         memcmp(r->source + start, string, length) == 0;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Labels match when they're the same with whitespace collapsed.
+static void normalize_label(Renderer *r, uint32_t start, uint32_t end,
+                            String *result) {
+  bool space = false;
+  for (uint32_t i = start; i < end; ++i) {
+    if (is_space(r->source[i])) {
+      space = result->size > 0;
+      continue;
+    }
+    if ((space && !push(r, result, ' ')) || !push(r, result, r->source[i])) {
+      return;
+    }
+    space = false;
+  }
+}
+
+static int compare_definitions(const void *a, const void *b) {
+  const Definition *x = a, *y = b;
+  uint32_t length =
+      x->label_length < y->label_length ? x->label_length : y->label_length;
+  int order = memcmp(x->label.string, y->label.string, length);
+  if (order != 0) {
+    return order;
+  }
+  if (x->label_length != y->label_length) {
+    return x->label_length < y->label_length ? -1 : 1;
+  }
+  return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static void sort_definitions(Renderer *r, Definitions *array) {
+  for (uint32_t i = 0; i < array->size; ++i) {
+    Definition *d = &array->contents[i];
+    d->label.string = r->labels.contents + d->label.offset;
+  }
+  if (array->size > 1) {
+    qsort(array->contents, array->size, sizeof(Definition),
+          compare_definitions);
+  }
+}
+
+static Definition *find_definition(Definitions *array, const char *label,
+                                   uint32_t length) {
+  Definition key = {.label.string = label, .label_length = length};
+  uint32_t low = 0, high = array->size;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (compare_definitions(&array->contents[mid], &key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  // The key has index 0, so it sorts before all definitions with its label.
+  if (low < array->size) {
+    Definition *d = &array->contents[low];
+    if (d->label_length == length && memcmp(d->label.string, label, length) == 0) {
+      return d;
+    }
+  }
+  return NULL;
+}
+
+static Definition *find_reference(Renderer *r, uint32_t start, uint32_t end) {
+  array_clear(&r->scratch);
+  normalize_label(r, start, end, &r->scratch);
+  return find_definition(&r->references, r->scratch.contents, r->scratch.size);
+}
+
+// Pre-pass
+
+// Returns the new definition, or NULL if there was no memory for it.
+static Definition *collect_definition(Renderer *r, TSNode label,
+                                      Definitions *definitions,
+                                      uint32_t index) {
+  Definition definition = {
+      .label.offset = r->labels.size,
+      .index = index,
+  };
+  normalize_label(r, ts_node_start_byte(label), ts_node_end_byte(label),
+                  &r->labels);
+  definition.label_length = r->labels.size - definition.label.offset;
+  return push(r, definitions, definition) ? array_back(definitions) : NULL;
+}
+
+static bool is_inline_container(Kind kind) {
+  switch (kind) {
+  case PARAGRAPH:
+  case HEADING:
+  case TERM:
+  case TABLE:
+  case TABLE_CAPTION:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void collect(Renderer *r, TSNode root) {
+  TSTreeCursor *c = &r->ahead;
+  ts_tree_cursor_reset(c, root);
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(c);
+    Kind kind = kind_of(r, node);
+    bool descend = true;
+    if (kind == LINK_REFERENCE_DEFINITION) {
+      TSNode label = child_of_kind(r, node, LINK_LABEL);
+      TSNode destination = child_of_kind(r, node, LINK_DESTINATION);
+      Definition *d =
+          ts_node_is_null(label)
+              ? NULL
+              : collect_definition(r, label, &r->references,
+                                   r->references.size);
+      if (d) {
+        if (!ts_node_is_null(destination)) {
+          d->start_byte = ts_node_start_byte(destination);
+          d->end_byte = ts_node_end_byte(destination);
+        }
+      }
+      descend = false;
+    } else if (kind == FOOTNOTE) {
+      TSNode label = child_of_kind(r, node, REFERENCE_LABEL);
+      Definition *d =
+          ts_node_is_null(label)
+              ? NULL
+              : collect_definition(r, label, &r->footnotes, r->footnotes.size);
+      if (d) {
+        d->content = child_of_kind(r, node, FOOTNOTE_CONTENT);
+      }
+    } else if (kind == INLINE_ATTRIBUTE) {
+      Attribute attribute = {ts_node_start_byte(node), node};
+      push(r, &r->attributes, attribute);
+      descend = false;
+    } else if (is_inline_container(kind)) {
+      // Inline attributes start with `{`, so only look for them in text that
+      // has one.
+      uint32_t start = ts_node_start_byte(node);
+      descend =
+          memchr(r->source + start, '{', ts_node_end_byte(node) - start) != NULL;
+    }
+
+    if (descend && ts_tree_cursor_goto_first_child(c)) {
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(c)) {
+      if (!ts_tree_cursor_goto_parent(c)) {
+        sort_definitions(r, &r->references);
+        sort_definitions(r, &r->footnotes);
+        return;
+      }
+    }
+  }
+}
+
+// Attributes
+
+static TSNode find_attribute(const Renderer *r, uint32_t start_byte) {
+  uint32_t low = 0, high = r->attributes.size;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (r->attributes.contents[mid].start_byte < start_byte) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low < r->attributes.size &&
+      r->attributes.contents[low].start_byte == start_byte) {
+    return r->attributes.contents[low].node;
+  }
+  return null_node();
+}
+
+static void emit_slug(Renderer *r, TSNode content) {
+  uint32_t start = ts_node_start_byte(content);
+  uint32_t end = ts_node_end_byte(content);
+  bool separator = false;
+  bool empty = true;
+  for (uint32_t i = start; i < end; ++i) {
+    uint8_t c = (uint8_t)r->source[i];
+    if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') || c == '-' || c >= 0x80) {
+      if (separator && !empty) {
+        EMIT(r, "-");
+      }
+      emit(r, (const char *)&c, 1);
+      separator = false;
+      empty = false;
+    } else {
+      separator = true;
+    }
+  }
+}
+
+// The `args` of an attribute node, iterated with `Renderer.args`.
+static bool goto_args(Renderer *r, TSNode attribute) {
+  TSNode args = child_of_kind(r, attribute, ARGS);
+  if (ts_node_is_null(args)) {
+    return false;
+  }
+  ts_tree_cursor_reset(&r->args, args);
+  return ts_tree_cursor_goto_first_child(&r->args);
+}
+
+// Write the attributes given by `attributes`, along with an id made from
+// `slug` if there is no other, and a class made of `class_prefix` and the
+// source from `class_start` to `class_end`.
+static void emit_attributes(Renderer *r, const TSNode *attributes,
+                            uint32_t count, TSNode slug,
+                            const char *class_prefix, uint32_t class_start,
+                            uint32_t class_end) {
+  TSNode id = null_node();
+  bool has_class = class_prefix != NULL;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!goto_args(r, attributes[i])) {
+      continue;
+    }
+    do {
+      TSNode arg = ts_tree_cursor_current_node(&r->args);
+      Kind kind = kind_of(r, arg);
+      if (kind == IDENTIFIER) {
+        id = arg;
+      } else if (kind == CLASS) {
+        has_class = true;
+      }
+    } while (ts_tree_cursor_goto_next_sibling(&r->args));
+  }
+
+  if (!ts_node_is_null(id)) {
+    EMIT(r, " id=\"");
+    emit_attribute_text(r, ts_node_start_byte(id) + 1, ts_node_end_byte(id));
+    EMIT(r, "\"");
+  } else if (!ts_node_is_null(slug)) {
+    EMIT(r, " id=\"");
+    emit_slug(r, slug);
+    EMIT(r, "\"");
+  }
+
+  if (has_class) {
+    EMIT(r, " class=\"");
+    bool first = true;
+    if (class_prefix) {
+      emit(r, class_prefix, strlen(class_prefix));
+      emit_attribute_text(r, class_start, class_end);
+      first = false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      if (!goto_args(r, attributes[i])) {
+        continue;
+      }
+      do {
+        TSNode arg = ts_tree_cursor_current_node(&r->args);
+        if (kind_of(r, arg) == CLASS) {
+          if (!first) {
+            EMIT(r, " ");
+          }
+          emit_attribute_text(r, ts_node_start_byte(arg) + 1,
+                              ts_node_end_byte(arg));
+          first = false;
+        }
+      } while (ts_tree_cursor_goto_next_sibling(&r->args));
+    }
+    EMIT(r, "\"");
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!goto_args(r, attributes[i])) {
+      continue;
+    }
+    do {
+      TSNode arg = ts_tree_cursor_current_node(&r->args);
+      if (kind_of(r, arg) != KEY_VALUE) {
+        continue;
+      }
+      TSNode key = child_of_kind(r, arg, KEY);
+      TSNode value = child_of_kind(r, arg, VALUE);
+      if (ts_node_is_null(key) || ts_node_is_null(value)) {
+        continue;
+      }
+      uint32_t value_start = ts_node_start_byte(value);
+      uint32_t value_end = ts_node_end_byte(value);
+      if (value_end - value_start >= 2 && r->source[value_start] == '"') {
+        ++value_start;
+        --value_end;
+      }
+      EMIT(r, " ");
+      emit_attribute_text(r, ts_node_start_byte(key), ts_node_end_byte(key));
+      EMIT(r, "=\"");
+      emit_attribute_text(r, value_start, value_end);
+      EMIT(r, "\"");
+    } while (ts_tree_cursor_goto_next_sibling(&r->args));
+  }
+}
+
+// Open a block tag with the block attributes before it.
+static void open_block(Renderer *r, const char *tag, TSNode slug,
+                       const char *class_prefix, uint32_t class_start,
+                       uint32_t class_end) {
+  emit(r, tag, strlen(tag));
+  emit_attributes(r, r->pending.contents, r->pending.size, slug, class_prefix,
+                  class_start, class_end);
+  array_clear(&r->pending);
+  EMIT(r, ">");
+}
+
+// Open an inline tag with the attribute after `node`, if it has one.
+static void open_inline(Renderer *r, const char *tag, TSNode node) {
+  emit(r, tag, strlen(tag));
+  if (r->attributes.size > 0) {
+    TSNode attribute = find_attribute(r, ts_node_end_byte(node));
+    if (!ts_node_is_null(attribute)) {
+      emit_attributes(r, &attribute, 1, null_node(), NULL, 0, 0);
+    }
+  }
+  EMIT(r, ">");
+}
+
+// Inlines
+
+static void render_content(Renderer *r, TSTreeCursor *c, TSNode node) {
+  TSNode content = child_of_kind(r, node, CONTENT);
+  if (ts_node_is_null(content)) {
+    return;
+  }
+  ts_tree_cursor_goto_first_child(c);
+  while (!ts_node_eq(ts_tree_cursor_current_node(c), content)) {
+    ts_tree_cursor_goto_next_sibling(c);
+  }
+  render_inline(r, c, ts_node_start_byte(content), ts_node_end_byte(content));
+  ts_tree_cursor_goto_parent(c);
+}
+
+static void render_tagged(Renderer *r, TSTreeCursor *c, TSNode node,
+                          const char *open, const char *close) {
+  open_inline(r, open, node);
+  render_content(r, c, node);
+  emit(r, close, strlen(close));
+}
+
+// Render the child of kind `kind`, which is text in brackets.
+static void render_bracketed(Renderer *r, TSTreeCursor *c, Kind kind,
+                             uint32_t open_length) {
+  if (!ts_tree_cursor_goto_first_child(c)) {
+    return;
+  }
+  do {
+    TSNode child = ts_tree_cursor_current_node(c);
+    if (kind_of(r, child) == kind) {
+      uint32_t start = ts_node_start_byte(child) + open_length;
+      uint32_t end = ts_node_end_byte(child) - 1;
+      render_inline(r, c, start, end > start ? end : start);
+      break;
+    }
+  } while (ts_tree_cursor_goto_next_sibling(c));
+  ts_tree_cursor_goto_parent(c);
+}
+
+// The destination of a link or an image, as a range of the source.
+static const Definition *link_destination(Renderer *r, TSNode node, Kind kind,
+                                          Definition *inline_destination) {
+  switch (kind) {
+  case INLINE_LINK:
+  case INLINE_IMAGE: {
+    TSNode destination = child_of_kind(r, node, INLINE_LINK_DESTINATION);
+    if (ts_node_is_null(destination)) {
+      return NULL;
+    }
+    // Without the parentheses.
+    inline_destination->start_byte = ts_node_start_byte(destination) + 1;
+    inline_destination->end_byte = ts_node_end_byte(destination) - 1;
+    return inline_destination;
+  }
+  case FULL_REFERENCE_LINK:
+  case FULL_REFERENCE_IMAGE: {
+    TSNode label = child_of_kind(r, node, LINK_LABEL);
+    if (ts_node_is_null(label)) {
+      return NULL;
+    }
+    return find_reference(r, ts_node_start_byte(label), ts_node_end_byte(label));
+  }
+  default: {
+    TSNode text = child_of_kind(
+        r, node, kind == COLLAPSED_REFERENCE_LINK ? LINK_TEXT : IMAGE_DESCRIPTION);
+    if (ts_node_is_null(text)) {
+      return NULL;
+    }
+    uint32_t open_length = kind == COLLAPSED_REFERENCE_LINK ? 1 : 2;
+    return find_reference(r, ts_node_start_byte(text) + open_length,
+                          ts_node_end_byte(text) - 1);
+  }
+  }
+}
+
+static void render_link(Renderer *r, TSTreeCursor *c, TSNode node, Kind kind) {
+  Definition inline_destination = {0};
+  const Definition *destination =
+      link_destination(r, node, kind, &inline_destination);
+  EMIT(r, "<a");
+  if (destination) {
+    EMIT(r, " href=\"");
+    emit_url(r, destination->start_byte, destination->end_byte);
+    EMIT(r, "\"");
+  }
+  open_inline(r, "", node);
+  render_bracketed(r, c, LINK_TEXT, 1);
+  EMIT(r, "</a>");
+}
+
+static void render_image(Renderer *r, TSNode node, Kind kind) {
+  Definition inline_destination = {0};
+  const Definition *destination =
+      link_destination(r, node, kind, &inline_destination);
+  EMIT(r, "<img alt=\"");
+  TSNode description = child_of_kind(r, node, IMAGE_DESCRIPTION);
+  if (!ts_node_is_null(description)) {
+    emit_attribute_text(r, ts_node_start_byte(description) + 2,
+                        ts_node_end_byte(description) - 1);
+  }
+  EMIT(r, "\"");
+  if (destination) {
+    EMIT(r, " src=\"");
+    emit_url(r, destination->start_byte, destination->end_byte);
+    EMIT(r, "\"");
+  }
+  open_inline(r, "", node);
+}
+
+static void render_footnote_reference(Renderer *r, TSNode node) {
+  // A reference without a label, after a parse error, is rendered like one
+  // without a definition.
+  TSNode label = child_of_kind(r, node, REFERENCE_LABEL);
+  Definition *definition = NULL;
+  if (!ts_node_is_null(label)) {
+    uint32_t start = ts_node_start_byte(label);
+    uint32_t length = ts_node_end_byte(label) - start;
+    definition = find_definition(&r->footnotes, r->source + start, length);
+  }
+  uint32_t number = 0;
+  if (definition) {
+    Note note = {definition};
+    if (definition->number == 0 && push(r, &r->notes, note)) {
+      definition->number = r->notes.size;
+    }
+    number = definition->number;
+  } else {
+    Note note = {NULL};
+    push(r, &r->notes, note);
+    number = r->notes.size;
+  }
+  EMIT(r, "<a id=\"fnref");
+  emit_number(r, number);
+  EMIT(r, "\" href=\"#fn");
+  emit_number(r, number);
+  EMIT(r, "\" role=\"doc-noteref\"><sup>");
+  emit_number(r, number);
+  EMIT(r, "</sup></a>");
+}
+
+// The content of verbatim-like nodes, with a space next to a backtick
+// stripped from either end.
+static void render_verbatim(Renderer *r, TSNode node, bool raw) {
+  TSNode content = child_of_kind(r, node, CONTENT);
+  if (ts_node_is_null(content)) {
+    return;
+  }
+  uint32_t start = ts_node_start_byte(content);
+  uint32_t end = ts_node_end_byte(content);
+  if (end - start >= 2 && r->source[start] == ' ' &&
+      r->source[start + 1] == '`') {
+    ++start;
+  }
+  if (end - start >= 2 && r->source[end - 1] == ' ' &&
+      r->source[end - 2] == '`') {
+    --end;
+  }
+  if (raw) {
+    emit(r, r->source + start, end - start);
+  } else {
+    emit_text(r, start, end);
+  }
+}
+
+static void render_math(Renderer *r, TSNode node) {
+  TSNode marker = child_of_kind(r, node, MATH_MARKER);
+  bool display = !ts_node_is_null(marker) &&
+                 ts_node_end_byte(marker) - ts_node_start_byte(marker) == 2;
+  if (display) {
+    EMIT(r, "<span class=\"math display\">\\[");
+    render_verbatim(r, node, false);
+    EMIT(r, "\\]</span>");
+  } else {
+    EMIT(r, "<span class=\"math inline\">\\(");
+    render_verbatim(r, node, false);
+    EMIT(r, "\\)</span>");
+  }
+}
+
+static bool is_html(const Renderer *r, TSNode node, Kind kind) {
+  TSNode info = child_of_kind(r, node, kind);
+  if (ts_node_is_null(info)) {
+    return false;
+  }
+  TSNode language = child_of_kind(r, info, LANGUAGE);
+  return !ts_node_is_null(language) && source_equals(r, language, "html");
+}
+
+static void render_autolink(Renderer *r, TSNode node) {
+  uint32_t start = ts_node_start_byte(node) + 1;
+  uint32_t end = ts_node_end_byte(node) - 1;
+  bool email = memchr(r->source + start, '@', end - start) &&
+               !memchr(r->source + start, ':', end - start);
+  EMIT(r, "<a href=\"");
+  if (email) {
+    EMIT(r, "mailto:");
+  }
+  emit_attribute_text(r, start, end);
+  EMIT(r, "\">");
+  emit_text(r, start, end);
+  EMIT(r, "</a>");
+}
+
+static void render_quotation_mark(Renderer *r, TSNode node) {
+  const char *mark = r->source + ts_node_start_byte(node);
+  if (mark[0] == '\\') {
+    emit_text(r, ts_node_start_byte(node) + 1, ts_node_end_byte(node));
+  } else if (mark[0] == '{' ? mark[1] == '"' : mark[0] == '"') {
+    if (mark[0] == '{') {
+      EMIT(r, "\xE2\x80\x9C");
+    } else {
+      EMIT(r, "\xE2\x80\x9D");
+    }
+  } else if (mark[0] == '{') {
+    EMIT(r, "\xE2\x80\x98");
+  } else {
+    EMIT(r, "\xE2\x80\x99");
+  }
+}
+
+// Render the inline node at the cursor.
+static void render_inline_node(Renderer *r, TSTreeCursor *c, TSNode node,
+                               Kind kind) {
+  uint32_t start = ts_node_start_byte(node);
+  uint32_t end = ts_node_end_byte(node);
+  switch (kind) {
+  case EMPHASIS:
+    render_tagged(r, c, node, "<em", "</em>");
+    break;
+  case STRONG:
+    render_tagged(r, c, node, "<strong", "</strong>");
+    break;
+  case HIGHLIGHTED:
+    render_tagged(r, c, node, "<mark", "</mark>");
+    break;
+  case SUPERSCRIPT:
+    render_tagged(r, c, node, "<sup", "</sup>");
+    break;
+  case SUBSCRIPT:
+    render_tagged(r, c, node, "<sub", "</sub>");
+    break;
+  case INSERT:
+    render_tagged(r, c, node, "<ins", "</ins>");
+    break;
+  case DELETE:
+    render_tagged(r, c, node, "<del", "</del>");
+    break;
+  case SPAN: {
+    TSNode attribute = child_of_kind(r, node, INLINE_ATTRIBUTE);
+    EMIT(r, "<span");
+    if (!ts_node_is_null(attribute)) {
+      emit_attributes(r, &attribute, 1, null_node(), NULL, 0, 0);
+    }
+    EMIT(r, ">");
+    render_content(r, c, node);
+    EMIT(r, "</span>");
+    break;
+  }
+  case VERBATIM:
+    open_inline(r, "<code", node);
+    render_verbatim(r, node, false);
+    EMIT(r, "</code>");
+    break;
+  case MATH:
+    render_math(r, node);
+    break;
+  case RAW_INLINE:
+    if (is_html(r, node, RAW_INLINE_ATTRIBUTE)) {
+      render_verbatim(r, node, true);
+    }
+    break;
+  case AUTOLINK:
+    render_autolink(r, node);
+    break;
+  case BACKSLASH_ESCAPE:
+    if (r->source[start + 1] == ' ') {
+      EMIT(r, "&nbsp;");
+    } else {
+      emit_text(r, start + 1, end);
+    }
+    break;
+  case HARD_LINE_BREAK:
+    EMIT(r, "<br>\n");
+    break;
+  case QUOTATION_MARKS:
+    render_quotation_mark(r, node);
+    break;
+  case ELLIPSIS:
+    EMIT(r, "\xE2\x80\xA6");
+    break;
+  case EM_DASH:
+    EMIT(r, "\xE2\x80\x94");
+    break;
+  case EN_DASH:
+    EMIT(r, "\xE2\x80\x93");
+    break;
+  case FOOTNOTE_REFERENCE:
+    render_footnote_reference(r, node);
+    break;
+  case INLINE_LINK:
+  case FULL_REFERENCE_LINK:
+  case COLLAPSED_REFERENCE_LINK:
+    render_link(r, c, node, kind);
+    break;
+  case INLINE_IMAGE:
+  case FULL_REFERENCE_IMAGE:
+  case COLLAPSED_REFERENCE_IMAGE:
+    render_image(r, node, kind);
+    break;
+  case SKIP:
+  case MARKER:
+  case INLINE_ATTRIBUTE:
+    break;
+  case OTHER:
+    // Errors, and the kinds that are only text.
+    render_inline(r, c, start, end);
+    break;
+  default:
+    emit_text(r, start, end);
+    break;
+  }
+}
+
+// Render the children of the node at the cursor, and the text between them,
+// from `start` to `end`.
+static void render_inline(Renderer *r, TSTreeCursor *c, uint32_t start,
+                          uint32_t end) {
+  uint32_t text_start = start;
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      Kind kind = kind_of(r, child);
+      if (kind == TEXT) {
+        continue;
+      }
+      uint32_t child_start = ts_node_start_byte(child);
+      uint32_t child_end = ts_node_end_byte(child);
+      // Brackets around link text, or the newline after a paragraph.
+      if (child_end <= start || child_start >= end) {
+        continue;
+      }
+      emit_text(r, text_start, child_start);
+      render_inline_node(r, c, child, kind);
+      text_start = child_end;
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  emit_text(r, text_start, end);
+}
+
+// Render the inline content of the node at the cursor without the
+// whitespace around it.
+static void render_trimmed(Renderer *r, TSTreeCursor *c) {
+  TSNode node = ts_tree_cursor_current_node(c);
+  uint32_t start = ts_node_start_byte(node);
+  uint32_t end = ts_node_end_byte(node);
+  while (start < end && is_space(r->source[start])) {
+    ++start;
+  }
+  while (end > start && is_space(r->source[end - 1])) {
+    --end;
+  }
+  render_inline(r, c, start, end);
+}
+
+// Blocks
+
+static void emit_backlink(Renderer *r) {
+  EMIT(r, "<a href=\"#fnref");
+  emit_number(r, r->backlink_number);
+  EMIT(r, "\" role=\"doc-backlink\">\xE2\x86\xA9\xEF\xB8\x8E\xEF\xB8\x8E</a>");
+}
+
+static void render_paragraph(Renderer *r, TSTreeCursor *c, TSNode node) {
+  bool backlink =
+      r->backlink_number > 0 && ts_node_start_byte(node) == r->backlink_paragraph;
+  if (r->tight && !backlink) {
+    array_clear(&r->pending);
+    render_trimmed(r, c);
+    EMIT(r, "\n");
+    return;
+  }
+  open_block(r, "<p", null_node(), NULL, 0, 0);
+  render_trimmed(r, c);
+  if (backlink) {
+    emit_backlink(r);
+    r->backlink_number = 0;
+  }
+  EMIT(r, "</p>\n");
+}
+
+static void render_heading(Renderer *r, TSTreeCursor *c, TSNode node,
+                           bool with_id) {
+  TSNode marker = child_of_kind(r, node, MARKER);
+  TSNode content = child_of_kind(r, node, CONTENT);
+  uint32_t level = 0;
+  if (!ts_node_is_null(marker)) {
+    for (uint32_t i = ts_node_start_byte(marker);
+         i < ts_node_end_byte(marker) && r->source[i] == '#'; ++i) {
+      ++level;
+    }
+  }
+  if (level < 1) {
+    level = 1;
+  } else if (level > 6) {
+    level = 6;
+  }
+  char tag[] = "<h1";
+  tag[2] = (char)('0' + level);
+  if (with_id && !ts_node_is_null(content)) {
+    open_block(r, tag, content, NULL, 0, 0);
+  } else {
+    open_block(r, tag, null_node(), NULL, 0, 0);
+  }
+  if (!ts_node_is_null(content)) {
+    ts_tree_cursor_goto_first_child(c);
+    while (!ts_node_eq(ts_tree_cursor_current_node(c), content)) {
+      ts_tree_cursor_goto_next_sibling(c);
+    }
+    render_trimmed(r, c);
+    ts_tree_cursor_goto_parent(c);
+  }
+  EMIT(r, "</h");
+  emit(r, tag + 2, 1);
+  EMIT(r, ">\n");
+}
+
+static void render_section(Renderer *r, TSTreeCursor *c, TSNode node) {
+  TSNode heading = child_of_kind(r, node, HEADING);
+  TSNode content =
+      ts_node_is_null(heading) ? heading : child_of_kind(r, heading, CONTENT);
+  open_block(r, "<section", content, NULL, 0, 0);
+  EMIT(r, "\n");
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      Kind kind = kind_of(r, child);
+      if (kind == HEADING) {
+        render_heading(r, c, child, false);
+      } else if (kind == SECTION_CONTENT) {
+        render_blocks(r, c);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  EMIT(r, "</section>\n");
+}
+
+static bool has_newline(const Renderer *r, uint32_t start, uint32_t end) {
+  return start < end && memchr(r->source + start, '\n', end - start) != NULL;
+}
+
+// A list is loose if a blank line separates its items, or blocks inside an
+// item. Paragraphs end with their newline, so a newline between two blocks
+// is a blank line.
+static bool is_tight(Renderer *r, TSNode list) {
+  TSTreeCursor *c = &r->ahead;
+  ts_tree_cursor_reset(c, list);
+  if (!ts_tree_cursor_goto_first_child(c)) {
+    return true;
+  }
+  uint32_t previous_end = 0;
+  bool first_item = true;
+  do {
+    TSNode item = ts_tree_cursor_current_node(c);
+    if (kind_of(r, item) != LIST_ITEM) {
+      continue;
+    }
+    if (!first_item &&
+        has_newline(r, previous_end, ts_node_start_byte(item))) {
+      return false;
+    }
+    first_item = false;
+    previous_end = ts_node_end_byte(item);
+    if (!ts_tree_cursor_goto_first_child(c)) {
+      continue;
+    }
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      Kind kind = kind_of(r, child);
+      if ((kind != LIST_ITEM_CONTENT && kind != DEFINITION) ||
+          !ts_tree_cursor_goto_first_child(c)) {
+        continue;
+      }
+      bool first_block = true;
+      do {
+        TSNode block = ts_tree_cursor_current_node(c);
+        if (kind_of(r, block) == SKIP) {
+          continue;
+        }
+        if (!first_block &&
+            has_newline(r, previous_end, ts_node_start_byte(block))) {
+          return false;
+        }
+        first_block = false;
+        previous_end = ts_node_end_byte(block);
+      } while (ts_tree_cursor_goto_next_sibling(c));
+      ts_tree_cursor_goto_parent(c);
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  } while (ts_tree_cursor_goto_next_sibling(c));
+  return true;
+}
+
+// The number of an ordered list marker like `3.`, `(c)` or `iv)`.
+static uint32_t marker_number(const Renderer *r, TSNode marker, Kind kind) {
+  if (ts_node_is_null(marker)) {
+    return 1;
+  }
+  uint32_t start = ts_node_start_byte(marker);
+  uint32_t end = ts_node_end_byte(marker);
+  if (start < end && r->source[start] == '(') {
+    ++start;
+  }
+  uint32_t number = 0;
+  for (uint32_t i = start; i < end; ++i) {
+    char c = r->source[i];
+    if (kind == LIST_MARKER_DECIMAL) {
+      if (c < '0' || c > '9') {
+        break;
+      }
+      number = number * 10 + (uint32_t)(c - '0');
+    } else if (kind == LIST_MARKER_LOWER_ALPHA ||
+               kind == LIST_MARKER_UPPER_ALPHA) {
+      char base = kind == LIST_MARKER_LOWER_ALPHA ? 'a' : 'A';
+      return c >= base && c < base + 26 ? (uint32_t)(c - base) + 1 : 1;
+    } else {
+      static const char DIGITS[] = "ivxlcdm";
+      static const uint32_t VALUES[] = {1, 5, 10, 50, 100, 500, 1000};
+      const char *digit = memchr(DIGITS, c | 0x20, sizeof(DIGITS) - 1);
+      if (!digit) {
+        break;
+      }
+      uint32_t value = VALUES[digit - DIGITS];
+      char next = i + 1 < end ? r->source[i + 1] | 0x20 : 0;
+      const char *next_digit = next ? memchr(DIGITS, next, sizeof(DIGITS) - 1) : NULL;
+      if (next_digit && VALUES[next_digit - DIGITS] > value) {
+        number -= value;
+      } else {
+        number += value;
+      }
+    }
+  }
+  return number;
+}
+
+static void render_list_item(Renderer *r, TSTreeCursor *c, TSNode item,
+                             Kind marker_kind) {
+  if (marker_kind == LIST_MARKER_TASK) {
+    TSNode marker = child_of_kind(r, item, LIST_MARKER_TASK);
+    bool checked = !ts_node_is_null(marker) &&
+                   !ts_node_is_null(child_of_kind(r, marker, CHECKED));
+    if (checked) {
+      EMIT(r, "<li class=\"checked\">\n");
+    } else {
+      EMIT(r, "<li class=\"unchecked\">\n");
+    }
+  } else if (marker_kind != LIST_MARKER_DEFINITION) {
+    EMIT(r, "<li>\n");
+  }
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      switch (kind_of(r, child)) {
+      case LIST_ITEM_CONTENT:
+        render_blocks(r, c);
+        break;
+      case TERM:
+        EMIT(r, "<dt>");
+        render_trimmed(r, c);
+        EMIT(r, "</dt>\n");
+        break;
+      case DEFINITION:
+        EMIT(r, "<dd>\n");
+        render_blocks(r, c);
+        EMIT(r, "</dd>\n");
+        break;
+      default:
+        break;
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  if (marker_kind != LIST_MARKER_DEFINITION) {
+    EMIT(r, "</li>\n");
+  }
+}
+
+static void render_list(Renderer *r, TSTreeCursor *c, TSNode list) {
+  // The marker of the first item decides the kind of list.
+  TSNode marker = null_node();
+  Kind marker_kind = LIST_MARKER_BULLET;
+  TSNode item = child_of_kind(r, list, LIST_ITEM);
+  if (!ts_node_is_null(item)) {
+    uint32_t count = ts_node_child_count(item);
+    for (uint32_t i = 0; i < count; ++i) {
+      TSNode child = ts_node_child(item, i);
+      Kind kind = kind_of(r, child);
+      if (kind >= LIST_MARKER_BULLET && kind <= LIST_MARKER_UPPER_ROMAN) {
+        marker = child;
+        marker_kind = kind;
+        break;
+      }
+    }
+  }
+
+  const char *close;
+  switch (marker_kind) {
+  case LIST_MARKER_BULLET:
+    open_block(r, "<ul", null_node(), NULL, 0, 0);
+    close = "</ul>\n";
+    break;
+  case LIST_MARKER_TASK:
+    open_block(r, "<ul", null_node(), "task-list", 0, 0);
+    close = "</ul>\n";
+    break;
+  case LIST_MARKER_DEFINITION:
+    open_block(r, "<dl", null_node(), NULL, 0, 0);
+    close = "</dl>\n";
+    break;
+  default: {
+    EMIT(r, "<ol");
+    uint32_t start = marker_number(r, marker, marker_kind);
+    if (start != 1) {
+      EMIT(r, " start=\"");
+      emit_number(r, start);
+      EMIT(r, "\"");
+    }
+    switch (marker_kind) {
+    case LIST_MARKER_LOWER_ALPHA:
+      EMIT(r, " type=\"a\"");
+      break;
+    case LIST_MARKER_UPPER_ALPHA:
+      EMIT(r, " type=\"A\"");
+      break;
+    case LIST_MARKER_LOWER_ROMAN:
+      EMIT(r, " type=\"i\"");
+      break;
+    case LIST_MARKER_UPPER_ROMAN:
+      EMIT(r, " type=\"I\"");
+      break;
+    default:
+      break;
+    }
+    open_block(r, "", null_node(), NULL, 0, 0);
+    close = "</ol>\n";
+    break;
+  }
+  }
+  EMIT(r, "\n");
+
+  bool tight = r->tight;
+  r->tight = is_tight(r, list);
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      if (kind_of(r, child) == LIST_ITEM) {
+        render_list_item(r, c, child, marker_kind);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  r->tight = tight;
+  emit(r, close, strlen(close));
+}
+
+static void render_table_row(Renderer *r, TSTreeCursor *c, bool header) {
+  EMIT(r, "<tr>\n");
+  uint32_t column = 0;
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode cell = ts_tree_cursor_current_node(c);
+      if (kind_of(r, cell) != TABLE_CELL) {
+        continue;
+      }
+      if (header) {
+        EMIT(r, "<th");
+      } else {
+        EMIT(r, "<td");
+      }
+      uint8_t alignment =
+          column < r->alignments.size ? r->alignments.contents[column] : 0;
+      if (alignment == 'l') {
+        EMIT(r, " style=\"text-align: left;\"");
+      } else if (alignment == 'r') {
+        EMIT(r, " style=\"text-align: right;\"");
+      } else if (alignment == 'c') {
+        EMIT(r, " style=\"text-align: center;\"");
+      }
+      EMIT(r, ">");
+      render_trimmed(r, c);
+      if (header) {
+        EMIT(r, "</th>\n");
+      } else {
+        EMIT(r, "</td>\n");
+      }
+      ++column;
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  EMIT(r, "</tr>\n");
+}
+
+static void collect_alignments(Renderer *r, TSTreeCursor *c) {
+  array_clear(&r->alignments);
+  if (!ts_tree_cursor_goto_first_child(c)) {
+    return;
+  }
+  do {
+    TSNode cell = ts_tree_cursor_current_node(c);
+    if (kind_of(r, cell) != TABLE_CELL_ALIGNMENT) {
+      continue;
+    }
+    uint32_t start = ts_node_start_byte(cell);
+    uint32_t end = ts_node_end_byte(cell);
+    while (start < end && is_space(r->source[start])) {
+      ++start;
+    }
+    while (end > start && is_space(r->source[end - 1])) {
+      --end;
+    }
+    bool left = start < end && r->source[start] == ':';
+    bool right = start < end && r->source[end - 1] == ':';
+    uint8_t alignment = left && right ? 'c' : left ? 'l' : right ? 'r' : 0;
+    if (!push(r, &r->alignments, alignment)) {
+      break;
+    }
+  } while (ts_tree_cursor_goto_next_sibling(c));
+  ts_tree_cursor_goto_parent(c);
+}
+
+static void render_table(Renderer *r, TSTreeCursor *c, TSNode table) {
+  open_block(r, "<table", null_node(), NULL, 0, 0);
+  EMIT(r, "\n");
+
+  // The caption comes last in the source but first in the output, and the
+  // alignments of the first separator apply to the header above it too.
+  array_clear(&r->alignments);
+  TSTreeCursor *ahead = &r->ahead;
+  ts_tree_cursor_reset(ahead, table);
+  if (ts_tree_cursor_goto_first_child(ahead)) {
+    bool separator = false;
+    do {
+      Kind kind = kind_of(r, ts_tree_cursor_current_node(ahead));
+      if (kind == TABLE_SEPARATOR && !separator) {
+        collect_alignments(r, ahead);
+        separator = true;
+      } else if (kind == TABLE_CAPTION) {
+        EMIT(r, "<caption>");
+        TSNode content =
+            child_of_kind(r, ts_tree_cursor_current_node(ahead), CONTENT);
+        if (!ts_node_is_null(content)) {
+          ts_tree_cursor_goto_first_child(ahead);
+          while (!ts_node_eq(ts_tree_cursor_current_node(ahead), content)) {
+            ts_tree_cursor_goto_next_sibling(ahead);
+          }
+          render_trimmed(r, ahead);
+          ts_tree_cursor_goto_parent(ahead);
+        }
+        EMIT(r, "</caption>\n");
+      }
+    } while (ts_tree_cursor_goto_next_sibling(ahead));
+  }
+
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      Kind kind = kind_of(r, ts_tree_cursor_current_node(c));
+      if (kind == TABLE_HEADER || kind == TABLE_ROW) {
+        render_table_row(r, c, kind == TABLE_HEADER);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  EMIT(r, "</table>\n");
+}
+
+// Write the text of a code block or raw block, without the block quote
+// markers in it.
+static void render_code(Renderer *r, TSTreeCursor *c, bool raw) {
+  TSNode code = ts_tree_cursor_current_node(c);
+  uint32_t start = ts_node_start_byte(code);
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(c);
+      if (kind_of(r, child) == TEXT) {
+        continue;
+      }
+      if (raw) {
+        emit(r, r->source + start, ts_node_start_byte(child) - start);
+      } else {
+        emit_text(r, start, ts_node_start_byte(child));
+      }
+      start = ts_node_end_byte(child);
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  uint32_t end = ts_node_end_byte(code);
+  if (raw) {
+    emit(r, r->source + start, end > start ? end - start : 0);
+  } else {
+    emit_text(r, start, end);
+  }
+}
+
+static void render_code_block(Renderer *r, TSTreeCursor *c, TSNode node) {
+  TSNode language = child_of_kind(r, node, LANGUAGE);
+  EMIT(r, "<pre");
+  if (ts_node_is_null(language)) {
+    open_block(r, "", null_node(), NULL, 0, 0);
+    EMIT(r, "<code>");
+  } else {
+    open_block(r, "", null_node(), NULL, 0, 0);
+    EMIT(r, "<code class=\"language-");
+    emit_attribute_text(r, ts_node_start_byte(language),
+                        ts_node_end_byte(language));
+    EMIT(r, "\">");
+  }
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      if (kind_of(r, ts_tree_cursor_current_node(c)) == CODE) {
+        render_code(r, c, false);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  EMIT(r, "</code></pre>\n");
+}
+
+static void render_raw_block(Renderer *r, TSTreeCursor *c, TSNode node) {
+  array_clear(&r->pending);
+  if (!is_html(r, node, RAW_BLOCK_INFO) || !ts_tree_cursor_goto_first_child(c)) {
+    return;
+  }
+  do {
+    if (kind_of(r, ts_tree_cursor_current_node(c)) == CONTENT) {
+      render_code(r, c, true);
+    }
+  } while (ts_tree_cursor_goto_next_sibling(c));
+  ts_tree_cursor_goto_parent(c);
+}
+
+static void render_div(Renderer *r, TSTreeCursor *c, TSNode node) {
+  TSNode class_name = child_of_kind(r, node, CLASS_NAME);
+  if (ts_node_is_null(class_name)) {
+    open_block(r, "<div", null_node(), NULL, 0, 0);
+  } else {
+    open_block(r, "<div", null_node(), "", ts_node_start_byte(class_name),
+               ts_node_end_byte(class_name));
+  }
+  EMIT(r, "\n");
+  bool tight = r->tight;
+  r->tight = false;
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      if (kind_of(r, ts_tree_cursor_current_node(c)) == CONTENT) {
+        render_blocks(r, c);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  r->tight = tight;
+  EMIT(r, "</div>\n");
+}
+
+static void render_block_quote(Renderer *r, TSTreeCursor *c) {
+  open_block(r, "<blockquote", null_node(), NULL, 0, 0);
+  EMIT(r, "\n");
+  bool tight = r->tight;
+  r->tight = false;
+  if (ts_tree_cursor_goto_first_child(c)) {
+    do {
+      if (kind_of(r, ts_tree_cursor_current_node(c)) == CONTENT) {
+        render_blocks(r, c);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(c));
+    ts_tree_cursor_goto_parent(c);
+  }
+  r->tight = tight;
+  EMIT(r, "</blockquote>\n");
+}
+
+// Render the block at the cursor.
+static void render_block(Renderer *r, TSTreeCursor *c) {
+  TSNode node = ts_tree_cursor_current_node(c);
+  Kind kind = kind_of(r, node);
+  switch (kind) {
+  case PARAGRAPH:
+    render_paragraph(r, c, node);
+    break;
+  case SECTION:
+    render_section(r, c, node);
+    break;
+  case HEADING:
+    render_heading(r, c, node, true);
+    break;
+  case LIST:
+    render_list(r, c, node);
+    break;
+  case BLOCK_QUOTE:
+    render_block_quote(r, c);
+    break;
+  case DIV:
+    render_div(r, c, node);
+    break;
+  case CODE_BLOCK:
+    render_code_block(r, c, node);
+    break;
+  case RAW_BLOCK:
+    render_raw_block(r, c, node);
+    break;
+  case THEMATIC_BREAK:
+    open_block(r, "<hr", null_node(), NULL, 0, 0);
+    EMIT(r, "\n");
+    break;
+  case MATH:
+    open_block(r, "<p", null_node(), NULL, 0, 0);
+    render_math(r, node);
+    EMIT(r, "</p>\n");
+    break;
+  case TABLE:
+    render_table(r, c, node);
+    break;
+  case BLOCK_ATTRIBUTE:
+    push(r, &r->pending, node);
+    break;
+  case SKIP:
+    break;
+  case OTHER:
+    // Errors, which can contain blocks.
+    render_blocks(r, c);
+    break;
+  default:
+    // Link reference definitions and footnotes, which were collected.
+    array_clear(&r->pending);
+    break;
+  }
+}
+
+// Render the children of the node at the cursor as blocks.
+static void render_blocks(Renderer *r, TSTreeCursor *c) {
+  if (!ts_tree_cursor_goto_first_child(c)) {
+    return;
+  }
+  do {
+    render_block(r, c);
+  } while (!r->stopped && ts_tree_cursor_goto_next_sibling(c));
+  ts_tree_cursor_goto_parent(c);
+}
+
+static void render_footnotes(Renderer *r, TSTreeCursor *c) {
+  if (r->notes.size == 0) {
+    return;
+  }
+  r->tight = false;
+  EMIT(r, "<section role=\"doc-endnotes\">\n<hr>\n<ol>\n");
+  // Footnotes can refer to more footnotes, which are added to the end.
+  for (uint32_t i = 0; i < r->notes.size && !r->stopped; ++i) {
+    const Definition *definition = r->notes.contents[i].definition;
+    EMIT(r, "<li id=\"fn");
+    emit_number(r, i + 1);
+    EMIT(r, "\">\n");
+
+    r->backlink_number = i + 1;
+    r->backlink_paragraph = UINT32_MAX;
+    if (definition && !ts_node_is_null(definition->content)) {
+      // The backlink goes into the last paragraph, if the footnote ends with
+      // one.
+      TSNode last = null_node();
+      ts_tree_cursor_reset(&r->ahead, definition->content);
+      if (ts_tree_cursor_goto_first_child(&r->ahead)) {
+        do {
+          TSNode child = ts_tree_cursor_current_node(&r->ahead);
+          if (kind_of(r, child) != SKIP) {
+            last = child;
+          }
+        } while (ts_tree_cursor_goto_next_sibling(&r->ahead));
+      }
+      if (!ts_node_is_null(last) && kind_of(r, last) == PARAGRAPH) {
+        r->backlink_paragraph = ts_node_start_byte(last);
+      }
+      array_clear(&r->pending);
+      ts_tree_cursor_reset(c, definition->content);
+      render_blocks(r, c);
+    }
+    if (r->backlink_number > 0) {
+      EMIT(r, "<p>");
+      emit_backlink(r);
+      r->backlink_number = 0;
+      EMIT(r, "</p>\n");
+    }
+    EMIT(r, "</li>\n");
+  }
+  EMIT(r, "</ol>\n</section>\n");
+}
+
+static void render(Renderer *r, const TSTree *tree) {
+  TSNode root = ts_tree_root_node(tree);
+  build_kinds(r, ts_tree_language(tree));
+  r->ahead = ts_tree_cursor_new(root);
+  r->args = ts_tree_cursor_new(root);
+  collect(r, root);
+
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  render_blocks(r, &cursor);
+  render_footnotes(r, &cursor);
+  ts_tree_cursor_delete(&cursor);
+
+  ts_tree_cursor_delete(&r->ahead);
+  ts_tree_cursor_delete(&r->args);
+  free(r->kinds);
+  array_delete(&r->labels);
+  array_delete(&r->scratch);
+  array_delete(&r->references);
+  array_delete(&r->footnotes);
+  array_delete(&r->notes);
+  array_delete(&r->attributes);
+  array_delete(&r->pending);
+  array_delete(&r->alignments);
+}
+
+bool tree_sitter_djot_render_html(const TSTree *tree, const char *source,
+                                  uint32_t length, TSDjotHtmlCallback callback,
+                                  void *payload) {
+  if (ts_node_end_byte(ts_tree_root_node(tree)) > length) {
+    return false;
+  }
+  Renderer r = {
+      .source = source,
+      .capacity = FLUSH_SIZE * 2,
+      .callback = callback,
+      .payload = payload,
+  };
+  r.output = malloc(r.capacity);
+  r.failed = !r.output;
+  if (r.output) {
+    render(&r, tree);
+    flush(&r);
+    free(r.output);
+  }
+  if (r.failed) {
+    errno = ENOMEM;
+  }
+  return !r.stopped && !r.failed;
+}
+
+char *tree_sitter_djot_html(const TSTree *tree, const char *source,
+                            uint32_t length, size_t *html_length) {
+  if (ts_node_end_byte(ts_tree_root_node(tree)) > length) {
+    return NULL;
+  }
+  // HTML is usually a bit larger than its source.
+  Renderer r = {
+      .source = source,
+      .capacity = (size_t)length + length / 4 + 64,
+  };
+  r.output = malloc(r.capacity);
+  r.failed = !r.output;
+  if (r.output) {
+    render(&r, tree);
+    EMIT(&r, "\0");
+  }
+  if (r.failed) {
+    free(r.output);
+    errno = ENOMEM;
+    return NULL;
+  }
+  *html_length = r.size - 1;
+  return r.output;
+}
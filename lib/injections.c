@@ -0,0 +1,225 @@
+#include "edits.h"
+#include "results.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Finds the same injections as `queries/injections.scm`, without a query and
+// without parsing them. Only the nodes that touch the requested range are
+// visited, and the blocks that hold injections aren't looked inside.
+
+typedef enum {
+  NONE,
+  CODE_BLOCK,
+  RAW_BLOCK,
+  RAW_INLINE,
+  MATH,
+  FRONTMATTER,
+  COMMENT,
+} Kind;
+
+typedef struct {
+  const char *name;
+  Kind kind;
+} KindName;
+
+static const KindName KIND_NAMES[] = {
+    {"code_block", CODE_BLOCK}, {"raw_block", RAW_BLOCK},
+    {"raw_inline", RAW_INLINE}, {"math", MATH},
+    {"frontmatter", FRONTMATTER}, {"comment", COMMENT},
+};
+
+typedef struct {
+  const char *source;
+  // The kind of every symbol, as math and comments are aliases of several.
+  uint8_t *kinds;
+  uint32_t kind_count;
+  TSFieldId language_field;
+  TSFieldId content_field;
+  TSFieldId code_field;
+  TSFieldId info_field;
+  TSFieldId attribute_field;
+
+  Array(TSDjotInjection) injections;
+} Collector;
+
+// Returns false if there's no memory for the kinds.
+static bool build_kinds(Collector *c, const TSLanguage *language) {
+  c->kind_count = ts_language_symbol_count(language);
+  c->kinds = calloc(c->kind_count, 1);
+  if (!c->kinds) {
+    return false;
+  }
+  for (uint32_t symbol = 0; symbol < c->kind_count; ++symbol) {
+    if (ts_language_symbol_type(language, (TSSymbol)symbol) !=
+        TSSymbolTypeRegular) {
+      continue;
+    }
+    const char *name = ts_language_symbol_name(language, (TSSymbol)symbol);
+    for (size_t i = 0; i < sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]); ++i) {
+      if (strcmp(name, KIND_NAMES[i].name) == 0) {
+        c->kinds[symbol] = KIND_NAMES[i].kind;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+static TSFieldId field(const TSLanguage *language, const char *name) {
+  return ts_language_field_id_for_name(language, name, strlen(name));
+}
+
+static void add_injection(Collector *c, TSNode content, const char *language,
+                          uint32_t language_length) {
+  if (ts_node_is_null(content)) {
+    return;
+  }
+  TSDjotInjection injection = {
+      .language = language,
+      .language_length = language_length,
+      .start_byte = ts_node_start_byte(content),
+      .end_byte = ts_node_end_byte(content),
+      .start_point = ts_node_start_point(content),
+      .end_point = ts_node_end_point(content),
+  };
+  array_push(&c->injections, injection);
+}
+
+// Add the injection of `content` in the language written at `language`, if
+// both are there.
+static void add_from_source(Collector *c, TSNode content, TSNode language) {
+  if (ts_node_is_null(language)) {
+    return;
+  }
+  uint32_t start = ts_node_start_byte(language);
+  add_injection(c, content, c->source + start,
+                ts_node_end_byte(language) - start);
+}
+
+// Returns false if `node` can't hold injections.
+static bool add_node(Collector *c, TSNode node, Kind kind) {
+  switch (kind) {
+  case CODE_BLOCK:
+    add_from_source(c, ts_node_child_by_field_id(node, c->code_field),
+                    ts_node_child_by_field_id(node, c->language_field));
+    return false;
+  case RAW_BLOCK: {
+    TSNode info = ts_node_child_by_field_id(node, c->info_field);
+    add_from_source(c, ts_node_child_by_field_id(node, c->content_field),
+                    ts_node_child_by_field_id(info, c->language_field));
+    return false;
+  }
+  case RAW_INLINE: {
+    TSNode attribute = ts_node_child_by_field_id(node, c->attribute_field);
+    add_from_source(c, ts_node_child_by_field_id(node, c->content_field),
+                    ts_node_child_by_field_id(attribute, c->language_field));
+    return false;
+  }
+  case MATH:
+    add_injection(c, ts_node_child_by_field_id(node, c->content_field),
+                  "latex", 5);
+    return false;
+  case FRONTMATTER:
+    add_from_source(c, ts_node_child_by_field_id(node, c->content_field),
+                    ts_node_child_by_field_id(node, c->language_field));
+    return false;
+  case COMMENT:
+    add_injection(c, node, "comment", 7);
+    return false;
+  default:
+    return ts_node_child_count(node) > 0;
+  }
+}
+
+static bool visit(void *payload, TSNode node) {
+  Collector *c = payload;
+  TSSymbol symbol = ts_node_symbol(node);
+  return add_node(c, node, symbol < c->kind_count ? (Kind)c->kinds[symbol]
+                                                  : NONE);
+}
+
+static uint32_t hash_bytes(uint32_t hash, const char *bytes, uint32_t length) {
+  for (uint32_t i = 0; i < length; ++i) {
+    hash = (hash ^ (uint8_t)bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static bool same_injection(const char *source, const TSDjotInjection *a,
+                           const TSDjotInjection *b) {
+  uint32_t length = a->end_byte - a->start_byte;
+  return a->hash == b->hash && a->language_length == b->language_length &&
+         b->end_byte - b->start_byte == length &&
+         memcmp(a->language, b->language, a->language_length) == 0 &&
+         memcmp(source + a->start_byte, source + b->start_byte, length) == 0;
+}
+
+// Hash every injection, and point it to the first one with the same language
+// and content with an open-addressing table. Without memory for the table,
+// every injection is the first one.
+static void find_duplicates(const char *source, TSDjotInjection *injections,
+                            uint32_t count) {
+  uint32_t slot_count = 1;
+  while (slot_count < 2 * count) {
+    slot_count *= 2;
+  }
+  // Indices into `injections` plus one, or 0 for empty slots.
+  uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+  for (uint32_t i = 0; i < count; ++i) {
+    TSDjotInjection *injection = &injections[i];
+    uint32_t hash = hash_bytes(2166136261u, injection->language,
+                               injection->language_length);
+    hash = hash_bytes(hash, source + injection->start_byte,
+                      injection->end_byte - injection->start_byte);
+    injection->hash = hash;
+    injection->first = i;
+    if (!slots) {
+      continue;
+    }
+
+    uint32_t slot = hash & (slot_count - 1);
+    while (slots[slot] != 0) {
+      const TSDjotInjection *other = &injections[slots[slot] - 1];
+      if (same_injection(source, injection, other)) {
+        injection->first = slots[slot] - 1;
+        break;
+      }
+      slot = (slot + 1) & (slot_count - 1);
+    }
+    if (slots[slot] == 0) {
+      slots[slot] = i + 1;
+    }
+  }
+  free(slots);
+}
+
+TSDjotInjection *tree_sitter_djot_injections(const TSTree *tree,
+                                             const char *source,
+                                             uint32_t start_byte,
+                                             uint32_t end_byte,
+                                             uint32_t *count) {
+  const TSLanguage *language = ts_tree_language(tree);
+  Collector c = {
+      .source = source,
+      .language_field = field(language, "language"),
+      .content_field = field(language, "content"),
+      .code_field = field(language, "code"),
+      .info_field = field(language, "info"),
+      .attribute_field = field(language, "attribute"),
+  };
+  array_init(&c.injections);
+  if (!build_kinds(&c, language)) {
+    errno = ENOMEM;
+    *count = 0;
+    return NULL;
+  }
+
+  EditRange range = {start_byte, end_byte};
+  edit_walk(ts_tree_root_node(tree), &range, visit, &c);
+  free(c.kinds);
+
+  find_duplicates(source, c.injections.contents, c.injections.size);
+  *count = c.injections.size;
+  return array_release(&c.injections);
+}
@@ -0,0 +1,166 @@
+#include "lines.h"
+#include "results.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define HAS_SSE2
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define HAS_AVX2
+#endif
+#endif
+
+// Lines are found from their newlines, which are searched for a batch of
+// bytes at a time. Every block of 64 bytes in the batch is turned into a mask
+// with a bit for every newline, and the offsets of the set bits are written
+// out without branching on the content, so the lines can then be walked as
+// fast as the offsets can be read.
+//
+// Building the masks is the only part that looks at every byte, and it's
+// vectorized with AVX2 or SSE2 when available. Elsewhere, and for the bytes
+// after the last full block of the buffer, `memchr` finds the newlines, so
+// nothing past the end is read.
+
+#define BLOCK_SIZE 64
+
+// The bytes that can start a block at the start of a line.
+static const bool MARKERS[256] = {
+    ['#'] = true, ['>'] = true, ['|'] = true, ['`'] = true, [':'] = true,
+    ['-'] = true, ['*'] = true, ['+'] = true, ['['] = true, ['0'] = true,
+    ['1'] = true, ['2'] = true, ['3'] = true, ['4'] = true, ['5'] = true,
+    ['6'] = true, ['7'] = true, ['8'] = true, ['9'] = true,
+};
+
+// Write the offsets four at a time, so the loop only mispredicts when a block
+// has more newlines than usual. The writes past the last one land in the
+// slack at the end of `newlines`.
+static inline uint32_t flatten(uint64_t mask, uint32_t offset,
+                               uint32_t *newlines) {
+  uint32_t count = (uint32_t)__builtin_popcountll(mask);
+  while (mask) {
+    for (int i = 0; i < 4; ++i) {
+      // The top bit keeps the count of trailing zeros defined.
+      newlines[i] = offset + (uint32_t)__builtin_ctzll(mask | 1ULL << 63);
+      mask &= mask - 1;
+    }
+    newlines += 4;
+  }
+  return count;
+}
+
+// The newlines between `start` and `end` with `memchr`, for the bytes after
+// the last full block and for platforms without SIMD.
+static uint32_t search_portable(const char *string, uint32_t start,
+                                uint32_t end, uint32_t *newlines) {
+  uint32_t count = 0;
+  const char *p = string + start;
+  while (p < string + end &&
+         (p = memchr(p, '\n', (size_t)(string + end - p)))) {
+    newlines[count++] = (uint32_t)(p - string);
+    ++p;
+  }
+  return count;
+}
+
+#ifdef HAS_SSE2
+static uint32_t scan_block_sse2(const char *block, uint32_t offset,
+                                uint32_t *newlines) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOCK_SIZE; i += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(block + i));
+    mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(bytes, newline))
+            << i;
+  }
+  return flatten(mask, offset, newlines);
+}
+#endif
+
+#ifdef HAS_AVX2
+__attribute__((target("avx2"))) static uint32_t
+scan_block_avx2(const char *block, uint32_t offset, uint32_t *newlines) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOCK_SIZE; i += 32) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + i));
+    mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(bytes, newline))
+            << i;
+  }
+  return flatten(mask, offset, newlines);
+}
+#endif
+
+static LineScanBlock select_scan_block(void) {
+#ifdef HAS_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_block_avx2;
+  }
+#endif
+#ifdef HAS_SSE2
+  return scan_block_sse2;
+#else
+  return NULL;
+#endif
+}
+
+void line_scanner_init(LineScanner *s, const char *string, uint32_t length,
+                       uint32_t position) {
+  s->string = string;
+  s->length = length;
+  s->position = position;
+  s->searched = position;
+  s->newline_count = 0;
+  s->next_newline = 0;
+  s->scan_block = select_scan_block();
+}
+
+bool line_scanner_search(LineScanner *s) {
+  if (s->searched >= s->length) {
+    return false;
+  }
+  uint32_t end = s->length - s->searched > LINE_BATCH_SIZE
+                     ? s->searched + LINE_BATCH_SIZE
+                     : s->length;
+  uint32_t count = 0;
+  uint32_t offset = s->searched;
+  if (s->scan_block) {
+    for (; offset + BLOCK_SIZE <= end; offset += BLOCK_SIZE) {
+      count += s->scan_block(s->string + offset, offset, s->newlines + count);
+    }
+  }
+  count += search_portable(s->string, offset, end, s->newlines + count);
+  s->searched = end;
+  s->newline_count = count;
+  s->next_newline = 0;
+  return true;
+}
+
+TSDjotLine *tree_sitter_djot_lines(const char *string, uint32_t length,
+                                   uint32_t *count) {
+  Array(TSDjotLine) lines = array_new();
+  // Most lines are longer than 32 bytes.
+  array_reserve(&lines, length / 32 + 1);
+
+  LineScanner s;
+  line_scanner_init(&s, string, length, 0);
+  ScannedLine scanned;
+  while (line_scanner_next(&s, &scanned)) {
+    uint32_t indent = scanned.content - scanned.start;
+    TSDjotLine line = {
+        .start_byte = scanned.start,
+        .indent = indent > UINT16_MAX ? UINT16_MAX : (uint16_t)indent,
+        .kind = TSDjotLineBlank,
+    };
+    if (scanned.content < scanned.end) {
+      line.first = string[scanned.content];
+      line.kind =
+          MARKERS[(uint8_t)line.first] ? TSDjotLineMarker : TSDjotLineText;
+    }
+    array_push(&lines, line);
+  }
+
+  *count = lines.size;
+  return array_release(&lines);
+}
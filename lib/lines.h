@@ -0,0 +1,76 @@
+#ifndef TREE_SITTER_DJOT_LINES_H_
+#define TREE_SITTER_DJOT_LINES_H_
+
+// Shared by the helpers that scan a document line by line without parsing
+// it, like the split points and the streaming parse.
+
+#include "tree-sitter-djot-utils.h"
+
+// The newlines are searched for this many bytes at a time.
+#define LINE_BATCH_SIZE 1024
+
+// Writes the offsets of the newlines in the 64 bytes at `block`, plus
+// `offset`, to `newlines`, and returns how many there are.
+typedef uint32_t (*LineScanBlock)(const char *block, uint32_t offset,
+                                  uint32_t *newlines);
+
+// Finds the lines of a buffer a batch at a time, so it reads every byte once
+// and doesn't allocate.
+typedef struct {
+  const char *string;
+  uint32_t length;
+  // The start of the next line.
+  uint32_t position;
+  // The end of the bytes searched for newlines.
+  uint32_t searched;
+  // The newlines found in the last batch, and the next one to use, with room
+  // for the writes past the end of the last block.
+  uint32_t newlines[LINE_BATCH_SIZE + 4];
+  uint32_t newline_count;
+  uint32_t next_newline;
+  // NULL to search with `memchr`.
+  LineScanBlock scan_block;
+} LineScanner;
+
+typedef struct {
+  uint32_t start;
+  // The first byte that isn't whitespace, or `end` for blank lines.
+  uint32_t content;
+  // The newline, or the end of the buffer for a last line without one.
+  uint32_t end;
+} ScannedLine;
+
+// Scan the lines of `string` from `position`, which must be the start of a
+// line. The scanner keeps pointers into `string`, so start a new one when the
+// buffer changes.
+void line_scanner_init(LineScanner *s, const char *string, uint32_t length,
+                       uint32_t position);
+
+// Find the newlines in the next batch. Returns false at the end of the
+// buffer.
+bool line_scanner_search(LineScanner *s);
+
+// Find the next line, or return false at the end of the buffer.
+static inline bool line_scanner_next(LineScanner *s, ScannedLine *line) {
+  if (s->position >= s->length) {
+    return false;
+  }
+  while (s->next_newline == s->newline_count && line_scanner_search(s)) {
+  }
+  line->start = s->position;
+  line->end = s->next_newline < s->newline_count
+                  ? s->newlines[s->next_newline++]
+                  : s->length;
+  // Most lines aren't indented.
+  uint32_t content = line->start;
+  while (content < line->end &&
+         (s->string[content] == ' ' || s->string[content] == '\t' ||
+          s->string[content] == '\r')) {
+    ++content;
+  }
+  line->content = content;
+  s->position = line->end + 1;
+  return true;
+}
+
+#endif // TREE_SITTER_DJOT_LINES_H_
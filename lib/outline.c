@@ -0,0 +1,169 @@
+#include "edits.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// The outline is read from the sections, which only exist on the top level
+// and inside other sections. The walk descends into sections and their
+// content and steps over every other block without looking inside it, so it
+// visits a few nodes per heading, however long the sections are.
+//
+// Updates work like for the reference index: edits shift the headings after
+// them, and an update walks only the sections that touch the changed ranges
+// again. Those are the sections around a change, whose ends may have moved,
+// and the sections inside it.
+
+typedef Array(TSDjotHeading) Headings;
+
+struct TSDjotOutline {
+  TSSymbol section;
+  TSSymbol section_content;
+  TSFieldId heading_field;
+  TSFieldId marker_field;
+  TSFieldId content_field;
+
+  Headings headings;
+  EditTracker tracker;
+
+  // Reused by updates.
+  Headings added;
+  Headings spare;
+};
+
+typedef struct {
+  const TSDjotOutline *self;
+  const char *source;
+  Headings *result;
+} Collector;
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void add_heading(const TSDjotOutline *self, TSNode section,
+                        const char *source, Headings *result) {
+  TSNode heading = ts_node_child_by_field_id(section, self->heading_field);
+  TSNode marker = ts_node_child_by_field_id(heading, self->marker_field);
+  TSNode content = ts_node_child_by_field_id(heading, self->content_field);
+  if (ts_node_is_null(marker) || ts_node_is_null(content)) {
+    return;
+  }
+
+  uint32_t level = 0;
+  uint32_t marker_end = ts_node_end_byte(marker);
+  for (uint32_t i = ts_node_start_byte(marker);
+       i < marker_end && source[i] == '#'; ++i) {
+    ++level;
+  }
+  uint32_t title_start = ts_node_start_byte(content);
+  uint32_t title_end = ts_node_end_byte(content);
+  while (title_end > title_start && is_space(source[title_end - 1])) {
+    --title_end;
+  }
+  TSDjotHeading result_heading = {
+      .level = level,
+      .start_byte = ts_node_start_byte(heading),
+      .end_byte = ts_node_end_byte(heading),
+      .title_start_byte = title_start,
+      .title_end_byte = title_end,
+      .section_end_byte = ts_node_end_byte(section),
+  };
+  array_push(result, result_heading);
+}
+
+static bool visit(void *payload, TSNode node) {
+  Collector *c = payload;
+  TSSymbol symbol = ts_node_symbol(node);
+  if (symbol == c->self->section) {
+    add_heading(c->self, node, c->source, c->result);
+    return true;
+  }
+  return symbol == c->self->section_content;
+}
+
+// Collect the headings of the sections that touch `range`, in document order.
+static void collect(const TSDjotOutline *self, TSNode root,
+                    const EditRange *range, const char *source,
+                    Headings *result) {
+  Collector c = {self, source, result};
+  edit_walk(root, range, visit, &c);
+}
+
+static int compare_headings(const void *a, const void *b) {
+  const TSDjotHeading *x = a, *y = b;
+  return x->start_byte < y->start_byte ? -1 : x->start_byte > y->start_byte;
+}
+
+TSDjotOutline *tree_sitter_djot_outline_new(const TSTree *tree,
+                                            const char *source) {
+  const TSLanguage *language = ts_tree_language(tree);
+  TSDjotOutline *self = calloc(1, sizeof(TSDjotOutline));
+  if (!self) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  edit_tracker_init(&self->tracker, sizeof(TSDjotHeading),
+                    offsetof(TSDjotHeading, start_byte),
+                    offsetof(TSDjotHeading, section_end_byte),
+                    compare_headings);
+  self->section = edit_symbol(language, "section");
+  self->section_content = edit_symbol(language, "section_content");
+  self->heading_field = ts_language_field_id_for_name(language, "heading", 7);
+  self->marker_field = ts_language_field_id_for_name(language, "marker", 6);
+  self->content_field = ts_language_field_id_for_name(language, "content", 7);
+
+  TSNode root = ts_tree_root_node(tree);
+  EditRange everything = {0, ts_node_end_byte(root)};
+  collect(self, root, &everything, source, &self->headings);
+  return self;
+}
+
+void tree_sitter_djot_outline_delete(TSDjotOutline *self) {
+  array_delete(&self->headings);
+  edit_tracker_delete(&self->tracker);
+  array_delete(&self->added);
+  array_delete(&self->spare);
+  free(self);
+}
+
+const TSDjotHeading *tree_sitter_djot_outline_headings(const TSDjotOutline *self,
+                                                       uint32_t *count) {
+  *count = self->headings.size;
+  return self->headings.contents;
+}
+
+void tree_sitter_djot_outline_edit(TSDjotOutline *self,
+                                   const TSInputEdit *edit) {
+  // Sections that touched the edit still touch its range once they're
+  // shifted, so the update finds them.
+  for (uint32_t i = 0; i < self->headings.size; ++i) {
+    TSDjotHeading *heading = &self->headings.contents[i];
+    if (heading->section_end_byte >= edit->start_byte) {
+      heading->start_byte = edit_shift(heading->start_byte, edit);
+      heading->end_byte = edit_shift(heading->end_byte, edit);
+      heading->title_start_byte = edit_shift(heading->title_start_byte, edit);
+      heading->title_end_byte = edit_shift(heading->title_end_byte, edit);
+      heading->section_end_byte = edit_shift(heading->section_end_byte, edit);
+    }
+  }
+  edit_ranges_add_edit(&self->tracker.edits, edit);
+}
+
+void tree_sitter_djot_outline_update(TSDjotOutline *self,
+                                     const TSTree *old_tree,
+                                     const TSTree *new_tree,
+                                     const char *source) {
+  if (!edit_tracker_begin_update(&self->tracker, old_tree, new_tree,
+                                 self->headings.contents,
+                                 self->headings.size)) {
+    return;
+  }
+  array_clear(&self->added);
+  TSNode root = ts_tree_root_node(new_tree);
+  for (uint32_t i = 0; i < self->tracker.walked.size; ++i) {
+    collect(self, root, &self->tracker.walked.contents[i], source,
+            &self->added);
+  }
+  edit_tracker_end_update(&self->tracker, (Array *)&self->headings,
+                          (Array *)&self->added, (Array *)&self->spare);
+}
@@ -0,0 +1,164 @@
+#include "split.h"
+#include "tree-sitter-djot.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *string;
+  uint32_t length;
+  TSDjotChunk *chunks;
+  uint32_t chunk_count;
+  // The next chunk that no thread has taken yet.
+  atomic_uint next;
+} Job;
+
+static TSTree *parse_chunk(TSParser *parser, const char *string,
+                           uint32_t length, const TSDjotChunk *chunk) {
+  TSRange range = {
+      .start_point = chunk->start.start_point,
+      .end_point = chunk->end_point,
+      .start_byte = chunk->start.start_byte,
+      .end_byte = chunk->end_byte,
+  };
+  ts_parser_set_included_ranges(parser, &range, 1);
+  return ts_parser_parse_string(parser, NULL, string, length);
+}
+
+static TSParser *new_parser(void) {
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, tree_sitter_djot());
+  return parser;
+}
+
+// Every thread has its own parser, and with it its own scanner, and takes
+// chunks until there are none left.
+static void *parse_chunks(void *payload) {
+  Job *job = payload;
+  TSParser *parser = new_parser();
+  for (;;) {
+    uint32_t i = atomic_fetch_add(&job->next, 1);
+    if (i >= job->chunk_count) {
+      break;
+    }
+    job->chunks[i].tree =
+        parse_chunk(parser, job->string, job->length, &job->chunks[i]);
+  }
+  ts_parser_delete(parser);
+  return NULL;
+}
+
+// Merge the chunks from `first` to `last` into `first`.
+static uint32_t merge_chunks(TSDjotChunk *chunks, uint32_t count,
+                             uint32_t first, uint32_t last) {
+  for (uint32_t i = first; i <= last; ++i) {
+    ts_tree_delete(chunks[i].tree);
+  }
+  chunks[first].end_byte = chunks[last].end_byte;
+  chunks[first].end_point = chunks[last].end_point;
+  memmove(&chunks[first + 1], &chunks[last + 1],
+          (count - last - 1) * sizeof(TSDjotChunk));
+  return count - (last - first);
+}
+
+// The pre-scan may split inside a block it doesn't understand, leaving a block
+// in the chunk before the split that is never closed. Parse such chunks again
+// together with the chunk after them. After `MAX_UNTERMINATED_TRIES` merges
+// into the same chunk, the rest of the document is parsed with it at once,
+// so a block the pre-scan never sees the end of costs one serial parse
+// instead of a parse for every chunk after it.
+static uint32_t merge_unterminated(TSDjotChunk *chunks, uint32_t count,
+                                   const char *string, uint32_t length) {
+  TSParser *parser = NULL;
+  uint32_t i = 0;
+  uint32_t tries = 0;
+  while (i + 1 < count) {
+    if (!tree_ends_unterminated(chunks[i].tree)) {
+      ++i;
+      tries = 0;
+      continue;
+    }
+    if (!parser) {
+      parser = new_parser();
+    }
+    uint32_t last = ++tries < MAX_UNTERMINATED_TRIES ? i + 1 : count - 1;
+    count = merge_chunks(chunks, count, i, last);
+    chunks[i].tree = parse_chunk(parser, string, length, &chunks[i]);
+  }
+
+  if (parser) {
+    ts_parser_delete(parser);
+  }
+  return count;
+}
+
+TSDjotChunk *tree_sitter_djot_parse_chunked(const char *string,
+                                            uint32_t length,
+                                            uint32_t chunk_size,
+                                            uint32_t thread_count,
+                                            uint32_t *chunk_count) {
+  uint32_t count;
+  TSDjotBoundary *points =
+      tree_sitter_djot_split_points(string, length, chunk_size, &count);
+  if (!points) {
+    return NULL;
+  }
+  TSDjotChunk *chunks = calloc(count, sizeof(TSDjotChunk));
+  if (!chunks) {
+    free(points);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    chunks[i].start = points[i];
+    if (i + 1 < count) {
+      chunks[i].end_byte = points[i + 1].start_byte;
+      chunks[i].end_point = points[i + 1].start_point;
+    } else {
+      chunks[i].end_byte = length;
+      chunks[i].end_point = (TSPoint){UINT32_MAX, UINT32_MAX};
+    }
+  }
+  free(points);
+
+  Job job = {
+      .string = string,
+      .length = length,
+      .chunks = chunks,
+      .chunk_count = count,
+  };
+  atomic_init(&job.next, 0);
+
+  if (thread_count > count) {
+    thread_count = count;
+  }
+  // The calling thread parses chunks too.
+  uint32_t started = 0;
+  pthread_t *threads = NULL;
+  if (thread_count > 1) {
+    threads = malloc((thread_count - 1) * sizeof(pthread_t));
+    if (!threads) {
+      free(chunks);
+      return NULL;
+    }
+    while (started < thread_count - 1 &&
+           pthread_create(&threads[started], NULL, parse_chunks, &job) == 0) {
+      ++started;
+    }
+  }
+  parse_chunks(&job);
+  for (uint32_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  *chunk_count = merge_unterminated(chunks, count, string, length);
+  return chunks;
+}
+
+void tree_sitter_djot_chunks_delete(TSDjotChunk *chunks, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    ts_tree_delete(chunks[i].tree);
+  }
+  free(chunks);
+}
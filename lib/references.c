@@ -0,0 +1,412 @@
+#include "edits.h"
+#include "results.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every definition and reference is an occurrence, kept in document order and
+// pointing to its label in a hash table. Labels are never removed, so the
+// table only grows, and the counts of a label are tallied from the
+// occurrences after every update.
+//
+// Edits shift the occurrences after them, like `ts_tree_edit` shifts nodes.
+// An update then drops the occurrences in the ranges that changed and walks
+// only those ranges of the new tree, so its cost is bounded by the size of
+// the changes and the number of occurrences, not by the size of the document.
+
+typedef struct {
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t label;
+  bool definition;
+} Occurrence;
+
+typedef struct {
+  uint32_t hash;
+  uint32_t offset;
+  uint32_t length;
+  TSDjotReferenceKind kind;
+  uint32_t definition_count;
+  uint32_t reference_count;
+  // The first definition, in `occurrences`.
+  uint32_t definition;
+} Label;
+
+typedef Array(Occurrence) Occurrences;
+
+struct TSDjotReferenceIndex {
+  TSSymbol link_reference_definition;
+  TSSymbol footnote;
+  TSSymbol full_reference_link;
+  TSSymbol full_reference_image;
+  TSSymbol collapsed_reference_link;
+  TSSymbol collapsed_reference_image;
+  TSSymbol footnote_reference;
+  TSSymbol link_label;
+  TSSymbol link_text;
+  TSSymbol image_description;
+  TSSymbol reference_label;
+  TSSymbol paragraph;
+  TSSymbol heading;
+  TSSymbol table;
+
+  Occurrences occurrences;
+  Array(Label) labels;
+  Array(char) strings;
+  // Indices into `labels` plus one, or 0 for empty slots. The size is a power
+  // of two.
+  uint32_t *slots;
+  uint32_t slot_count;
+  EditTracker tracker;
+
+  // Reused by updates.
+  Occurrences added;
+  Occurrences spare;
+};
+
+typedef struct {
+  TSDjotReferenceIndex *self;
+  const char *source;
+  Occurrences *result;
+} Collector;
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Labels match when they're the same with whitespace collapsed, and the
+// normalized label is hashed while it's written.
+static uint32_t normalize_label(TSDjotReferenceIndex *self, const char *string,
+                                uint32_t length) {
+  uint32_t hash = 2166136261u;
+  bool space = false;
+  uint32_t start = self->strings.size;
+  for (uint32_t i = 0; i < length; ++i) {
+    char c = string[i];
+    if (is_space(c)) {
+      space = self->strings.size > start;
+      continue;
+    }
+    if (space) {
+      array_push(&self->strings, ' ');
+      hash = (hash ^ ' ') * 16777619u;
+      space = false;
+    }
+    array_push(&self->strings, c);
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+  return hash;
+}
+
+static void add_slot(TSDjotReferenceIndex *self, uint32_t index) {
+  uint32_t slot = self->labels.contents[index].hash & (self->slot_count - 1);
+  while (self->slots[slot]) {
+    slot = (slot + 1) & (self->slot_count - 1);
+  }
+  self->slots[slot] = index + 1;
+}
+
+// Double the table, or make the first one. Returns false, keeping the old
+// table, if there's no memory for the new one.
+static bool grow_slots(TSDjotReferenceIndex *self) {
+  uint32_t count = self->slot_count ? self->slot_count * 2 : 256;
+  uint32_t *slots = calloc(count, sizeof(uint32_t));
+  if (!slots) {
+    return false;
+  }
+  free(self->slots);
+  self->slots = slots;
+  self->slot_count = count;
+  for (uint32_t i = 0; i < self->labels.size; ++i) {
+    add_slot(self, i);
+  }
+  return true;
+}
+
+// Find the label of `kind` written at the end of `strings`, and add it if
+// `add` is set. The written label is removed again unless it was added.
+//
+// Returns UINT32_MAX if the label wasn't found, or couldn't be added.
+static uint32_t find_label(TSDjotReferenceIndex *self, TSDjotReferenceKind kind,
+                           uint32_t offset, uint32_t hash, bool add) {
+  uint32_t length = self->strings.size - offset;
+  hash ^= kind;
+  uint32_t slot = hash & (self->slot_count - 1);
+  while (self->slots[slot]) {
+    uint32_t index = self->slots[slot] - 1;
+    const Label *label = &self->labels.contents[index];
+    if (label->hash == hash && label->kind == kind &&
+        label->length == length &&
+        memcmp(self->strings.contents + label->offset,
+               self->strings.contents + offset, length) == 0) {
+      self->strings.size = offset;
+      return index;
+    }
+    slot = (slot + 1) & (self->slot_count - 1);
+  }
+
+  // Without memory for a larger table, the label goes into the old one as
+  // long as a slot stays empty to end the probes.
+  if (!add || ((self->labels.size + 1) * 2 > self->slot_count &&
+               !grow_slots(self) &&
+               self->labels.size + 1 >= self->slot_count)) {
+    self->strings.size = offset;
+    return UINT32_MAX;
+  }
+  Label label = {
+      .hash = hash,
+      .offset = offset,
+      .length = length,
+      .kind = kind,
+  };
+  array_push(&self->labels, label);
+  add_slot(self, self->labels.size - 1);
+  return self->labels.size - 1;
+}
+
+static TSNode child_of_symbol(TSNode node, TSSymbol symbol) {
+  uint32_t count = ts_node_child_count(node);
+  for (uint32_t i = 0; i < count; ++i) {
+    TSNode child = ts_node_child(node, i);
+    if (ts_node_symbol(child) == symbol) {
+      return child;
+    }
+  }
+  TSNode null = {{0}, NULL, NULL};
+  return null;
+}
+
+static void add_occurrence(TSDjotReferenceIndex *self, Occurrences *result,
+                           TSNode node, TSDjotReferenceKind kind, TSNode label,
+                           uint32_t open_length, bool definition,
+                           const char *source) {
+  if (ts_node_is_null(label)) {
+    return;
+  }
+  uint32_t start = ts_node_start_byte(label) + open_length;
+  uint32_t end = ts_node_end_byte(label);
+  // Without the closing bracket of link text and image descriptions.
+  if (open_length > 0 && end > start) {
+    --end;
+  }
+  uint32_t offset = self->strings.size;
+  uint32_t hash =
+      normalize_label(self, source + start, end > start ? end - start : 0);
+  Occurrence occurrence = {
+      .start_byte = ts_node_start_byte(node),
+      .end_byte = ts_node_end_byte(node),
+      .label = find_label(self, kind, offset, hash, true),
+      .definition = definition,
+  };
+  if (occurrence.label != UINT32_MAX) {
+    array_push(result, occurrence);
+  }
+}
+
+static bool visit(void *payload, TSNode node) {
+  Collector *c = payload;
+  TSDjotReferenceIndex *self = c->self;
+  TSSymbol symbol = ts_node_symbol(node);
+  if (symbol == self->link_reference_definition) {
+    add_occurrence(self, c->result, node, TSDjotReferenceLink,
+                   child_of_symbol(node, self->link_label), 0, true,
+                   c->source);
+    return false;
+  }
+  if (symbol == self->footnote) {
+    add_occurrence(self, c->result, node, TSDjotReferenceFootnote,
+                   child_of_symbol(node, self->reference_label), 0, true,
+                   c->source);
+  } else if (symbol == self->full_reference_link ||
+             symbol == self->full_reference_image) {
+    add_occurrence(self, c->result, node, TSDjotReferenceLink,
+                   child_of_symbol(node, self->link_label), 0, false,
+                   c->source);
+  } else if (symbol == self->collapsed_reference_link) {
+    add_occurrence(self, c->result, node, TSDjotReferenceLink,
+                   child_of_symbol(node, self->link_text), 1, false,
+                   c->source);
+  } else if (symbol == self->collapsed_reference_image) {
+    add_occurrence(self, c->result, node, TSDjotReferenceLink,
+                   child_of_symbol(node, self->image_description), 2, false,
+                   c->source);
+  } else if (symbol == self->footnote_reference) {
+    add_occurrence(self, c->result, node, TSDjotReferenceFootnote,
+                   child_of_symbol(node, self->reference_label), 0, false,
+                   c->source);
+    return false;
+  } else if (symbol == self->paragraph || symbol == self->heading ||
+             symbol == self->table) {
+    // References start with `[`, so only look for them in text that has one.
+    uint32_t start = ts_node_start_byte(node);
+    return memchr(c->source + start, '[', ts_node_end_byte(node) - start) !=
+           NULL;
+  }
+  return true;
+}
+
+// Collect the occurrences that touch `range`, in document order.
+static void collect(TSDjotReferenceIndex *self, TSNode root,
+                    const EditRange *range, const char *source,
+                    Occurrences *result) {
+  Collector c = {self, source, result};
+  edit_walk(root, range, visit, &c);
+}
+
+static int compare_occurrences(const void *a, const void *b) {
+  const Occurrence *x = a, *y = b;
+  return x->start_byte < y->start_byte ? -1 : x->start_byte > y->start_byte;
+}
+
+// Count the definitions and references of every label again.
+static void tally(TSDjotReferenceIndex *self) {
+  for (uint32_t i = 0; i < self->labels.size; ++i) {
+    Label *label = &self->labels.contents[i];
+    label->definition_count = 0;
+    label->reference_count = 0;
+  }
+  for (uint32_t i = 0; i < self->occurrences.size; ++i) {
+    const Occurrence *occurrence = &self->occurrences.contents[i];
+    Label *label = &self->labels.contents[occurrence->label];
+    if (!occurrence->definition) {
+      ++label->reference_count;
+    } else if (label->definition_count++ == 0) {
+      label->definition = i;
+    }
+  }
+}
+
+TSDjotReferenceIndex *tree_sitter_djot_reference_index_new(const TSTree *tree,
+                                                          const char *source) {
+  const TSLanguage *language = ts_tree_language(tree);
+  TSDjotReferenceIndex *self = calloc(1, sizeof(TSDjotReferenceIndex));
+  if (!self || !grow_slots(self)) {
+    free(self);
+    errno = ENOMEM;
+    return NULL;
+  }
+  edit_tracker_init(&self->tracker, sizeof(Occurrence),
+                    offsetof(Occurrence, start_byte),
+                    offsetof(Occurrence, end_byte), compare_occurrences);
+  self->link_reference_definition =
+      edit_symbol(language, "link_reference_definition");
+  self->footnote = edit_symbol(language, "footnote");
+  self->full_reference_link = edit_symbol(language, "full_reference_link");
+  self->full_reference_image = edit_symbol(language, "full_reference_image");
+  self->collapsed_reference_link =
+      edit_symbol(language, "collapsed_reference_link");
+  self->collapsed_reference_image =
+      edit_symbol(language, "collapsed_reference_image");
+  self->footnote_reference = edit_symbol(language, "footnote_reference");
+  self->link_label = edit_symbol(language, "link_label");
+  self->link_text = edit_symbol(language, "link_text");
+  self->image_description = edit_symbol(language, "image_description");
+  self->reference_label = edit_symbol(language, "reference_label");
+  self->paragraph = edit_symbol(language, "paragraph");
+  self->heading = edit_symbol(language, "heading");
+  self->table = edit_symbol(language, "table");
+
+  TSNode root = ts_tree_root_node(tree);
+  EditRange everything = {0, ts_node_end_byte(root)};
+  collect(self, root, &everything, source, &self->occurrences);
+  tally(self);
+  return self;
+}
+
+void tree_sitter_djot_reference_index_delete(TSDjotReferenceIndex *self) {
+  array_delete(&self->occurrences);
+  array_delete(&self->labels);
+  array_delete(&self->strings);
+  edit_tracker_delete(&self->tracker);
+  array_delete(&self->added);
+  array_delete(&self->spare);
+  free(self->slots);
+  free(self);
+}
+
+void tree_sitter_djot_reference_index_edit(TSDjotReferenceIndex *self,
+                                          const TSInputEdit *edit) {
+  // Occurrences that touched the edit still touch its range once they're
+  // shifted, so the update finds them.
+  for (uint32_t i = 0; i < self->occurrences.size; ++i) {
+    Occurrence *occurrence = &self->occurrences.contents[i];
+    if (occurrence->end_byte >= edit->start_byte) {
+      occurrence->start_byte = edit_shift(occurrence->start_byte, edit);
+      occurrence->end_byte = edit_shift(occurrence->end_byte, edit);
+    }
+  }
+  edit_ranges_add_edit(&self->tracker.edits, edit);
+}
+
+void tree_sitter_djot_reference_index_update(TSDjotReferenceIndex *self,
+                                            const TSTree *old_tree,
+                                            const TSTree *new_tree,
+                                            const char *source) {
+  if (!edit_tracker_begin_update(&self->tracker, old_tree, new_tree,
+                                 self->occurrences.contents,
+                                 self->occurrences.size)) {
+    return;
+  }
+  array_clear(&self->added);
+  TSNode root = ts_tree_root_node(new_tree);
+  for (uint32_t i = 0; i < self->tracker.walked.size; ++i) {
+    collect(self, root, &self->tracker.walked.contents[i], source,
+            &self->added);
+  }
+  edit_tracker_end_update(&self->tracker, (Array *)&self->occurrences,
+                          (Array *)&self->added, (Array *)&self->spare);
+  tally(self);
+}
+
+bool tree_sitter_djot_reference_index_lookup(TSDjotReferenceIndex *self,
+                                            TSDjotReferenceKind kind,
+                                            const char *label, uint32_t length,
+                                            TSDjotReferenceLabel *result) {
+  uint32_t offset = self->strings.size;
+  uint32_t hash = normalize_label(self, label, length);
+  uint32_t index = find_label(self, kind, offset, hash, false);
+  if (index == UINT32_MAX) {
+    return false;
+  }
+  const Label *found = &self->labels.contents[index];
+  if (found->definition_count == 0 && found->reference_count == 0) {
+    return false;
+  }
+  *result = (TSDjotReferenceLabel){
+      .kind = found->kind,
+      .definition_count = found->definition_count,
+      .reference_count = found->reference_count,
+  };
+  if (found->definition_count > 0) {
+    const Occurrence *definition =
+        &self->occurrences.contents[found->definition];
+    result->start_byte = definition->start_byte;
+    result->end_byte = definition->end_byte;
+  }
+  return true;
+}
+
+TSDjotReferenceProblem *
+tree_sitter_djot_reference_index_problems(const TSDjotReferenceIndex *self,
+                                          uint32_t *count) {
+  Array(TSDjotReferenceProblem) problems = array_new();
+  for (uint32_t i = 0; i < self->occurrences.size; ++i) {
+    const Occurrence *occurrence = &self->occurrences.contents[i];
+    const Label *label = &self->labels.contents[occurrence->label];
+    TSDjotReferenceProblem problem = {
+        .kind = label->kind,
+        .start_byte = occurrence->start_byte,
+        .end_byte = occurrence->end_byte,
+    };
+    if (!occurrence->definition && label->definition_count == 0) {
+      problem.type = TSDjotReferenceUnresolved;
+      array_push(&problems, problem);
+    } else if (occurrence->definition && label->definition != i) {
+      problem.type = TSDjotReferenceDuplicate;
+      array_push(&problems, problem);
+    }
+  }
+  *count = problems.size;
+  return array_release(&problems);
+}
@@ -0,0 +1,33 @@
+#ifndef TREE_SITTER_DJOT_RESULTS_H_
+#define TREE_SITTER_DJOT_RESULTS_H_
+
+// Shared by the helpers that return arrays, which the caller frees with
+// `free`. `Array` grows with `ts_realloc`, which is `realloc` unless
+// `TREE_SITTER_REUSE_ALLOCATOR` is defined.
+
+#include "tree_sitter/array.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline void *_array__release(void *contents, uint32_t size,
+                                    size_t element_size) {
+#ifdef TREE_SITTER_REUSE_ALLOCATOR
+  void *result = NULL;
+  if (size > 0) {
+    result = malloc(size * element_size);
+    memcpy(result, contents, size * element_size);
+  }
+  ts_free(contents);
+  return result;
+#else
+  (void)size;
+  (void)element_size;
+  return contents;
+#endif
+}
+
+// Hand the contents of `self` to the caller, in memory from `malloc`.
+#define array_release(self)                                                    \
+  _array__release((self)->contents, (self)->size, array_elem_size(self))
+
+#endif // TREE_SITTER_DJOT_RESULTS_H_
@@ -0,0 +1,263 @@
+#include "results.h"
+#include "split.h"
+#include <string.h>
+
+// Finds split points with a line-by-line scan, without parsing the document.
+//
+// It tracks just enough of the block structure to know when the external
+// scanner would only have sections open: the frontmatter, code blocks, divs,
+// paragraphs and headings. A line is a split point if it follows a blank
+// line, isn't indented or quoted, and starts a heading or a paragraph while
+// no code block or div is open. Such a line closes every open list, block
+// quote, footnote and table.
+
+typedef struct {
+  const char *start;
+  const char *end;
+  // The content after indentation and block quote markers. Before
+  // `strip_prefix`, the content after indentation.
+  const char *content;
+  bool quoted;
+} Line;
+
+static uint32_t count_chars(const char *p, const char *end, char c) {
+  const char *start = p;
+  while (p < end && *p == c) {
+    ++p;
+  }
+  return (uint32_t)(p - start);
+}
+
+static const char *skip_whitespace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    ++p;
+  }
+  return p;
+}
+
+static bool is_blank(const char *p, const char *end) {
+  return skip_whitespace(p, end) == end;
+}
+
+// Strip `> ` markers after the indentation.
+static void strip_prefix(Line *line) {
+  const char *p = line->content;
+  while (p < line->end && *p == '>' &&
+         (p + 1 == line->end || p[1] == ' ' || p[1] == '\r')) {
+    line->quoted = true;
+    p = skip_whitespace(p + 1, line->end);
+  }
+  line->content = p;
+}
+
+// If a word of list marker characters followed by `.` or `)` starts the line,
+// like `1.`, `a)` or `iv.`.
+static bool is_ordered_list_marker(const char *p, const char *end) {
+  const char *word = p;
+  while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                     (*p >= '0' && *p <= '9'))) {
+    ++p;
+  }
+  return p > word && p < end && (*p == '.' || *p == ')');
+}
+
+// Paragraphs starting with a letter can't be anything else.
+static bool starts_paragraph(const Line *line) {
+  char c = *line->content;
+  bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  return letter && !is_ordered_list_marker(line->content, line->end);
+}
+
+// Returns the level of a heading starting the line, or 0.
+static uint32_t heading_level(const Line *line) {
+  uint32_t hashes = count_chars(line->content, line->end, '#');
+  const char *after = line->content + hashes;
+  return hashes > 0 && after < line->end && *after == ' ' ? hashes : 0;
+}
+
+// Returns false if the section is nested too deep to be recorded.
+static bool open_section(SplitScanner *s, uint32_t level) {
+  TSDjotBoundary *current = &s->current;
+  while (current->section_depth > 0 &&
+         current->section_levels[current->section_depth - 1] >= level) {
+    --current->section_depth;
+  }
+  if (current->section_depth == TREE_SITTER_DJOT_MAX_SECTION_DEPTH ||
+      level > UINT8_MAX) {
+    return false;
+  }
+  current->section_levels[current->section_depth++] = (uint8_t)level;
+  return true;
+}
+
+static void toggle_div(SplitScanner *s, uint32_t colons) {
+  for (uint32_t i = s->divs.size; i > 0; --i) {
+    if (*array_get(&s->divs, i - 1) == colons) {
+      s->divs.size = i - 1;
+      return;
+    }
+  }
+  array_push(&s->divs, colons);
+}
+
+// Process a line, returning true if it's a split point.
+// `s->current` then holds the sections open after the line.
+static bool scan_line(SplitScanner *s, Line *line, bool first_line) {
+  bool after_blankline = s->after_blankline;
+  s->after_blankline = false;
+
+  if (first_line && count_chars(line->start, line->end, '-') >= 3) {
+    s->in_frontmatter = true;
+    return false;
+  }
+  if (s->in_frontmatter) {
+    if (count_chars(line->start, line->end, '-') >= 3) {
+      s->in_frontmatter = false;
+      s->after_blankline = true;
+    }
+    return false;
+  }
+
+  strip_prefix(line);
+  const char *content = line->content;
+
+  if (s->fence > 0) {
+    uint32_t ticks = count_chars(content, line->end, '`');
+    if (ticks == s->fence && is_blank(content + ticks, line->end)) {
+      s->fence = 0;
+    }
+    return false;
+  }
+
+  if (content == line->end) {
+    s->after_blankline = true;
+    s->in_paragraph = false;
+    s->heading = 0;
+    return false;
+  }
+
+  // Backticks and colons inside a paragraph are inline verbatim and symbols.
+  if (!s->in_paragraph) {
+    uint32_t ticks = count_chars(content, line->end, '`');
+    if (ticks >= 3) {
+      s->fence = ticks;
+      return false;
+    }
+    uint32_t colons = count_chars(content, line->end, ':');
+    if (colons >= 3) {
+      toggle_div(s, colons);
+      return false;
+    }
+    if (*content == '{' && line->end[-1] == '}') {
+      // A block attribute.
+      return false;
+    }
+  }
+
+  bool top_level = content == line->start && !line->quoted && s->divs.size == 0;
+  bool split = false;
+  uint32_t level = top_level ? heading_level(line) : 0;
+  if (level > 0 && (!s->in_paragraph || (s->heading && s->heading != level))) {
+    split = open_section(s, level) && after_blankline;
+    s->heading = level;
+  } else if (top_level && after_blankline && starts_paragraph(line)) {
+    split = true;
+  }
+
+  s->in_paragraph = true;
+  return split;
+}
+
+void split_scanner_init(SplitScanner *s) {
+  *s = (SplitScanner){.after_blankline = true};
+  array_init(&s->divs);
+}
+
+void split_scanner_delete(SplitScanner *s) { array_delete(&s->divs); }
+
+bool split_scanner_scan_line(SplitScanner *s, const char *string,
+                             const ScannedLine *scanned, bool first_line,
+                             TSDjotBoundary *sections) {
+  Line line = {
+      .start = string + scanned->start,
+      .end = string + scanned->end,
+      .content = string + scanned->content,
+  };
+  if (!scan_line(s, &line, first_line)) {
+    return false;
+  }
+  // A heading is enclosed by the sections before its own.
+  *sections = s->current;
+  if (heading_level(&line) > 0) {
+    --sections->section_depth;
+  }
+  return true;
+}
+
+TSDjotBoundary *tree_sitter_djot_split_points(const char *string,
+                                              uint32_t length,
+                                              uint32_t chunk_size,
+                                              uint32_t *count) {
+  SplitScanner s;
+  split_scanner_init(&s);
+
+  Array(TSDjotBoundary) points = array_new();
+  TSDjotBoundary start = {0};
+  array_push(&points, start);
+
+  LineScanner lines;
+  line_scanner_init(&lines, string, length, 0);
+  ScannedLine line;
+  uint32_t row = 0;
+  while (line_scanner_next(&lines, &line)) {
+    TSDjotBoundary point;
+    if (split_scanner_scan_line(&s, string, &line, row == 0, &point) &&
+        row > 0 && line.start - array_back(&points)->start_byte >= chunk_size) {
+      point.start_byte = line.start;
+      point.start_point = (TSPoint){row, 0};
+      array_push(&points, point);
+    }
+    ++row;
+  }
+
+  split_scanner_delete(&s);
+  *count = points.size;
+  return array_release(&points);
+}
+
+static TSSymbol symbol(const TSLanguage *language, const char *name) {
+  return ts_language_symbol_for_name(language, name, strlen(name), true);
+}
+
+static bool has_child(TSNode node, TSSymbol symbol) {
+  uint32_t count = ts_node_child_count(node);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (ts_node_symbol(ts_node_child(node, i)) == symbol) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool tree_ends_unterminated(const TSTree *tree) {
+  const TSLanguage *language = ts_tree_language(tree);
+  TSSymbol code_block = symbol(language, "code_block");
+  TSSymbol code_block_marker_end = symbol(language, "code_block_marker_end");
+  TSSymbol raw_block = symbol(language, "raw_block");
+  TSSymbol raw_block_marker_end = symbol(language, "raw_block_marker_end");
+  TSSymbol div = symbol(language, "div");
+  TSSymbol div_marker_end = symbol(language, "div_marker_end");
+
+  TSNode node = ts_tree_root_node(tree);
+  uint32_t count;
+  while ((count = ts_node_child_count(node)) > 0) {
+    TSSymbol current = ts_node_symbol(node);
+    if ((current == code_block && !has_child(node, code_block_marker_end)) ||
+        (current == raw_block && !has_child(node, raw_block_marker_end)) ||
+        (current == div && !has_child(node, div_marker_end))) {
+      return true;
+    }
+    node = ts_node_child(node, count - 1);
+  }
+  return false;
+}
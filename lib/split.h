@@ -0,0 +1,46 @@
+#ifndef TREE_SITTER_DJOT_SPLIT_H_
+#define TREE_SITTER_DJOT_SPLIT_H_
+
+// Shared by the helpers that parse a document in parts.
+
+#include "lines.h"
+#include "tree-sitter-djot-utils.h"
+#include "tree_sitter/array.h"
+
+// The block structure tracked by the line scan of `split.c`.
+typedef struct {
+  // Backticks of the open code block, if any.
+  uint32_t fence;
+  // Colons of the open divs.
+  Array(uint32_t) divs;
+  bool in_frontmatter;
+  // If the previous line was blank (or the document just started).
+  bool after_blankline;
+  // If the previous line was inline content, so a `#` can't start a heading.
+  bool in_paragraph;
+  // Level of the heading on the previous line, if any.
+  uint32_t heading;
+
+  // The sections open at the current line.
+  TSDjotBoundary current;
+} SplitScanner;
+
+void split_scanner_init(SplitScanner *s);
+void split_scanner_delete(SplitScanner *s);
+
+// Scan a line of `string` found by a `LineScanner`. Returns true if the
+// document can be split before the line, and writes the sections enclosing
+// it to `sections`.
+bool split_scanner_scan_line(SplitScanner *s, const char *string,
+                             const ScannedLine *line, bool first_line,
+                             TSDjotBoundary *sections);
+
+// How many times a part that ends inside a block is parsed again with more of
+// the document before giving up on finding the end of the block.
+#define MAX_UNTERMINATED_TRIES 4
+
+// If a code block, raw block or div is still open at the end of `tree`, which
+// means it was split inside the block.
+bool tree_ends_unterminated(const TSTree *tree);
+
+#endif // TREE_SITTER_DJOT_SPLIT_H_
@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "split.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The input is read into a buffer that holds the part being scanned, and the
+// part is flushed at the first split point after `part_size` bytes. The
+// buffer then only keeps the bytes after the split, so it never grows much
+// larger than the largest part.
+
+#define READ_SIZE (64 * 1024)
+
+typedef struct {
+  int fd;
+  // The bytes from the start of the current part.
+  char *buffer;
+  uint32_t size;
+  uint32_t capacity;
+  bool eof;
+} Reader;
+
+typedef struct {
+  const char *string;
+  uint32_t length;
+} Part;
+
+static bool fill(Reader *r) {
+  if (r->capacity - r->size < READ_SIZE) {
+    if (r->size > UINT32_MAX / 2 - READ_SIZE) {
+      errno = EFBIG;
+      return false;
+    }
+    uint32_t capacity = (r->size + READ_SIZE) * 2;
+    char *buffer = realloc(r->buffer, capacity);
+    if (!buffer) {
+      errno = ENOMEM;
+      return false;
+    }
+    r->buffer = buffer;
+    r->capacity = capacity;
+  }
+  ssize_t n;
+  do {
+    n = read(r->fd, r->buffer + r->size, r->capacity - r->size);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    return false;
+  }
+  r->eof = n == 0;
+  r->size += (uint32_t)n;
+  return true;
+}
+
+// Drop the first `length` bytes of the buffer.
+static void discard(Reader *r, uint32_t length) {
+  memmove(r->buffer, r->buffer + length, r->size - length);
+  r->size -= length;
+}
+
+static const char *read_part(void *payload, uint32_t byte, TSPoint position,
+                             uint32_t *bytes_read) {
+  (void)position;
+  const Part *part = payload;
+  if (byte >= part->length) {
+    *bytes_read = 0;
+    return "";
+  }
+  *bytes_read = part->length - byte;
+  return part->string + byte;
+}
+
+static TSTree *parse_part(TSParser *parser, const char *string,
+                          uint32_t length) {
+  Part part = {string, length};
+  TSInput input = {
+      .payload = &part,
+      .read = read_part,
+      .encoding = TSInputEncodingUTF8,
+  };
+  return ts_parser_parse(parser, NULL, input);
+}
+
+bool tree_sitter_djot_parse_stream(TSParser *parser, int fd,
+                                   uint32_t part_size,
+                                   TSDjotStreamCallback callback,
+                                   void *payload) {
+  Reader r = {.fd = fd};
+  SplitScanner s;
+  split_scanner_init(&s);
+
+  TSDjotStreamPart part = {0};
+  // The start of the next line to scan, relative to the part.
+  uint32_t scanned = 0;
+  // The size of the part before we try to split it.
+  uint32_t split_size = part_size;
+  uint32_t tries = 0;
+  uint64_t row = 0;
+  bool ok = true;
+  bool stopped = false;
+
+  while (ok && !stopped) {
+    LineScanner lines;
+    line_scanner_init(&lines, r.buffer, r.size, scanned);
+    ScannedLine line;
+    while (!stopped && line_scanner_next(&lines, &line)) {
+      bool newline = line.end < r.size;
+      if (!newline && !r.eof) {
+        break;
+      }
+
+      TSDjotBoundary sections;
+      if (split_scanner_scan_line(&s, r.buffer, &line, row == 0, &sections) &&
+          scanned >= split_size && row > part.start_row) {
+        // When the part ends inside a block that the scan didn't see, it's
+        // parsed again at a split point twice as far, so the reparses cost
+        // at most as much as the part. After `MAX_UNTERMINATED_TRIES` tries,
+        // it's cut inside the block anyway.
+        TSTree *tree = parse_part(parser, r.buffer, scanned);
+        if (!tree) {
+          // The parser timed out or was cancelled.
+          errno = ECANCELED;
+          ok = false;
+          break;
+        }
+        if (++tries < MAX_UNTERMINATED_TRIES &&
+            tree_ends_unterminated(tree)) {
+          ts_tree_delete(tree);
+          split_size = scanned > UINT32_MAX / 2 ? UINT32_MAX : scanned * 2;
+        } else {
+          part.tree = tree;
+          stopped = !callback(payload, &part);
+          ts_tree_delete(tree);
+
+          part.start_byte += scanned;
+          part.start_row = row;
+          part.section_depth = sections.section_depth;
+          memcpy(part.section_levels, sections.section_levels,
+                 sizeof(part.section_levels));
+          // The line now starts the buffer.
+          discard(&r, scanned);
+          line.end -= line.start;
+          line.start = 0;
+          line_scanner_init(&lines, r.buffer, r.size, line.end + 1);
+          split_size = part_size;
+          tries = 0;
+        }
+      }
+
+      scanned = line.end + (newline ? 1 : 0);
+      ++row;
+    }
+    if (!ok || r.eof || stopped) {
+      break;
+    }
+    ok = fill(&r);
+  }
+
+  if (ok && !stopped) {
+    TSTree *tree = parse_part(parser, r.buffer, r.size);
+    if (tree) {
+      part.tree = tree;
+      callback(payload, &part);
+      ts_tree_delete(tree);
+    } else {
+      errno = ECANCELED;
+      ok = false;
+    }
+  }
+
+  split_scanner_delete(&s);
+  free(r.buffer);
+  return ok;
+}
@@ -0,0 +1,80 @@
+#include "tree-sitter-djot-utils.h"
+
+// A viewport is parsed from the boundary before it to the boundary after it,
+// which are found with binary searches, so nothing outside of the two is read
+// and the cost doesn't depend on the size of the document.
+
+// The first of `boundaries` that starts after `byte`.
+static uint32_t boundary_after(const TSDjotBoundary *boundaries,
+                               uint32_t count, uint32_t byte) {
+  uint32_t start = 0;
+  uint32_t end = count;
+  while (start < end) {
+    uint32_t middle = start + (end - start) / 2;
+    if (boundaries[middle].start_byte <= byte) {
+      start = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return start;
+}
+
+bool tree_sitter_djot_parse_viewport(TSParser *parser,
+                                     const TSDjotBoundary *boundaries,
+                                     uint32_t boundary_count,
+                                     const char *string, uint32_t length,
+                                     uint32_t start_byte, uint32_t end_byte,
+                                     uint32_t margin, TSDjotChunk *result) {
+  // Boundaries past the end are from before the document was shortened.
+  boundary_count = boundary_after(boundaries, boundary_count, length);
+
+  uint32_t first = start_byte > margin ? start_byte - margin : 0;
+  uint32_t last =
+      end_byte >= length || length - end_byte <= margin ? length
+                                                        : end_byte + margin;
+
+  // The last boundary at or before `first`, or the start of the document.
+  uint32_t index = boundary_after(boundaries, boundary_count, first);
+  if (index > 0) {
+    result->start = boundaries[index - 1];
+  } else {
+    result->start = (TSDjotBoundary){0};
+  }
+
+  // The first boundary at or after `last` that isn't the start, or the end of
+  // the document.
+  index = boundary_after(boundaries, boundary_count,
+                         last > 0 ? last - 1 : 0);
+  while (index < boundary_count &&
+         boundaries[index].start_byte <= result->start.start_byte) {
+    ++index;
+  }
+  TSRange range = {
+      .start_point = result->start.start_point,
+      .end_point = {UINT32_MAX, UINT32_MAX},
+      .start_byte = result->start.start_byte,
+      .end_byte = UINT32_MAX,
+  };
+  if (index < boundary_count) {
+    range.end_byte = boundaries[index].start_byte;
+    range.end_point = boundaries[index].start_point;
+  }
+
+  ts_parser_set_included_ranges(parser, &range, 1);
+  result->tree = ts_parser_parse_string(parser, NULL, string, length);
+  ts_parser_set_included_ranges(parser, NULL, 0);
+  if (!result->tree) {
+    return false;
+  }
+
+  if (index < boundary_count) {
+    result->end_byte = range.end_byte;
+    result->end_point = range.end_point;
+  } else {
+    TSNode root = ts_tree_root_node(result->tree);
+    result->end_byte = length;
+    result->end_point = ts_node_end_point(root);
+  }
+  return true;
+}
@@ -0,0 +1,28 @@
+; A reduced highlights query for large documents, where running all of
+; `highlights.scm` stalls the editor. It only covers headings, emphasis, code
+; and links, with one capture per node kind and no predicates, and doesn't
+; match anonymous nodes like brackets.
+;
+; Compare the two with `make bench-highlights`.
+
+(heading) @markup.heading
+
+(emphasis) @markup.italic
+
+(strong) @markup.strong
+
+(verbatim) @markup.raw
+
+(code_block) @markup.raw.block
+
+(language) @attribute
+
+(link_text) @markup.link
+
+(link_label) @markup.link.label
+
+[
+  (autolink)
+  (inline_link_destination)
+  (link_destination)
+] @markup.link.url
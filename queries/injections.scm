@@ -1,3 +1,7 @@
+; `tree_sitter_djot_injections` in the C helpers (`make utils`) lists the same
+; injections as this query with their ranges and languages, without running
+; it, so they can be parsed lazily.
+
 ((comment) @injection.content
   (#set! injection.language "comment"))
 
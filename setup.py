@@ -1,17 +1,66 @@
+import re
+import sys
+from os import environ
 from os.path import isdir, join
 from platform import system
+from subprocess import DEVNULL, CalledProcessError, check_output
 
 from setuptools import Extension, find_packages, setup
 from setuptools.command.build import build
 from wheel.bdist_wheel import bdist_wheel
 
 
+def runtime_flags():
+    """The compiler and linker flags of the tree-sitter runtime, if installed."""
+    if system() == "Windows":
+        return None
+    try:
+        return tuple(
+            check_output(
+                ["pkg-config", flags, "tree-sitter"], text=True, stderr=DEVNULL
+            ).split()
+            for flags in ("--cflags", "--libs")
+        )
+    except (OSError, CalledProcessError):
+        return None
+
+
+# `parse_many` needs the tree-sitter runtime. Without it, or with
+# TREE_SITTER_DJOT_WITHOUT_RUNTIME set, the binding is built without
+# `parse_many` and `kind_names`.
+without_runtime = environ.get("TREE_SITTER_DJOT_WITHOUT_RUNTIME", "") not in ("", "0")
+runtime = None if without_runtime else runtime_flags()
+if runtime is None and not without_runtime:
+    print(
+        "warning: pkg-config can't find the tree-sitter runtime, building "
+        "tree_sitter_djot without parse_many and kind_names",
+        file=sys.stderr,
+    )
+
+# Skip from a parse error to the next blank line in the scanner. See
+# TREE_SITTER_DJOT_ERROR_RESYNC in src/scanner.c.
+error_resync = environ.get("TREE_SITTER_DJOT_ERROR_RESYNC", "") not in ("", "0")
+
+# The declarations of the stub that only builds with the runtime match.
+RUNTIME_STUBS = re.compile(
+    r"^# Not in builds without the tree-sitter runtime.*?"
+    r"^# End of the functions that need the runtime\.\n",
+    re.MULTILINE | re.DOTALL,
+)
+
+
 class Build(build):
     def run(self):
         if isdir("queries"):
             dest = join(self.build_lib, "tree_sitter_djot", "queries")
             self.copy_tree("queries", dest)
         super().run()
+        if runtime is None:
+            stub = join(self.build_lib, "tree_sitter_djot", "__init__.pyi")
+            with open(stub) as f:
+                text = f.read()
+            with open(stub, "w") as f:
+                f.write(RUNTIME_STUBS.sub("", text))
 
 
 class BdistWheel(bdist_wheel):
@@ -36,16 +85,19 @@ setup(
             sources=[
                 "bindings/python/tree_sitter_djot/binding.c",
                 "src/parser.c",
-                # NOTE: if your language uses an external scanner, add it here.
-            ],
+                "src/scanner.c",
+            ] + (["lib/export.c"] if runtime else []),
             extra_compile_args=(
                 ["-std=c11"] if system() != 'Windows' else []
-            ),
+            ) + (runtime[0] + ["-pthread"] if runtime else []),
+            extra_link_args=runtime[1] + ["-pthread"] if runtime else [],
             define_macros=[
                 ("Py_LIMITED_API", "0x03080000"),
                 ("PY_SSIZE_T_CLEAN", None)
-            ],
-            include_dirs=["src"],
+            ] + ([("TREE_SITTER_DJOT_PARSE", None)] if runtime else []) + (
+                [("TREE_SITTER_DJOT_ERROR_RESYNC", None)] if error_resync else []
+            ),
+            include_dirs=["src", "bindings/c"],
             py_limited_api=True,
         )
     ],
@@ -1,15 +1,41 @@
 #include "tree_sitter/alloc.h"
 #include "tree_sitter/array.h"
 #include "tree_sitter/parser.h"
-#include <ctype.h>
 #include <stdio.h>
 
 // #define DEBUG
 
+// Allocate blocks, inline elements and the stacks that hold them from a pool
+// owned by each scanner when the slots inside the scanner run out, instead of
+// with `ts_malloc` for every element and `ts_realloc` when a stack grows. The
+// pool is only freed when the scanner is destroyed, so scanners on different
+// threads never share the global allocator while scanning.
+// #define TREE_SITTER_DJOT_ARENA
+
+// Count the memory that scanners allocate, for
+// `tree_sitter_djot_scanner_memory_stats`. Every allocation gets a small
+// header with its size, so leave this off outside of benchmarks.
+// #define TREE_SITTER_DJOT_MEMORY_STATS
+
+// Skip from an error to the next blank line in a single token, instead of
+// letting tree-sitter try to recover at every token in between. Recovery
+// gets much cheaper on long broken stretches, like half-pasted documents,
+// but the rest of the paragraph after an error isn't parsed. The bindings
+// turn it on with the `error-resync` feature of the crate, with
+// TREE_SITTER_DJOT_ERROR_RESYNC=1 when npm or pip build them, and with
+// `-tags djot_error_resync` in Go.
+// #define TREE_SITTER_DJOT_ERROR_RESYNC
+
 #ifdef DEBUG
 #include <assert.h>
 #endif
 
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+#include "../bindings/c/tree-sitter-djot.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#endif
+
 // The different tokens the external scanner support
 // See `externals` in `grammar.js` for a description of most of them.
 typedef enum {
@@ -156,6 +182,92 @@ typedef enum {
   UPPER_ROMAN,
 } OrderedListType;
 
+// Character classes used to classify list markers and identifiers.
+// The ordered list classes are indexed by `OrderedListType`, so a character
+// can be checked against a list type with `1 << type`.
+enum {
+  CHAR_DECIMAL = 1 << DECIMAL,
+  CHAR_LOWER_ALPHA = 1 << LOWER_ALPHA,
+  CHAR_UPPER_ALPHA = 1 << UPPER_ALPHA,
+  CHAR_LOWER_ROMAN = 1 << LOWER_ROMAN,
+  CHAR_UPPER_ROMAN = 1 << UPPER_ROMAN,
+  CHAR_IDENTIFIER = 1 << 5,
+};
+
+static const uint8_t ORDERED_LIST_CHARS = CHAR_DECIMAL | CHAR_LOWER_ALPHA |
+                                          CHAR_UPPER_ALPHA | CHAR_LOWER_ROMAN |
+                                          CHAR_UPPER_ROMAN;
+
+// Lookup table from an (ASCII) character to its classes.
+// Lets us classify a character for all list types with a single load,
+// without depending on the locale like `isalnum` does.
+static const uint8_t CHAR_CLASSES[256] = {
+  ['-'] = CHAR_IDENTIFIER,
+  ['0'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['1'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['2'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['3'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['4'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['5'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['6'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['7'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['8'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['9'] = CHAR_DECIMAL | CHAR_IDENTIFIER,
+  ['A'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['B'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['C'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['D'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['E'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['F'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['G'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['H'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['I'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['J'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['K'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['L'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['M'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['N'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['O'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['P'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['Q'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['R'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['S'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['T'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['U'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['V'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['W'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['X'] = CHAR_UPPER_ALPHA | CHAR_UPPER_ROMAN | CHAR_IDENTIFIER,
+  ['Y'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['Z'] = CHAR_UPPER_ALPHA | CHAR_IDENTIFIER,
+  ['_'] = CHAR_IDENTIFIER,
+  ['a'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['b'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['c'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['d'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['e'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['f'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['g'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['h'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['i'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['j'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['k'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['l'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['m'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['n'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['o'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['p'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['q'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['r'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['s'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['t'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['u'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['v'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['w'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['x'] = CHAR_LOWER_ALPHA | CHAR_LOWER_ROMAN | CHAR_IDENTIFIER,
+  ['y'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+  ['z'] = CHAR_LOWER_ALPHA | CHAR_IDENTIFIER,
+};
+
 typedef struct {
   BlockType type;
   // Data depends on the block type.
@@ -202,13 +314,41 @@ typedef struct {
   uint8_t data;
 } Inline;
 
+// A slot that can hold either a block or an inline element.
+typedef union Slot {
+  Block block;
+  Inline inline_element;
+  // Links free slots together.
+  union Slot *next_free;
+} Slot;
+
+#ifdef TREE_SITTER_DJOT_ARENA
+typedef struct Slab {
+  struct Slab *next;
+  uint32_t capacity;
+  Slot slots[];
+} Slab;
+
+typedef struct {
+  // The most recent slab, which we allocate from when no slot is free.
+  Slab *slabs;
+  uint32_t used;
+} Arena;
+
+#define ARENA_FIRST_SLAB_SLOTS 32
+#endif
+
+// How deep the stacks can be before they need memory outside of the scanner.
+// Enough for short documents, like comments or chat messages.
+#define SCANNER_STACK_SIZE 8
+
 typedef struct {
   // Open blocks is a stack of the blocks that haven't been closed.
   // Used to match closing markers or for implicitly closing blocks.
-  Array(Block *) * open_blocks;
+  Array(Block *) open_blocks;
 
   // Open inline is a stack of non-closed inline elements.
-  Array(Inline *) * open_inline;
+  Array(Inline *) open_inline;
 
   // How many BLOCK_CLOSE we should output right now?
   uint8_t blocks_to_close;
@@ -221,6 +361,19 @@ typedef struct {
 
   // Parser state flags.
   uint8_t state;
+
+  // Slots that blocks and inline elements can be created in.
+  Slot *free_slots;
+
+#ifdef TREE_SITTER_DJOT_ARENA
+  Arena arena;
+#endif
+
+  // The stacks and their elements start out here, so a scanner is a single
+  // allocation until the stacks grow past `SCANNER_STACK_SIZE`.
+  Block *block_buffer[SCANNER_STACK_SIZE];
+  Inline *inline_buffer[SCANNER_STACK_SIZE];
+  Slot slots[2 * SCANNER_STACK_SIZE];
 } Scanner;
 
 // Tracks if a `[` starts an inline link.
@@ -233,6 +386,11 @@ static const uint8_t STATE_BRACKET_STARTS_INLINE_LINK = 1 << 0;
 static const uint8_t STATE_BRACKET_STARTS_SPAN = 1 << 1;
 // Tracks if the next table row is a separator row.
 static const uint8_t STATE_TABLE_SEPARATOR_NEXT = 1 << 2;
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+// Tracks if we skipped to a blank line since the last token, so that
+// recovery gets a chance to pick up after it.
+static const uint8_t STATE_ERROR_SKIPPED = 1 << 3;
+#endif
 
 static TokenType scan_list_marker_token(Scanner *s, TSLexer *lexer);
 static TokenType scan_unordered_list_marker_token(Scanner *s, TSLexer *lexer);
@@ -373,31 +531,238 @@ static uint8_t consume_whitespace(Scanner *s, TSLexer *lexer) {
   return indent;
 }
 
-static Block *create_block(BlockType type, uint8_t data) {
-  Block *b = ts_malloc(sizeof(Block));
+// What an allocation of the scanner is for.
+typedef enum {
+  ALLOC_SCANNER,
+  ALLOC_BLOCK,
+  ALLOC_INLINE,
+  ALLOC_STACK,
+  ALLOC_SITE_COUNT,
+} AllocSite;
+
+#ifdef TREE_SITTER_DJOT_MEMORY_STATS
+// Shared by all scanners, which may be on different threads.
+static struct {
+  atomic_size_t live_bytes;
+  atomic_size_t peak_bytes;
+  atomic_size_t allocations[ALLOC_SITE_COUNT];
+  atomic_size_t frees;
+} memory_stats;
+
+// Keeps the memory after it aligned like `malloc` does.
+typedef union {
+  size_t size;
+  max_align_t align;
+} AllocHeader;
+
+static void count_bytes(size_t added, size_t removed) {
+  if (added < removed) {
+    atomic_fetch_sub_explicit(&memory_stats.live_bytes, removed - added,
+                              memory_order_relaxed);
+    return;
+  }
+  size_t live = atomic_fetch_add_explicit(&memory_stats.live_bytes,
+                                          added - removed,
+                                          memory_order_relaxed) +
+                added - removed;
+  size_t peak =
+      atomic_load_explicit(&memory_stats.peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&memory_stats.peak_bytes,
+                                                &peak, live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+static void *scanner_malloc(size_t size, AllocSite site) {
+  AllocHeader *header = ts_malloc(sizeof(AllocHeader) + size);
+  header->size = size;
+  atomic_fetch_add_explicit(&memory_stats.allocations[site], 1,
+                            memory_order_relaxed);
+  count_bytes(size, 0);
+  return header + 1;
+}
+
+#ifndef TREE_SITTER_DJOT_ARENA
+// The arena never reallocates, since stacks grow into new slots.
+static void *scanner_realloc(void *ptr, size_t size, AllocSite site) {
+  AllocHeader *header = (AllocHeader *)ptr - 1;
+  size_t old_size = header->size;
+  header = ts_realloc(header, sizeof(AllocHeader) + size);
+  header->size = size;
+  atomic_fetch_add_explicit(&memory_stats.allocations[site], 1,
+                            memory_order_relaxed);
+  count_bytes(size, old_size);
+  return header + 1;
+}
+#endif
+
+static void scanner_free(void *ptr) {
+  AllocHeader *header = (AllocHeader *)ptr - 1;
+  atomic_fetch_add_explicit(&memory_stats.frees, 1, memory_order_relaxed);
+  count_bytes(0, header->size);
+  ts_free(header);
+}
+
+void tree_sitter_djot_scanner_memory_stats(TSDjotScannerMemoryStats *stats) {
+  stats->live_bytes =
+      atomic_load_explicit(&memory_stats.live_bytes, memory_order_relaxed);
+  stats->peak_bytes =
+      atomic_load_explicit(&memory_stats.peak_bytes, memory_order_relaxed);
+  stats->scanner_allocations = atomic_load_explicit(
+      &memory_stats.allocations[ALLOC_SCANNER], memory_order_relaxed);
+  stats->block_allocations = atomic_load_explicit(
+      &memory_stats.allocations[ALLOC_BLOCK], memory_order_relaxed);
+  stats->inline_allocations = atomic_load_explicit(
+      &memory_stats.allocations[ALLOC_INLINE], memory_order_relaxed);
+  stats->stack_allocations = atomic_load_explicit(
+      &memory_stats.allocations[ALLOC_STACK], memory_order_relaxed);
+  stats->frees = atomic_load_explicit(&memory_stats.frees, memory_order_relaxed);
+}
+
+void tree_sitter_djot_scanner_memory_stats_reset(void) {
+  size_t live =
+      atomic_load_explicit(&memory_stats.live_bytes, memory_order_relaxed);
+  atomic_store_explicit(&memory_stats.peak_bytes, live, memory_order_relaxed);
+  for (int i = 0; i < ALLOC_SITE_COUNT; ++i) {
+    atomic_store_explicit(&memory_stats.allocations[i], 0,
+                          memory_order_relaxed);
+  }
+  atomic_store_explicit(&memory_stats.frees, 0, memory_order_relaxed);
+}
+#else
+#define scanner_malloc(size, site) ((void)(site), ts_malloc(size))
+#define scanner_realloc(ptr, size, site) ((void)(site), ts_realloc(ptr, size))
+#define scanner_free(ptr) ts_free(ptr)
+#endif
+
+#ifdef TREE_SITTER_DJOT_ARENA
+// Take `count` consecutive slots, from a new slab if the current one is full.
+static void *arena_alloc(Arena *arena, uint32_t count, AllocSite site) {
+  if (!arena->slabs || arena->slabs->capacity - arena->used < count) {
+    uint32_t capacity =
+        arena->slabs ? arena->slabs->capacity * 2 : ARENA_FIRST_SLAB_SLOTS;
+    if (capacity < count) {
+      capacity = count;
+    }
+    Slab *slab = scanner_malloc(sizeof(Slab) + capacity * sizeof(Slot), site);
+    slab->next = arena->slabs;
+    slab->capacity = capacity;
+    arena->slabs = slab;
+    arena->used = 0;
+  }
+  Slot *slots = &arena->slabs->slots[arena->used];
+  arena->used += count;
+  return slots;
+}
+
+static void arena_delete(Arena *arena) {
+  while (arena->slabs) {
+    Slab *next = arena->slabs->next;
+    scanner_free(arena->slabs);
+    arena->slabs = next;
+  }
+}
+#endif
+
+static void *alloc_slot(Scanner *s, AllocSite site) {
+  if (s->free_slots) {
+    Slot *slot = s->free_slots;
+    s->free_slots = slot->next_free;
+    return slot;
+  }
+#ifdef TREE_SITTER_DJOT_ARENA
+  return arena_alloc(&s->arena, 1, site);
+#else
+  return scanner_malloc(sizeof(Slot), site);
+#endif
+}
+
+static void free_slot(Scanner *s, void *ptr) {
+  Slot *slot = ptr;
+#ifndef TREE_SITTER_DJOT_ARENA
+  // Without an arena only the slots inside the scanner are reused.
+  if (slot < s->slots || slot >= s->slots + 2 * SCANNER_STACK_SIZE) {
+    scanner_free(slot);
+    return;
+  }
+#endif
+  slot->next_free = s->free_slots;
+  s->free_slots = slot;
+}
+
+// Double the capacity of a stack, moving it out of its buffer inside the
+// scanner if needed. `array_grow` would try to `realloc` the buffer.
+static void grow_stack(Scanner *s, void **contents, uint32_t *capacity,
+                       size_t element_size, const void *buffer) {
+  uint32_t new_capacity = *capacity * 2;
+#ifdef TREE_SITTER_DJOT_ARENA
+  // Stacks hold pointers, which fit in a slot each. The slots of the old
+  // stack are free for blocks and inline elements after the move.
+  uint32_t slots =
+      (uint32_t)((new_capacity * element_size + sizeof(Slot) - 1) /
+                 sizeof(Slot));
+  void *grown = arena_alloc(&s->arena, slots, ALLOC_STACK);
+  memcpy(grown, *contents, *capacity * element_size);
+  if (*contents != buffer) {
+    Slot *old = *contents;
+    for (uint32_t i = 0; i < *capacity * element_size / sizeof(Slot); ++i) {
+      old[i].next_free = s->free_slots;
+      s->free_slots = &old[i];
+    }
+  }
+  *contents = grown;
+#else
+  (void)s;
+  if (*contents == buffer) {
+    void *heap = scanner_malloc(new_capacity * element_size, ALLOC_STACK);
+    memcpy(heap, *contents, *capacity * element_size);
+    *contents = heap;
+  } else {
+    *contents =
+        scanner_realloc(*contents, new_capacity * element_size, ALLOC_STACK);
+  }
+#endif
+  *capacity = new_capacity;
+}
+
+#define stack_push(s, self, buffer, element)                                   \
+  do {                                                                         \
+    if ((self)->size == (self)->capacity) {                                    \
+      grow_stack((s), (void **)&(self)->contents, &(self)->capacity,           \
+                 sizeof(*(self)->contents), (buffer));                         \
+    }                                                                          \
+    (self)->contents[(self)->size++] = (element);                              \
+  } while (0)
+
+static Block *create_block(Scanner *s, BlockType type, uint8_t data) {
+  Block *b = alloc_slot(s, ALLOC_BLOCK);
   b->type = type;
   b->data = data;
   return b;
 }
 
-static Inline *create_inline(InlineType type, uint8_t data) {
-  Inline *res = ts_malloc(sizeof(Inline));
+static Inline *create_inline(Scanner *s, InlineType type, uint8_t data) {
+  Inline *res = alloc_slot(s, ALLOC_INLINE);
   res->type = type;
   res->data = data;
   return res;
 }
 
 static void push_block(Scanner *s, BlockType type, uint8_t data) {
-  array_push(s->open_blocks, create_block(type, data));
+  stack_push(s, &s->open_blocks, s->block_buffer,
+             create_block(s, type, data));
 }
 
 static void push_inline(Scanner *s, InlineType type, uint8_t data) {
-  array_push(s->open_inline, create_inline(type, data));
+  stack_push(s, &s->open_inline, s->inline_buffer,
+             create_inline(s, type, data));
 }
 
 static void remove_block(Scanner *s) {
-  if (s->open_blocks->size > 0) {
-    ts_free(array_pop(s->open_blocks));
+  if (s->open_blocks.size > 0) {
+    free_slot(s, array_pop(&s->open_blocks));
     if (s->blocks_to_close > 0) {
       --s->blocks_to_close;
     }
@@ -405,22 +770,22 @@ static void remove_block(Scanner *s) {
 }
 
 static void remove_inline(Scanner *s) {
-  if (s->open_inline->size > 0) {
-    ts_free(array_pop(s->open_inline));
+  if (s->open_inline.size > 0) {
+    free_slot(s, array_pop(&s->open_inline));
   }
 }
 
 static Block *peek_block(Scanner *s) {
-  if (s->open_blocks->size > 0) {
-    return *array_back(s->open_blocks);
+  if (s->open_blocks.size > 0) {
+    return *array_back(&s->open_blocks);
   } else {
     return NULL;
   }
 }
 
 static Inline *peek_inline(Scanner *s) {
-  if (s->open_inline->size > 0) {
-    return *array_back(s->open_inline);
+  if (s->open_inline.size > 0) {
+    return *array_back(&s->open_inline);
   } else {
     return NULL;
   }
@@ -444,18 +809,18 @@ static bool disallow_newline(Block *top) {
 // If it cannot be found, returns 0.
 static size_t number_of_blocks_from_top(Scanner *s, BlockType type,
                                         uint8_t level) {
-  for (int i = s->open_blocks->size - 1; i >= 0; --i) {
-    Block *b = *array_get(s->open_blocks, i);
+  for (int i = s->open_blocks.size - 1; i >= 0; --i) {
+    Block *b = *array_get(&s->open_blocks, i);
     if (b->type == type && b->data == level) {
-      return s->open_blocks->size - i;
+      return s->open_blocks.size - i;
     }
   }
   return 0;
 }
 
 static Block *find_block(Scanner *s, BlockType type) {
-  for (int i = s->open_blocks->size - 1; i >= 0; --i) {
-    Block *b = *array_get(s->open_blocks, i);
+  for (int i = s->open_blocks.size - 1; i >= 0; --i) {
+    Block *b = *array_get(&s->open_blocks, i);
     if (b->type == type) {
       return b;
     }
@@ -464,8 +829,8 @@ static Block *find_block(Scanner *s, BlockType type) {
 }
 
 static Block *find_list(Scanner *s) {
-  for (int i = s->open_blocks->size - 1; i >= 0; --i) {
-    Block *b = *array_get(s->open_blocks, i);
+  for (int i = s->open_blocks.size - 1; i >= 0; --i) {
+    Block *b = *array_get(&s->open_blocks, i);
     if (is_list(b->type)) {
       return b;
     }
@@ -475,8 +840,8 @@ static Block *find_list(Scanner *s) {
 
 static uint8_t count_blocks(Scanner *s, BlockType type) {
   uint8_t count = 0;
-  for (int i = s->open_blocks->size - 1; i >= 0; --i) {
-    Block *b = *array_get(s->open_blocks, i);
+  for (int i = s->open_blocks.size - 1; i >= 0; --i) {
+    Block *b = *array_get(&s->open_blocks, i);
     if (b->type == type) {
       ++count;
     }
@@ -489,9 +854,9 @@ static uint8_t count_blocks(Scanner *s, BlockType type) {
 // the other are emitted in `handle_blocks_to_close`.
 static void close_blocks(Scanner *s, TSLexer *lexer, size_t count) {
 #ifdef DEBUG
-  assert(s->open_blocks->size > 0);
+  assert(s->open_blocks.size > 0);
 #endif
-  if (s->open_blocks->size > 0) {
+  if (s->open_blocks.size > 0) {
     remove_block(s);
     s->blocks_to_close = s->blocks_to_close + count - 1;
   }
@@ -500,7 +865,7 @@ static void close_blocks(Scanner *s, TSLexer *lexer, size_t count) {
 
 // Output BLOCK_CLOSE tokens, delegated from previous iteration.
 static bool handle_blocks_to_close(Scanner *s, TSLexer *lexer) {
-  if (s->open_blocks->size == 0) {
+  if (s->open_blocks.size == 0) {
     return false;
   }
 
@@ -514,11 +879,14 @@ static bool handle_blocks_to_close(Scanner *s, TSLexer *lexer) {
   }
 }
 
+static uint8_t char_classes(int32_t c) {
+  return c >= 0 && c < 256 ? CHAR_CLASSES[c] : 0;
+}
+
 static bool scan_identifier(Scanner *s, TSLexer *lexer) {
   bool any_scanned = false;
   while (!lexer->eof(lexer)) {
-    if (isalnum(lexer->lookahead) || lexer->lookahead == '-' ||
-        lexer->lookahead == '_') {
+    if (char_classes(lexer->lookahead) & CHAR_IDENTIFIER) {
       any_scanned = true;
       advance(s, lexer);
     } else {
@@ -570,12 +938,12 @@ static bool parse_list_item_continuation(Scanner *s, TSLexer *lexer) {
 // They should be closed if indentation is too little.
 static bool close_list_nested_block_if_needed(Scanner *s, TSLexer *lexer,
                                               bool non_newline) {
-  if (s->open_blocks->size == 0) {
+  if (s->open_blocks.size == 0) {
     return false;
   }
 
   // No open inline at block boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -599,7 +967,7 @@ static bool close_list_nested_block_if_needed(Scanner *s, TSLexer *lexer,
 static bool close_different_list_if_needed(Scanner *s, TSLexer *lexer,
                                            Block *list, TokenType list_marker) {
   // No open inline at block boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
   if (list_marker != IGNORED) {
@@ -616,7 +984,7 @@ static bool close_different_list_if_needed(Scanner *s, TSLexer *lexer,
 // Check if we're starting a list of a different type and close the open one.
 static bool try_close_different_typed_list(Scanner *s, TSLexer *lexer,
                                            TokenType ordered_list_marker) {
-  if (s->open_blocks->size == 0) {
+  if (s->open_blocks.size == 0) {
     return false;
   }
 
@@ -680,11 +1048,24 @@ static bool parse_verbatim_content(Scanner *s, TSLexer *lexer) {
     return false;
   }
 
-  while (!lexer->eof(lexer)) {
+  // Only mark the end where the content may stop: before a newline, before
+  // a run of backticks and at the end of the file. Everything before them is
+  // content, and so is everything after them when we don't stop. Until some
+  // content is consumed, the end stays where the scan marked it, before any
+  // carriage return or indentation it skipped.
+  bool consumed = false;
+  for (;;) {
+    bool at_end = lexer->eof(lexer);
+    if (consumed &&
+        (at_end || lexer->lookahead == '\n' || lexer->lookahead == '`')) {
+      lexer->mark_end(lexer);
+    }
+    if (at_end) {
+      break;
+    }
     if (lexer->lookahead == '\n') {
       // We should only end verbatim if the paragraph is ended by a
       // blankline.
-
       // Advance over the first newline.
       advance(s, lexer);
       // Remove any whitespace on the next line.
@@ -693,9 +1074,6 @@ static bool parse_verbatim_content(Scanner *s, TSLexer *lexer) {
         // Found a blankline, meaning the paragraph containing the varbatim
         // should be closed. So now we can close the verbatim.
         break;
-      } else {
-        // No blankline, continue parsing.
-        lexer->mark_end(lexer);
       }
     } else if (lexer->lookahead == '`') {
       // If we find a `, we need to count them to see if we should stop.
@@ -703,16 +1081,12 @@ static bool parse_verbatim_content(Scanner *s, TSLexer *lexer) {
       if (current == top->data) {
         // We found a matching number of `, stop content parsing.
         break;
-      } else {
-        // Found a number of ` that doesn't match the start,
-        // we should consume them.
-        lexer->mark_end(lexer);
       }
+      // Otherwise the ` are part of the content.
     } else {
-      // Non-` token found, this we should consume.
       advance(s, lexer);
-      lexer->mark_end(lexer);
     }
+    consumed = true;
   }
 
   // Scanned all the verbatim.
@@ -883,7 +1257,7 @@ static bool parse_block_quote(Scanner *s, TSLexer *lexer,
   bool has_marker = scan_block_quote_marker(s, lexer, &ending_newline);
 
   // No open inline at block boundary.
-  bool any_open_inline = s->open_inline->size > 0;
+  bool any_open_inline = s->open_inline.size > 0;
 
   // If we have a marker but with an empty line,
   // we need to close the paragraph.
@@ -943,55 +1317,6 @@ static bool parse_block_quote(Scanner *s, TSLexer *lexer,
   return false;
 }
 
-static bool is_decimal(char c) { return '0' <= c && c <= '9'; }
-static bool is_lower_alpha(char c) { return 'a' <= c && c <= 'z'; }
-static bool is_upper_alpha(char c) { return 'A' <= c && c <= 'Z'; }
-static bool is_lower_roman(char c) {
-  switch (c) {
-  case 'i':
-  case 'v':
-  case 'x':
-  case 'l':
-  case 'c':
-  case 'd':
-  case 'm':
-    return true;
-  default:
-    return false;
-  }
-}
-static bool is_upper_roman(char c) {
-  switch (c) {
-  case 'I':
-  case 'V':
-  case 'X':
-  case 'L':
-  case 'C':
-  case 'D':
-  case 'M':
-    return true;
-  default:
-    return false;
-  }
-}
-
-static bool matches_ordered_list(OrderedListType type, char c) {
-  switch (type) {
-  case DECIMAL:
-    return is_decimal(c);
-  case LOWER_ALPHA:
-    return is_lower_alpha(c);
-  case UPPER_ALPHA:
-    return is_upper_alpha(c);
-  case LOWER_ROMAN:
-    return is_lower_roman(c);
-  case UPPER_ROMAN:
-    return is_upper_roman(c);
-  default:
-    return false;
-  }
-}
-
 static bool single_letter_list_marker(OrderedListType type) {
   switch (type) {
   case LOWER_ALPHA:
@@ -1004,65 +1329,32 @@ static bool single_letter_list_marker(OrderedListType type) {
 
 static bool scan_ordered_list_type(Scanner *s, TSLexer *lexer,
                                    OrderedListType *res) {
-  bool can_be_decimal = true;
-  uint8_t scanned_decimal = 0;
-  bool can_be_lower_roman = true;
-  uint8_t scanned_lower_roman = 0;
-  bool can_be_upper_roman = true;
-  uint8_t scanned_upper_roman = 0;
-  bool can_be_lower_alpha = true;
-  uint8_t scanned_lower_alpha = 0;
-  bool can_be_upper_alpha = true;
-  uint8_t scanned_upper_alpha = 0;
-
-  uint8_t scanned = 0;
-  while (!lexer->eof(lexer)) {
-    char c = lexer->lookahead;
+  // The list types that all characters scanned so far are valid for.
+  uint8_t candidates = ORDERED_LIST_CHARS;
+  // The list types that matched the first and the first two characters.
+  // It's all we need to know if a type matched at all or only matched a single
+  // character.
+  uint8_t first = 0;
+  uint8_t second = 0;
 
-    if (can_be_decimal) {
-      if (matches_ordered_list(DECIMAL, c)) {
-        ++scanned_decimal;
-      } else {
-        can_be_decimal = false;
-      }
-    }
-    if (can_be_lower_roman) {
-      if (matches_ordered_list(LOWER_ROMAN, c)) {
-        ++scanned_lower_roman;
-      } else {
-        can_be_lower_roman = false;
-      }
-    }
-    if (can_be_upper_roman) {
-      if (matches_ordered_list(UPPER_ROMAN, c)) {
-        ++scanned_upper_roman;
-      } else {
-        can_be_upper_roman = false;
-      }
-    }
-    if (can_be_lower_alpha) {
-      if (matches_ordered_list(LOWER_ALPHA, c)) {
-        ++scanned_lower_alpha;
-      } else {
-        can_be_lower_alpha = false;
-      }
-    }
-    if (can_be_upper_alpha) {
-      if (matches_ordered_list(UPPER_ALPHA, c)) {
-        ++scanned_upper_alpha;
-      } else {
-        can_be_upper_alpha = false;
-      }
-    }
-    if (!can_be_decimal && !can_be_lower_roman && !can_be_upper_roman &&
-        !can_be_lower_alpha && !can_be_upper_alpha) {
+  while (!lexer->eof(lexer)) {
+    uint8_t matching = candidates & char_classes(lexer->lookahead);
+    if (!matching) {
       break;
     }
+    if (!first) {
+      first = matching;
+    } else if (!second) {
+      second = matching;
+    }
+    candidates = matching;
 
     advance(s, lexer);
   }
 
-  if (scanned_decimal > 0) {
+  uint8_t single = first & ~second;
+
+  if (first & CHAR_DECIMAL) {
     *res = DECIMAL;
     return true;
   }
@@ -1075,31 +1367,31 @@ static bool scan_ordered_list_type(Scanner *s, TSLexer *lexer,
 
   if (inside_alpha_list) {
     // Alpha lists are only a single letter wide.
-    if (scanned_lower_alpha == 1) {
+    if (single & CHAR_LOWER_ALPHA) {
       *res = LOWER_ALPHA;
       return true;
     }
-    if (scanned_upper_alpha == 1) {
+    if (single & CHAR_UPPER_ALPHA) {
       *res = UPPER_ALPHA;
       return true;
     }
   }
 
   // Note that we don't check if marker is a valid roman numeral.
-  if (scanned_lower_roman > 0) {
+  if (first & CHAR_LOWER_ROMAN) {
     *res = LOWER_ROMAN;
     return true;
   }
-  if (scanned_upper_roman > 0) {
+  if (first & CHAR_UPPER_ROMAN) {
     *res = UPPER_ROMAN;
     return true;
   }
 
-  if (scanned_lower_alpha == 1) {
+  if (single & CHAR_LOWER_ALPHA) {
     *res = LOWER_ALPHA;
     return true;
   }
-  if (scanned_upper_alpha == 1) {
+  if (single & CHAR_UPPER_ALPHA) {
     *res = UPPER_ALPHA;
     return true;
   }
@@ -1480,7 +1772,7 @@ static bool parse_link_ref_def_label_end(Scanner *s, TSLexer *lexer) {
   }
 
   // Prevent inline from reaching outside of the link label.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -1619,7 +1911,7 @@ static bool parse_list_item_end(Scanner *s, TSLexer *lexer,
   }
 
   // No open inline at block boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -1633,7 +1925,7 @@ static bool parse_list_item_end(Scanner *s, TSLexer *lexer,
   // If we should end the `a` list item we need to be able to scan `- b`
   // later in this function.
   // But first we need to skip the `> ` tokens.
-  bool ending_newline;
+  bool ending_newline = false;
   uint8_t block_quote_markers =
       scan_block_quote_markers(s, lexer, &ending_newline);
 
@@ -1769,7 +2061,7 @@ static bool parse_colon(Scanner *s, TSLexer *lexer, const bool *valid_symbols) {
   }
 
   // Don't let inline escape block boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -1819,7 +2111,7 @@ static bool parse_heading(Scanner *s, TSLexer *lexer,
     }
 
     if (valid_symbols[BLOCK_CLOSE] && top_heading && top->data != hash_count &&
-        s->open_inline->size == 0) {
+        s->open_inline.size == 0) {
       // Found a mismatched heading level, need to close the previous
       // before opening this one.
       lexer->result_symbol = BLOCK_CLOSE;
@@ -1883,7 +2175,7 @@ static bool parse_footnote_end(Scanner *s, TSLexer *lexer) {
   }
 
   // Don't let inline escape boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -2078,7 +2370,7 @@ static bool parse_table_cell_end(Scanner *s, TSLexer *lexer) {
     return false;
   }
   // Can only close a cell (or row) if all inline spans have been closed.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -2116,7 +2408,7 @@ static bool parse_table_caption_end(Scanner *s, TSLexer *lexer) {
     return false;
   }
   // Don't let inline escape caption.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -2298,7 +2590,7 @@ static bool end_paragraph_in_block_quote(Scanner *s, TSLexer *lexer) {
   }
 
   // Scan all `> ` markers we can find.
-  bool ending_newline;
+  bool ending_newline = false;
   uint8_t marker_count = scan_block_quote_markers(s, lexer, &ending_newline);
 
   // No blockquote marker.
@@ -2362,7 +2654,7 @@ static bool close_paragraph(Scanner *s, TSLexer *lexer) {
 
 static bool parse_close_paragraph(Scanner *s, TSLexer *lexer) {
   // No open inline at paragraph boundary.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
   if (!close_paragraph(s, lexer)) {
@@ -2464,7 +2756,7 @@ static bool parse_newline(Scanner *s, TSLexer *lexer,
   }
 
   // Only allow `NEWLINE_INLINE` style of newlines with open inline elements.
-  if (s->open_inline->size > 0) {
+  if (s->open_inline.size > 0) {
     return false;
   }
 
@@ -2609,8 +2901,8 @@ static char inline_marker(InlineType type) {
 }
 
 static Inline *find_inline(Scanner *s, InlineType type) {
-  for (int i = s->open_inline->size - 1; i >= 0; --i) {
-    Inline *e = *array_get(s->open_inline, i);
+  for (int i = s->open_inline.size - 1; i >= 0; --i) {
+    Inline *e = *array_get(&s->open_inline, i);
     if (e->type == type) {
       return e;
     }
@@ -2903,6 +3195,33 @@ static bool check_non_whitespace(Scanner *s, TSLexer *lexer) {
   }
 }
 
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+// Consume up to the end of the last line before the next blank line, or to
+// the end of the file. `ERROR` is never valid, so the parser skips all of it
+// at once and tries to recover from the blank line.
+static bool skip_to_blank_line(Scanner *s, TSLexer *lexer) {
+  if (lexer->eof(lexer) || lexer->lookahead == '\n') {
+    return false;
+  }
+  while (!lexer->eof(lexer)) {
+    if (lexer->lookahead != '\n') {
+      advance(s, lexer);
+      continue;
+    }
+    lexer->mark_end(lexer);
+    advance(s, lexer);
+    while (lexer->lookahead == ' ' || lexer->lookahead == '\t') {
+      advance(s, lexer);
+    }
+    if (lexer->eof(lexer) || lexer->lookahead == '\n') {
+      return true;
+    }
+  }
+  lexer->mark_end(lexer);
+  return true;
+}
+#endif
+
 bool tree_sitter_djot_external_scanner_scan(void *payload, TSLexer *lexer,
                                             const bool *valid_symbols) {
   Scanner *s = (Scanner *)payload;
@@ -2938,10 +3257,20 @@ bool tree_sitter_djot_external_scanner_scan(void *payload, TSLexer *lexer,
   printf("---\n");
 #endif
 
+  // Every symbol is valid during error recovery. Tree-sitter usually ignores
+  // empty tokens then, and lexes the next token itself.
   if (valid_symbols[ERROR]) {
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+    if (!(s->state & STATE_ERROR_SKIPPED) && skip_to_blank_line(s, lexer)) {
+      s->state |= STATE_ERROR_SKIPPED;
+    }
+#endif
     lexer->result_symbol = ERROR;
     return true;
   }
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+  s->state &= ~STATE_ERROR_SKIPPED;
+#endif
 
   if (valid_symbols[BLOCK_CLOSE] && handle_blocks_to_close(s, lexer)) {
     return true;
@@ -2952,7 +3281,19 @@ bool tree_sitter_djot_external_scanner_scan(void *payload, TSLexer *lexer,
   assert(s->blocks_to_close == 0);
 #else
   if (s->blocks_to_close > 0) {
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+    // Give up on the pending closes, or every token after this would fail
+    // too, and report a single error to recover from. The abandoned blocks
+    // are dropped so that later closes and indents aren't decided by them.
+    while (s->blocks_to_close > 0 && s->open_blocks.size > 0) {
+      remove_block(s);
+    }
+    s->blocks_to_close = 0;
+    lexer->result_symbol = ERROR;
+    return true;
+#else
     return ERROR;
+#endif
   }
 #endif
 
@@ -3138,9 +3479,16 @@ bool tree_sitter_djot_external_scanner_scan(void *payload, TSLexer *lexer,
   return false;
 }
 
-static void init(Scanner *s) {
-  array_init(s->open_inline);
-  array_init(s->open_blocks);
+// Close everything, but keep the memory of the stacks around for reuse.
+static void reset(Scanner *s) {
+  for (size_t i = 0; i < s->open_blocks.size; ++i) {
+    free_slot(s, *array_get(&s->open_blocks, i));
+  }
+  array_clear(&s->open_blocks);
+  for (size_t i = 0; i < s->open_inline.size; ++i) {
+    free_slot(s, *array_get(&s->open_inline, i));
+  }
+  array_clear(&s->open_inline);
   s->blocks_to_close = 0;
   s->block_quote_level = 0;
   s->indent = 0;
@@ -3148,24 +3496,42 @@ static void init(Scanner *s) {
 }
 
 void *tree_sitter_djot_external_scanner_create() {
-  Scanner *s = (Scanner *)ts_malloc(sizeof(Scanner));
-  s->open_blocks = ts_malloc(sizeof(Array(Block *)));
-  s->open_inline = ts_malloc(sizeof(Array(Inline *)));
-  init(s);
+  Scanner *s = (Scanner *)scanner_malloc(sizeof(Scanner), ALLOC_SCANNER);
+  s->open_blocks.contents = s->block_buffer;
+  s->open_blocks.size = 0;
+  s->open_blocks.capacity = SCANNER_STACK_SIZE;
+  s->open_inline.contents = s->inline_buffer;
+  s->open_inline.size = 0;
+  s->open_inline.capacity = SCANNER_STACK_SIZE;
+
+  s->free_slots = NULL;
+  for (int i = 2 * SCANNER_STACK_SIZE - 1; i >= 0; --i) {
+    s->slots[i].next_free = s->free_slots;
+    s->free_slots = &s->slots[i];
+  }
+#ifdef TREE_SITTER_DJOT_ARENA
+  s->arena = (Arena){NULL, 0};
+#endif
+
+  reset(s);
   return s;
 }
 
 void tree_sitter_djot_external_scanner_destroy(void *payload) {
   Scanner *s = (Scanner *)payload;
-  for (size_t i = 0; i < s->open_blocks->size; ++i) {
-    ts_free(*array_get(s->open_blocks, i));
+#ifdef TREE_SITTER_DJOT_ARENA
+  // Everything in the arena goes at once, the stacks included.
+  arena_delete(&s->arena);
+#else
+  reset(s);
+  if (s->open_blocks.contents != s->block_buffer) {
+    scanner_free(s->open_blocks.contents);
   }
-  array_delete(s->open_blocks);
-  for (size_t i = 0; i < s->open_inline->size; ++i) {
-    ts_free(*array_get(s->open_inline, i));
+  if (s->open_inline.contents != s->inline_buffer) {
+    scanner_free(s->open_inline.contents);
   }
-  array_delete(s->open_inline);
-  ts_free(s);
+#endif
+  scanner_free(s);
 }
 
 unsigned tree_sitter_djot_external_scanner_serialize(void *payload,
@@ -3177,15 +3543,15 @@ unsigned tree_sitter_djot_external_scanner_serialize(void *payload,
   buffer[size++] = (char)s->indent;
   buffer[size++] = (char)s->state;
 
-  buffer[size++] = (char)s->open_blocks->size;
-  for (size_t i = 0; i < s->open_blocks->size; ++i) {
-    Block *b = *array_get(s->open_blocks, i);
+  buffer[size++] = (char)s->open_blocks.size;
+  for (size_t i = 0; i < s->open_blocks.size; ++i) {
+    Block *b = *array_get(&s->open_blocks, i);
     buffer[size++] = (char)b->type;
     buffer[size++] = (char)b->data;
   }
 
-  for (size_t i = 0; i < s->open_inline->size; ++i) {
-    Inline *x = *array_get(s->open_inline, i);
+  for (size_t i = 0; i < s->open_inline.size; ++i) {
+    Inline *x = *array_get(&s->open_inline, i);
     buffer[size++] = (char)x->type;
     buffer[size++] = (char)x->data;
   }
@@ -3196,7 +3562,7 @@ unsigned tree_sitter_djot_external_scanner_serialize(void *payload,
 void tree_sitter_djot_external_scanner_deserialize(void *payload, char *buffer,
                                                    unsigned length) {
   Scanner *s = (Scanner *)payload;
-  init(s);
+  reset(s);
   if (length > 0) {
     size_t size = 0;
     s->blocks_to_close = (uint8_t)buffer[size++];
@@ -3208,12 +3574,12 @@ void tree_sitter_djot_external_scanner_deserialize(void *payload, char *buffer,
     while (open_blocks-- > 0) {
       BlockType type = (BlockType)buffer[size++];
       uint8_t level = (uint8_t)buffer[size++];
-      array_push(s->open_blocks, create_block(type, level));
+      push_block(s, type, level);
     }
     while (size < length) {
       InlineType type = (InlineType)buffer[size++];
       uint8_t data = (uint8_t)buffer[size++];
-      array_push(s->open_inline, create_inline(type, data));
+      push_inline(s, type, data);
     }
   }
 }
@@ -3492,23 +3858,23 @@ static char *inline_type_s(InlineType t) {
 }
 
 static void dump_scanner(Scanner *s) {
-  if (s->open_blocks->size == 0) {
+  if (s->open_blocks.size == 0) {
     printf("0 open blocks\n");
   } else {
 
-    printf("--- Open blocks: %u (last -> first)\n", s->open_blocks->size);
-    for (size_t i = 0; i < s->open_blocks->size; ++i) {
-      Block *b = *array_get(s->open_blocks, i);
+    printf("--- Open blocks: %u (last -> first)\n", s->open_blocks.size);
+    for (size_t i = 0; i < s->open_blocks.size; ++i) {
+      Block *b = *array_get(&s->open_blocks, i);
       printf("  %d %s\n", b->data, block_type_s(b->type));
     }
     printf("---\n");
   }
-  if (s->open_inline->size == 0) {
+  if (s->open_inline.size == 0) {
     printf("0 open inline\n");
   } else {
-    printf("--- Open inline: %u (last -> first)\n", s->open_inline->size);
-    for (size_t i = 0; i < s->open_inline->size; ++i) {
-      Inline *x = *array_get(s->open_inline, i);
+    printf("--- Open inline: %u (last -> first)\n", s->open_inline.size);
+    for (size_t i = 0; i < s->open_inline.size; ++i) {
+      Inline *x = *array_get(&s->open_inline, i);
       printf("  %d %s\n", x->data, inline_type_s(x->type));
     }
     printf("---\n");
@@ -0,0 +1,172 @@
+// Tests of the line scan of `lib/lines.c` against a plain loop over the bytes.
+//
+// Usage: lines [-n DOCUMENTS] [-s SEED]
+//
+// Random documents of pieces with newlines, indentation, carriage returns and
+// block markers are scanned from random line starts, with the SIMD search
+// and with `memchr`, at every alignment of the buffer. The lines, and the
+// index of `tree_sitter_djot_lines`, must be the ones the loop finds.
+// Run `make test-lines` to build this and run it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../lib/lines.c"
+#include <stdio.h>
+#include <unistd.h>
+
+static const char *const PIECES[] = {
+    "\n",  "\n\n", " ",     "  ",   "\t",     "\r\n", "# ",    "> ",
+    "- ",  "1. ",  "```\n", ":::",  "[a]: ",  "|",    "word ", "text",
+    "*",   "+",    "`",     "a. b", "      ", "{.c}", "\\",    "é",
+};
+
+#define PIECE_COUNT (sizeof(PIECES) / sizeof(PIECES[0]))
+
+// Larger than a batch, so documents cross batches.
+#define MAX_LENGTH (3 * LINE_BATCH_SIZE)
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint32_t random_below(uint32_t n) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return (uint32_t)(state % n);
+}
+
+static int failures;
+
+static void fail(const char *what, const char *string, uint32_t length,
+                 uint32_t position) {
+  if (++failures <= 3) {
+    fprintf(stderr, "%s differ from %u in:\n%.*s\n", what, position,
+            (int)length, string);
+  }
+}
+
+// The lines of `string` from `position`, one byte at a time.
+static uint32_t expected_lines(const char *string, uint32_t length,
+                               uint32_t position, ScannedLine *lines) {
+  uint32_t count = 0;
+  while (position < length) {
+    ScannedLine line = {.start = position};
+    uint32_t end = position;
+    while (end < length && string[end] != '\n') {
+      ++end;
+    }
+    line.end = end;
+    line.content = position;
+    while (line.content < end &&
+           (string[line.content] == ' ' || string[line.content] == '\t' ||
+            string[line.content] == '\r')) {
+      ++line.content;
+    }
+    lines[count++] = line;
+    position = end + 1;
+  }
+  return count;
+}
+
+static void check_scan(const char *string, uint32_t length, uint32_t position,
+                       const ScannedLine *expected, uint32_t count,
+                       bool portable) {
+  LineScanner s;
+  line_scanner_init(&s, string, length, position);
+  if (portable) {
+    s.scan_block = NULL;
+  }
+  ScannedLine line;
+  uint32_t i = 0;
+  while (line_scanner_next(&s, &line)) {
+    if (i == count || line.start != expected[i].start ||
+        line.content != expected[i].content || line.end != expected[i].end) {
+      fail(portable ? "memchr lines" : "lines", string, length, position);
+      return;
+    }
+    ++i;
+  }
+  if (i != count) {
+    fail(portable ? "memchr lines" : "lines", string, length, position);
+  }
+}
+
+static void check_index(const char *string, uint32_t length,
+                        const ScannedLine *expected, uint32_t count) {
+  uint32_t index_count;
+  TSDjotLine *index = tree_sitter_djot_lines(string, length, &index_count);
+  bool same = index_count == count;
+  for (uint32_t i = 0; same && i < count; ++i) {
+    const ScannedLine *line = &expected[i];
+    bool blank = line->content == line->end;
+    char first = blank ? 0 : string[line->content];
+    uint8_t kind = blank ? TSDjotLineBlank
+                   : MARKERS[(uint8_t)first] ? TSDjotLineMarker
+                                             : TSDjotLineText;
+    same = index[i].start_byte == line->start &&
+           index[i].indent == line->content - line->start &&
+           index[i].first == first && index[i].kind == kind;
+  }
+  if (!same) {
+    fail("index", string, length, 0);
+  }
+  free(index);
+}
+
+int main(int argc, char **argv) {
+  int documents = 20000;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+    switch (opt) {
+    case 'n':
+      documents = atoi(optarg);
+      break;
+    case 's':
+      state = strtoull(optarg, NULL, 10) | 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n DOCUMENTS] [-s SEED]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // Room to move the document to every alignment of a block.
+  static char buffer[MAX_LENGTH + BLOCK_SIZE];
+  static char document[MAX_LENGTH];
+  static ScannedLine expected[MAX_LENGTH + 1];
+
+  for (int n = 0; n < documents; ++n) {
+    uint32_t target = random_below(n % 10 == 0 ? MAX_LENGTH : 200);
+    uint32_t length = 0;
+    for (;;) {
+      const char *piece = PIECES[random_below(PIECE_COUNT)];
+      uint32_t piece_length = (uint32_t)strlen(piece);
+      if (length + piece_length > target) {
+        break;
+      }
+      memcpy(document + length, piece, piece_length);
+      length += piece_length;
+    }
+
+    char *string = buffer + random_below(BLOCK_SIZE);
+    memcpy(string, document, length);
+    uint32_t count = expected_lines(string, length, 0, expected);
+    check_index(string, length, expected, count);
+
+    // From the start, and from a random line.
+    uint32_t first = count > 0 ? random_below(count) : 0;
+    uint32_t position = count > 0 ? expected[first].start : 0;
+    check_scan(string, length, 0, expected, count, false);
+    check_scan(string, length, 0, expected, count, true);
+    check_scan(string, length, position, expected + first, count - first,
+               false);
+    check_scan(string, length, position, expected + first, count - first,
+               true);
+  }
+
+  if (failures > 0) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("%d documents scanned\n", documents);
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Tests of the paths of the external scanner that only broken documents
+// reach, which the corpus can't show: the trees of error recovery depend on
+// the tree-sitter version, and `tree-sitter test` builds the scanner without
+// `TREE_SITTER_DJOT_ERROR_RESYNC`. Also the exact ends of verbatim content,
+// which the corpus doesn't show either, since it doesn't print the ranges of
+// nodes.
+//
+// The scanner is driven directly with a lexer over a string, so this needs
+// neither the runtime nor the generated parser. Run `make test-scanner` to
+// run it with and without `TREE_SITTER_DJOT_ERROR_RESYNC`.
+
+#include "../src/scanner.c"
+#include <stdio.h>
+
+typedef struct {
+  TSLexer lexer;
+  const char *input;
+  uint32_t length;
+  uint32_t position;
+  uint32_t column;
+  // Where `mark_end` was last called, the end of the token.
+  uint32_t end;
+} StringLexer;
+
+static void lexer_advance(TSLexer *lexer, bool skip) {
+  (void)skip;
+  StringLexer *l = (StringLexer *)lexer;
+  if (l->position == l->length) {
+    return;
+  }
+  l->column = l->input[l->position] == '\n' ? 0 : l->column + 1;
+  ++l->position;
+  lexer->lookahead = l->position < l->length ? l->input[l->position] : 0;
+}
+
+static void lexer_mark_end(TSLexer *lexer) {
+  StringLexer *l = (StringLexer *)lexer;
+  l->end = l->position;
+}
+
+static uint32_t lexer_get_column(TSLexer *lexer) {
+  return ((StringLexer *)lexer)->column;
+}
+
+static bool lexer_eof(const TSLexer *lexer) {
+  const StringLexer *l = (const StringLexer *)lexer;
+  return l->position == l->length;
+}
+
+// Scan the first token at `position` in `input`.
+static bool scan(Scanner *s, const char *input, uint32_t position,
+                 const bool *valid_symbols, StringLexer *l) {
+  *l = (StringLexer){
+      .lexer =
+          {
+              .advance = lexer_advance,
+              .mark_end = lexer_mark_end,
+              .get_column = lexer_get_column,
+              .eof = lexer_eof,
+          },
+      .input = input,
+      .length = (uint32_t)strlen(input),
+      .position = position,
+  };
+  for (uint32_t i = 0; i < position; ++i) {
+    l->column = input[i] == '\n' ? 0 : l->column + 1;
+  }
+  l->lexer.lookahead = position < l->length ? input[position] : 0;
+  return tree_sitter_djot_external_scanner_scan(s, &l->lexer, valid_symbols);
+}
+
+static int failures;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition);          \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+// With `TREE_SITTER_DJOT_ERROR_RESYNC`, closes that can't be emitted are
+// dropped with a single empty error, together with their blocks.
+static void test_blocks_to_close_fallback(void) {
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+  Scanner *s = tree_sitter_djot_external_scanner_create();
+  push_block(s, DIV, 3);
+  push_block(s, LIST_DASH, 2);
+  push_block(s, LIST_DASH, 4);
+  s->blocks_to_close = 2;
+
+  bool valid_symbols[ERROR + 1] = {false};
+  valid_symbols[NEWLINE] = true;
+  StringLexer l;
+  CHECK(scan(s, "text\n", 0, valid_symbols, &l));
+  CHECK(l.lexer.result_symbol == ERROR);
+  CHECK(l.end == 0);
+  CHECK(s->blocks_to_close == 0);
+  CHECK(s->open_blocks.size == 1);
+  CHECK(peek_block(s)->type == DIV);
+
+  // The remaining block is closed at the end as usual.
+  valid_symbols[BLOCK_CLOSE] = true;
+  CHECK(scan(s, "text\n", 5, valid_symbols, &l));
+  CHECK(l.lexer.result_symbol == BLOCK_CLOSE);
+  CHECK(s->open_blocks.size == 0);
+  tree_sitter_djot_external_scanner_destroy(s);
+#endif
+}
+
+// During error recovery, every symbol is valid.
+static void test_error_recovery(void) {
+  static const char input[] = "A *broken\nparagraph\n  \nAfter.\n";
+  Scanner *s = tree_sitter_djot_external_scanner_create();
+  bool valid_symbols[ERROR + 1];
+  memset(valid_symbols, true, sizeof(valid_symbols));
+  StringLexer l;
+
+  CHECK(scan(s, input, 2, valid_symbols, &l));
+  CHECK(l.lexer.result_symbol == ERROR);
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+  // Skips to the end of the line before the blank line, once.
+  CHECK(l.end == strlen("A *broken\nparagraph"));
+  CHECK(s->state & STATE_ERROR_SKIPPED);
+  CHECK(scan(s, input, l.end, valid_symbols, &l));
+  CHECK(l.lexer.result_symbol == ERROR);
+  CHECK(l.end == strlen("A *broken\nparagraph"));
+
+  // A token outside of recovery allows the next skip.
+  memset(valid_symbols, false, sizeof(valid_symbols));
+  scan(s, input, l.end, valid_symbols, &l);
+  CHECK(!(s->state & STATE_ERROR_SKIPPED));
+#else
+  // Leaves the recovery to tree-sitter.
+  CHECK(l.end == 2);
+#endif
+  tree_sitter_djot_external_scanner_destroy(s);
+}
+
+// Verbatim content ends before the newline of a blank line or the closing
+// backticks. When it stops before anything is consumed, it's empty, without
+// the carriage return or indentation skipped before it.
+static void test_verbatim_content_end(void) {
+  static const struct {
+    const char *input;
+    uint8_t ticks;
+    uint32_t end;
+  } cases[] = {
+      {"code` after", 1, 4},
+      {"a `b` c``", 2, 7},
+      {"a ``b`` c`", 1, 9},
+      {"one\n  two`", 1, 9},
+      {"trailing  \n\nnext", 1, 10},
+      {"open to the end", 1, 15},
+      {"\r\n\nmore", 1, 0},
+      {"  \n\nmore", 1, 0},
+      {"`", 1, 0},
+      {"", 1, 0},
+  };
+  bool valid_symbols[ERROR + 1] = {false};
+  valid_symbols[VERBATIM_CONTENT] = true;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    Scanner *s = tree_sitter_djot_external_scanner_create();
+    push_inline(s, VERBATIM, cases[i].ticks);
+    StringLexer l;
+    CHECK(scan(s, cases[i].input, 0, valid_symbols, &l));
+    CHECK(l.lexer.result_symbol == VERBATIM_CONTENT);
+    if (l.end != cases[i].end) {
+      fprintf(stderr, "verbatim content of \"%s\" ends at %u, not %u\n",
+              cases[i].input, l.end, cases[i].end);
+      ++failures;
+    }
+    tree_sitter_djot_external_scanner_destroy(s);
+  }
+}
+
+int main(void) {
+  test_blocks_to_close_fallback();
+  test_error_recovery();
+  test_verbatim_content_end();
+  if (failures > 0) {
+    return 1;
+  }
+#ifdef TREE_SITTER_DJOT_ERROR_RESYNC
+  printf("scanner tests passed with TREE_SITTER_DJOT_ERROR_RESYNC\n");
+#else
+  printf("scanner tests passed\n");
+#endif
+  return 0;
+}
@@ -0,0 +1,390 @@
+// Tests of the helpers in `lib` on the trees of the parser.
+//
+// Usage: utils [-n EDITS] [-s SEED]
+//
+// A document is edited EDITS times at random places, inserting and removing
+// pieces of Djot that open and close blocks, references and code. After
+// every edit, the tree is parsed again from the edited old tree, and the
+// reference index, the outline and the folds, which are updated from the
+// changed ranges, must be the same as new ones built from the new tree. The
+// injections of a random range must include every injection of the whole
+// document that touches it, and point to identical ones before them. The
+// HTML streamed by `tree_sitter_djot_render_html` must be the same as the
+// string of `tree_sitter_djot_html`.
+// Run `make test-utils` to build this and run it, and add
+// `CFLAGS=-fsanitize=address,undefined` to check the memory accesses too.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tree-sitter-djot-utils.h"
+#include "tree-sitter-djot.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tree_sitter/api.h>
+#include <unistd.h>
+
+static const char INITIAL[] =
+    "# Title\n"
+    "\n"
+    "Some text with a [link][a], a note[^n] and `code`.\n"
+    "\n"
+    "## Lists\n"
+    "\n"
+    "- one\n"
+    "- two [b][]\n"
+    "\n"
+    "  - nested\n"
+    "\n"
+    "```lua\n"
+    "print(1)\n"
+    "```\n"
+    "\n"
+    ":::: note\n"
+    "A div with $`x^2` in it.\n"
+    "::::\n"
+    "\n"
+    "[a]: /a\n"
+    "\n"
+    "[^n]: The note.\n"
+    "\n"
+    "    With more [link][b].\n";
+
+// The pieces that edits insert.
+static const char *const PIECES[] = {
+    "\n",
+    "\n\n",
+    "# ",
+    "## Heading\n",
+    "- ",
+    "1. ",
+    "> ",
+    "[a]",
+    "[b][]",
+    "[text][a]",
+    "[^n]",
+    "[^m]",
+    "\n[a]: /x\n",
+    "\n[^m]: Text\n",
+    "```\n",
+    "``` c\nint x;\n```\n",
+    ":::\n",
+    "::: warning\n",
+    "`raw`{=html}",
+    "$$`e = mc^2`",
+    "{% x %}",
+    "|a|b|\n",
+    "word ",
+    "*strong*",
+    "[^",
+    "[^]",
+    "[",
+    "]",
+    "`",
+    "{",
+};
+
+static const char *const LABELS[] = {"a", "b", "n", "m", "text", "x"};
+
+typedef struct {
+  char *contents;
+  uint32_t length;
+  uint32_t capacity;
+} Text;
+
+static uint64_t random_state;
+
+static uint32_t random_below(uint32_t bound) {
+  // xorshift64*
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (uint32_t)((random_state * 2685821657736338717ull) >> 32) % bound;
+}
+
+static TSPoint point_at(const Text *text, uint32_t byte) {
+  TSPoint point = {0, 0};
+  for (uint32_t i = 0; i < byte; ++i) {
+    if (text->contents[i] == '\n') {
+      ++point.row;
+      point.column = 0;
+    } else {
+      ++point.column;
+    }
+  }
+  return point;
+}
+
+// Replace a random range of `text` with a random piece, or with nothing, and
+// describe the edit.
+static TSInputEdit edit_randomly(Text *text) {
+  uint32_t start = random_below(text->length + 1);
+  uint32_t removed = random_below(4) == 0
+                         ? random_below(text->length - start + 1) % 32
+                         : 0;
+  const char *piece = "";
+  if (removed == 0 || random_below(2) == 0) {
+    piece = PIECES[random_below(sizeof(PIECES) / sizeof(PIECES[0]))];
+  }
+  uint32_t inserted = (uint32_t)strlen(piece);
+
+  TSInputEdit edit = {
+      .start_byte = start,
+      .old_end_byte = start + removed,
+      .new_end_byte = start + inserted,
+      .start_point = point_at(text, start),
+      .old_end_point = point_at(text, start + removed),
+  };
+  uint32_t length = text->length - removed + inserted;
+  if (length > text->capacity) {
+    text->capacity = length * 2;
+    text->contents = realloc(text->contents, text->capacity);
+  }
+  memmove(text->contents + start + inserted, text->contents + start + removed,
+          text->length - start - removed);
+  memcpy(text->contents + start, piece, inserted);
+  text->length = length;
+  edit.new_end_point = point_at(text, start + inserted);
+  return edit;
+}
+
+static bool same_references(TSDjotReferenceIndex *updated,
+                            TSDjotReferenceIndex *built) {
+  uint32_t updated_count;
+  uint32_t built_count;
+  TSDjotReferenceProblem *updated_problems =
+      tree_sitter_djot_reference_index_problems(updated, &updated_count);
+  TSDjotReferenceProblem *built_problems =
+      tree_sitter_djot_reference_index_problems(built, &built_count);
+  bool same = updated_count == built_count &&
+              (updated_count == 0 ||
+               memcmp(updated_problems, built_problems,
+                      updated_count * sizeof(TSDjotReferenceProblem)) == 0);
+  free(updated_problems);
+  free(built_problems);
+
+  for (int kind = TSDjotReferenceLink; kind <= TSDjotReferenceFootnote;
+       ++kind) {
+    for (size_t i = 0; i < sizeof(LABELS) / sizeof(LABELS[0]); ++i) {
+      TSDjotReferenceLabel a = {0};
+      TSDjotReferenceLabel b = {0};
+      bool found_a = tree_sitter_djot_reference_index_lookup(
+          updated, (TSDjotReferenceKind)kind, LABELS[i],
+          (uint32_t)strlen(LABELS[i]), &a);
+      bool found_b = tree_sitter_djot_reference_index_lookup(
+          built, (TSDjotReferenceKind)kind, LABELS[i],
+          (uint32_t)strlen(LABELS[i]), &b);
+      same = same && found_a == found_b && memcmp(&a, &b, sizeof(a)) == 0;
+    }
+  }
+  return same;
+}
+
+static bool same_outline(const TSDjotOutline *updated,
+                         const TSDjotOutline *built) {
+  uint32_t updated_count;
+  uint32_t built_count;
+  const TSDjotHeading *a =
+      tree_sitter_djot_outline_headings(updated, &updated_count);
+  const TSDjotHeading *b =
+      tree_sitter_djot_outline_headings(built, &built_count);
+  return updated_count == built_count &&
+         (updated_count == 0 ||
+          memcmp(a, b, updated_count * sizeof(TSDjotHeading)) == 0);
+}
+
+static bool same_folds(const TSDjotFolds *updated, const TSDjotFolds *built) {
+  uint32_t updated_count;
+  uint32_t built_count;
+  const TSDjotFold *a = tree_sitter_djot_folds_ranges(updated, &updated_count);
+  const TSDjotFold *b = tree_sitter_djot_folds_ranges(built, &built_count);
+  return updated_count == built_count &&
+         (updated_count == 0 ||
+          memcmp(a, b, updated_count * sizeof(TSDjotFold)) == 0);
+}
+
+static bool same_injection(const TSDjotInjection *a, const TSDjotInjection *b) {
+  return a->start_byte == b->start_byte && a->end_byte == b->end_byte &&
+         a->language_length == b->language_length &&
+         memcmp(a->language, b->language, a->language_length) == 0;
+}
+
+static bool check_injections(const TSTree *tree, const Text *text) {
+  uint32_t count;
+  TSDjotInjection *all =
+      tree_sitter_djot_injections(tree, text->contents, 0, UINT32_MAX, &count);
+  bool ok = true;
+  for (uint32_t i = 0; i < count; ++i) {
+    const TSDjotInjection *injection = &all[i];
+    const TSDjotInjection *first = &all[injection->first];
+    uint32_t length = injection->end_byte - injection->start_byte;
+    ok = ok && injection->first <= i &&
+         (i == 0 || all[i - 1].start_byte <= injection->start_byte) &&
+         first->hash == injection->hash &&
+         first->end_byte - first->start_byte == length &&
+         first->language_length == injection->language_length &&
+         memcmp(first->language, injection->language,
+                injection->language_length) == 0 &&
+         memcmp(text->contents + first->start_byte,
+                text->contents + injection->start_byte, length) == 0;
+  }
+
+  uint32_t start = random_below(text->length + 1);
+  uint32_t end = start + random_below(text->length - start + 1);
+  uint32_t range_count;
+  TSDjotInjection *range = tree_sitter_djot_injections(
+      tree, text->contents, start, end, &range_count);
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (all[i].start_byte > end || all[i].end_byte < start) {
+      continue;
+    }
+    while (next < range_count && !same_injection(&range[next], &all[i])) {
+      ++next;
+    }
+    ok = ok && next < range_count;
+  }
+  free(all);
+  free(range);
+  return ok;
+}
+
+static bool append(void *payload, const char *data, size_t length) {
+  Text *html = payload;
+  if (html->length + length > html->capacity) {
+    html->capacity = (uint32_t)(html->length + length) * 2;
+    html->contents = realloc(html->contents, html->capacity);
+  }
+  memcpy(html->contents + html->length, data, length);
+  html->length += (uint32_t)length;
+  return true;
+}
+
+static bool check_html(const TSTree *tree, const Text *text) {
+  size_t length;
+  char *html = tree_sitter_djot_html(tree, text->contents, text->length,
+                                     &length);
+  Text streamed = {0};
+  bool ok = html && tree_sitter_djot_render_html(tree, text->contents,
+                                                 text->length, append,
+                                                 &streamed) &&
+            streamed.length == length &&
+            (length == 0 || memcmp(streamed.contents, html, length) == 0);
+  free(html);
+  free(streamed.contents);
+  return ok;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-n EDITS] [-s SEED]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int edits = 2000;
+  uint64_t seed = 1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+    switch (opt) {
+    case 'n':
+      edits = atoi(optarg);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc || edits < 0 || seed == 0) {
+    usage(argv[0]);
+  }
+  random_state = seed;
+
+  Text text = {.length = sizeof(INITIAL) - 1};
+  text.capacity = text.length * 2;
+  text.contents = malloc(text.capacity);
+  memcpy(text.contents, INITIAL, text.length);
+
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, tree_sitter_djot());
+  TSTree *tree =
+      ts_parser_parse_string(parser, NULL, text.contents, text.length);
+  TSDjotReferenceIndex *index =
+      tree_sitter_djot_reference_index_new(tree, text.contents);
+  TSDjotOutline *outline = tree_sitter_djot_outline_new(tree, text.contents);
+  TSDjotFolds *folds = tree_sitter_djot_folds_new(tree);
+
+  int failures = 0;
+  for (int i = 0; i < edits && failures < 10; ++i) {
+    TSInputEdit edit = edit_randomly(&text);
+    ts_tree_edit(tree, &edit);
+    TSTree *new_tree =
+        ts_parser_parse_string(parser, tree, text.contents, text.length);
+
+    tree_sitter_djot_reference_index_edit(index, &edit);
+    tree_sitter_djot_reference_index_update(index, tree, new_tree,
+                                            text.contents);
+    tree_sitter_djot_outline_edit(outline, &edit);
+    tree_sitter_djot_outline_update(outline, tree, new_tree, text.contents);
+    tree_sitter_djot_folds_edit(folds, &edit);
+    tree_sitter_djot_folds_update(folds, tree, new_tree);
+    ts_tree_delete(tree);
+    tree = new_tree;
+
+    TSDjotReferenceIndex *built_index =
+        tree_sitter_djot_reference_index_new(tree, text.contents);
+    TSDjotOutline *built_outline =
+        tree_sitter_djot_outline_new(tree, text.contents);
+    TSDjotFolds *built_folds = tree_sitter_djot_folds_new(tree);
+    const char *failed = NULL;
+    if (!same_references(index, built_index)) {
+      failed = "reference index";
+    } else if (!same_outline(outline, built_outline)) {
+      failed = "outline";
+    } else if (!same_folds(folds, built_folds)) {
+      failed = "folds";
+    } else if (!check_injections(tree, &text)) {
+      failed = "injections";
+    } else if (!check_html(tree, &text)) {
+      failed = "html";
+    }
+    tree_sitter_djot_reference_index_delete(built_index);
+    tree_sitter_djot_outline_delete(built_outline);
+    tree_sitter_djot_folds_delete(built_folds);
+
+    if (failed) {
+      fprintf(stderr,
+              "edit %d with seed %llu: the %s differ after replacing %u "
+              "bytes at byte %u with %u bytes in:\n%.*s\n",
+              i, (unsigned long long)seed, failed,
+              edit.old_end_byte - edit.start_byte, edit.start_byte,
+              edit.new_end_byte - edit.start_byte, (int)text.length,
+              text.contents);
+      ++failures;
+      // Start over from the current text, to find the next failure.
+      tree_sitter_djot_reference_index_delete(index);
+      tree_sitter_djot_outline_delete(outline);
+      tree_sitter_djot_folds_delete(folds);
+      index = tree_sitter_djot_reference_index_new(tree, text.contents);
+      outline = tree_sitter_djot_outline_new(tree, text.contents);
+      folds = tree_sitter_djot_folds_new(tree);
+    }
+  }
+
+  tree_sitter_djot_reference_index_delete(index);
+  tree_sitter_djot_outline_delete(outline);
+  tree_sitter_djot_folds_delete(folds);
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+  free(text.contents);
+
+  if (failures > 0) {
+    return 1;
+  }
+  printf("%d edits with seed %llu\n", edits, (unsigned long long)seed);
+  return 0;
+}